@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+# bench-cs.py
+#  Content Store size and memory benchmark of the ICC scenario
+#
+# Copyright (c) 2014 Waseda University, Sato Laboratory
+#
+#  bench-cs is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  bench-cs is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero Public License for more details.
+#
+#  You should have received a copy of the GNU Affero Public License
+#  along with bench-cs.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Sweep -csSize and -csStore and find the smallest store that keeps the hit ratio.
+
+The runs go through run-sweep.py with -csStats and -profile, so every run
+leaves cs-summary.tsv (peak Content Store occupancy and hits per node
+class) and profile.tsv (wall time and peak memory). They are gathered into
+one table, one row per store, size and node class. For each store the
+smallest csSize whose hit ratio over all routers is within --tolerance of
+the one at the largest csSize is reported.
+
+    ./bench-cs.py --ns3-dir ~/ndnSIM/ns-3 --csSize 1000 10000 100000 10000000
+    ./bench-cs.py --ns3-dir ~/ndnSIM/ns-3 --sectors 8 --aps 8 --mobile 32 -- -fake=1
+"""
+
+import argparse
+import csv
+import glob
+import json
+import os
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# Parameters identifying a benchmark point, as run-sweep.py names them
+POINT = ['csStore', 'csSize']
+
+
+def read_tsv(path):
+    """Rows of a tsv file with '#' comment lines, as dictionaries."""
+    with open(path) as f:
+        lines = [line for line in f if not line.startswith('#')]
+    return list(csv.DictReader(lines, delimiter='\t'))
+
+
+def collect(runs):
+    rows = []
+    for path in sorted(glob.glob(os.path.join(runs, '*', '*', '*', '*', 'cs-summary.tsv'))):
+        rundir = path.split(os.sep)[-5]
+        # The grid point run-sweep.py ran
+        with open(os.path.join(runs, rundir, 'params.json')) as f:
+            params = json.load(f)
+
+        total = {}
+        profile = os.path.join(os.path.dirname(path), 'profile.tsv')
+        if os.path.isfile(profile):
+            total = dict((r['phase'], r) for r in read_tsv(profile)).get('total', {})
+
+        for cls in read_tsv(path):
+            row = dict((k, params.get(k, '')) for k in POINT)
+            row.update(cls)
+            row['wall_s'] = total.get('wall_s', '')
+            row['peak_rss_kb'] = total.get('peak_rss_kb', '')
+            rows.append(row)
+
+    rows.sort(key=lambda r: (r['csStore'], int(r['csSize'] or 0), r['class']))
+    return rows
+
+
+def write_table(path, rows):
+    fields = POINT + ['class', 'nodes', 'peak_entries', 'peak_bytes', 'hits', 'misses', 'hit_ratio',
+                      'wall_s', 'peak_rss_kb']
+    with open(path, 'w') as f:
+        writer = csv.DictWriter(f, fields, delimiter='\t', extrasaction='ignore')
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+
+def smallest(rows, tolerance):
+    """Per store, the row of the smallest csSize within tolerance of the largest's hit ratio."""
+    picks = {}
+    for store in sorted(set(r['csStore'] for r in rows)):
+        points = [r for r in rows if r['csStore'] == store and r['class'] == 'all']
+        if not points:
+            continue
+        reference = float(points[-1]['hit_ratio'])
+        for r in points:
+            if float(r['hit_ratio']) >= reference - tolerance:
+                picks[store] = (r, points[-1])
+                break
+    return picks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--ns3-dir', default='.', help='ns-3 tree holding build/ and Waypoints/ (default: .)')
+    parser.add_argument('--binary', help='scenario binary (default: found under NS3_DIR/build/scratch)')
+    parser.add_argument('--out', default='bench', help='directory for the runs and the table (default: bench)')
+    parser.add_argument('--jobs', '-j', default='1',
+                        help='runs at the same time, more than 1 makes the memory figures compete (default: 1)')
+    parser.add_argument('--csSize', nargs='+', default=['1000', '10000', '100000', '1000000', '10000000'])
+    parser.add_argument('--csStore', nargs='+', default=['lru', 'arena'], choices=['lru', 'arena'])
+    parser.add_argument('--sectors', default='2')
+    parser.add_argument('--aps', default='2')
+    parser.add_argument('--mobile', default='1')
+    parser.add_argument('--speed', default='5')
+    parser.add_argument('--endTime', default='200', help='simulated seconds of every run (default: 200)')
+    parser.add_argument('--interval', default='10', help='simulated seconds between store samples (default: 10)')
+    parser.add_argument('--tolerance', type=float, default=0.01,
+                        help='hit ratio a smaller store may lose against the largest (default: 0.01)')
+    parser.add_argument('extra', nargs='*', help='further scenario arguments, after --')
+    args = parser.parse_args()
+
+    runs = os.path.join(args.out, 'cs-runs')
+    cmd = [sys.executable, os.path.join(HERE, 'run-sweep.py'), '--ns3-dir', args.ns3_dir, '--out', runs,
+           '-j', args.jobs, '--force', '--speed', args.speed, '--fake', '0',
+           '--csSize'] + args.csSize + ['--csStore'] + args.csStore + \
+          ['--sectors', args.sectors, '--aps', args.aps, '--mobile', args.mobile]
+    if args.binary:
+        cmd += ['--binary', args.binary]
+    cmd += ['--', '-csStats=%s' % args.interval, '-profile=1', '-endTime=%s' % args.endTime] + args.extra
+
+    status = subprocess.call(cmd)
+    if status != 0:
+        print('some benchmark runs failed, the table only holds the others')
+
+    rows = collect(runs)
+    table = os.path.join(args.out, 'cs.tsv')
+    write_table(table, rows)
+    print('%d rows written to %s' % (len(rows), table))
+
+    for store, (pick, largest) in sorted(smallest(rows, args.tolerance).items()):
+        print('%s: csSize %s keeps a hit ratio of %s (%s at csSize %s), peak %s entries, peak RSS %s kB (%s kB)' % (
+            store, pick['csSize'], pick['hit_ratio'], largest['hit_ratio'], largest['csSize'],
+            pick['peak_entries'], pick['peak_rss_kb'], largest['peak_rss_kb']))
+
+    return 1 if status else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# bench-handover.py
+#  Post-handover delay benchmark of the handover-aware consumer
+#
+# Copyright (c) 2014 Waseda University, Sato Laboratory
+#
+#  bench-handover is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  bench-handover is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero Public License for more details.
+#
+#  You should have received a copy of the GNU Affero Public License
+#  along with bench-handover.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Sweep -speed with and without -handoverPause and compare the post-handover delay.
+
+The runs go through run-sweep.py with -summary, so every run leaves
+summary.txt. Its mobile.handover.* lines hold the Data the mobiles got
+within --window seconds of an AP change: how many, their delay and the
+retransmissions they needed. They are gathered into one table, one row per
+speed, seed and mode, and for each speed the change the pausing consumer
+makes against the stock one is reported.
+
+    ./bench-handover.py --ns3-dir ~/ndnSIM/ns-3 --speed 5 20 50 80
+    ./bench-handover.py --ns3-dir ~/ndnSIM/ns-3 --seed 1 2 3 -- -burstRate=2
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# Parameters identifying a benchmark point, as run-sweep.py names them
+POINT = ['speed', 'seed', 'handoverPause']
+
+# summary.txt lines gathered, by table column
+METRICS = [
+    ('handovers', None),
+    ('data', 'mobile.handover.delay.count'),
+    ('mean_delay_s', 'mobile.handover.delay.mean'),
+    ('p90_delay_s', 'mobile.handover.delay.p90'),
+    ('retransmissions', 'mobile.handover.retransmissions'),
+    ('all_mean_delay_s', 'mobile.delay.full.mean'),
+    ('all_retransmissions', 'mobile.retransmissions'),
+]
+
+
+def read_summary(path):
+    """The metrics of a summary.txt, and the handovers from its header."""
+    values = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                words = line.split()
+                if 'handovers' in words:
+                    values['handovers'] = words[words.index('handovers') + 1]
+                continue
+            key, _, value = line.rstrip('\n').partition('\t')
+            values[key] = value
+    return values
+
+
+def collect(runs):
+    rows = []
+    for path in sorted(glob.glob(os.path.join(runs, '*', '*', '*', '*', 'summary.txt'))):
+        rundir = path.split(os.sep)[-5]
+        # The grid point run-sweep.py ran
+        with open(os.path.join(runs, rundir, 'params.json')) as f:
+            params = json.load(f)
+        summary = read_summary(path)
+
+        row = dict((k, params.get(k, '')) for k in POINT)
+        for column, key in METRICS:
+            row[column] = summary.get(key or column, '')
+        rows.append(row)
+
+    rows.sort(key=lambda r: (float(r['speed'] or 0), r['seed'], r['handoverPause']))
+    return rows
+
+
+def write_table(path, rows):
+    fields = POINT + [column for column, _ in METRICS]
+    with open(path, 'w') as f:
+        f.write('\t'.join(fields) + '\n')
+        for row in rows:
+            f.write('\t'.join(str(row[k]) for k in fields) + '\n')
+
+
+def mean(rows, column):
+    values = [float(r[column]) for r in rows if r[column] != '']
+    return sum(values) / len(values) if values else 0.0
+
+
+def change(stock, paused):
+    return '%+.1f%%' % (100.0 * (paused - stock) / stock) if stock else 'n/a'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--ns3-dir', default='.', help='ns-3 tree holding build/ and Waypoints/ (default: .)')
+    parser.add_argument('--binary', help='scenario binary (default: found under NS3_DIR/build/scratch)')
+    parser.add_argument('--out', default='bench', help='directory for the runs and the table (default: bench)')
+    parser.add_argument('--jobs', '-j', default=str(len(os.sched_getaffinity(0))),
+                        help='runs at the same time (default: all cores)')
+    parser.add_argument('--speed', nargs='+', default=['5', '10', '20', '30', '40', '50', '60', '70', '80'])
+    parser.add_argument('--seed', nargs='+', default=['1'], help='ns-3 RngRun values')
+    parser.add_argument('--sectors', default='2')
+    parser.add_argument('--aps', default='2')
+    parser.add_argument('--mobile', default='1')
+    parser.add_argument('--endTime', default='200', help='simulated seconds of every run (default: 200)')
+    parser.add_argument('--window', default='2', help='seconds after an AP change that count as post-handover (default: 2)')
+    parser.add_argument('extra', nargs='*', help='further scenario arguments, after --')
+    args = parser.parse_args()
+
+    runs = os.path.join(args.out, 'handover-runs')
+    cmd = [sys.executable, os.path.join(HERE, 'run-sweep.py'), '--ns3-dir', args.ns3_dir, '--out', runs,
+           '-j', args.jobs, '--force', '--fake', '0', '--handoverPause', '0', '1',
+           '--speed'] + args.speed + ['--seed'] + args.seed + \
+          ['--sectors', args.sectors, '--aps', args.aps, '--mobile', args.mobile]
+    if args.binary:
+        cmd += ['--binary', args.binary]
+    cmd += ['--', '-summary=1', '-handoverWindow=%s' % args.window, '-endTime=%s' % args.endTime] + args.extra
+
+    status = subprocess.call(cmd)
+    if status != 0:
+        print('some benchmark runs failed, the table only holds the others')
+
+    rows = collect(runs)
+    table = os.path.join(args.out, 'handover.tsv')
+    write_table(table, rows)
+    print('%d rows written to %s' % (len(rows), table))
+
+    for speed in sorted(set(r['speed'] for r in rows), key=float):
+        stock = [r for r in rows if r['speed'] == speed and r['handoverPause'] == '0']
+        paused = [r for r in rows if r['speed'] == speed and r['handoverPause'] == '1']
+        if not stock or not paused:
+            continue
+        print('speed %s: post-handover delay %.4f s -> %.4f s (%s), retransmissions %.0f -> %.0f (%s)' % (
+            speed, mean(stock, 'mean_delay_s'), mean(paused, 'mean_delay_s'),
+            change(mean(stock, 'mean_delay_s'), mean(paused, 'mean_delay_s')),
+            mean(stock, 'retransmissions'), mean(paused, 'retransmissions'),
+            change(mean(stock, 'retransmissions'), mean(paused, 'retransmissions'))))
+
+    return 1 if status else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
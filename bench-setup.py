@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+#
+# bench-setup.py
+#  Startup time and memory benchmark of the ICC scenario builder
+#
+# Copyright (c) 2014 Waseda University, Sato Laboratory
+#
+#  bench-setup is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  bench-setup is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero Public License for more details.
+#
+#  You should have received a copy of the GNU Affero Public License
+#  along with bench-setup.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Sweep the topology size with -profile and tabulate the setup phases.
+
+The runs go through run-sweep.py one at a time, so the timings do not
+compete for cores, with a short simulated time so the setup dominates.
+Every run's profile.tsv is gathered into one table, one row per size and
+phase. With --baseline the table is compared against an earlier one and
+phases that got slower than --tolerance are reported, the exit status is
+then 1.
+
+    ./bench-setup.py --ns3-dir ~/ndnSIM/ns-3 --sectors 2 8 32 --aps 2 8 32
+    ./bench-setup.py --ns3-dir ~/ndnSIM/ns-3 --baseline bench/setup-old.tsv
+"""
+
+import argparse
+import csv
+import glob
+import json
+import os
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# Parameters identifying a benchmark point, as run-sweep.py names them
+POINT = ['sectors', 'aps', 'mobile']
+
+
+def read_profile(path):
+    """Phase rows of a profile.tsv as dictionaries."""
+    with open(path) as f:
+        lines = [line for line in f if not line.startswith('#')]
+    return list(csv.DictReader(lines, delimiter='\t'))
+
+
+def collect(runs):
+    rows = []
+    for path in sorted(glob.glob(os.path.join(runs, '*', '*', '*', '*', 'profile.tsv'))):
+        rundir = path.split(os.sep)[-5]
+        # The grid point run-sweep.py ran
+        with open(os.path.join(runs, rundir, 'params.json')) as f:
+            params = json.load(f)
+        for phase in read_profile(path):
+            row = dict((k, params.get(k, '')) for k in POINT)
+            row.update(phase)
+            rows.append(row)
+    return rows
+
+
+def write_table(path, rows):
+    fields = POINT + ['phase', 'wall_s', 'rss_kb', 'peak_rss_kb']
+    with open(path, 'w') as f:
+        writer = csv.DictWriter(f, fields, delimiter='\t', extrasaction='ignore')
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+
+def compare(rows, baseline, tolerance, min_seconds):
+    """Print the phases slower than the baseline, return how many there are."""
+    with open(baseline) as f:
+        old = dict((tuple(r[k] for k in POINT + ['phase']), r) for r in csv.DictReader(f, delimiter='\t'))
+
+    slower = 0
+    for row in rows:
+        key = tuple(row[k] for k in POINT + ['phase'])
+        if key not in old:
+            continue
+        before, after = float(old[key]['wall_s']), float(row['wall_s'])
+        if after > before * (1 + tolerance) and after - before > min_seconds:
+            slower += 1
+            print('slower: %s %s %.3fs -> %.3fs (%+.0f%%)' % (
+                ' '.join('%s=%s' % (k, row[k]) for k in POINT), row['phase'], before, after,
+                100 * (after / before - 1) if before > 0 else float('inf')))
+    return slower
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--ns3-dir', default='.', help='ns-3 tree holding build/ and Waypoints/ (default: .)')
+    parser.add_argument('--binary', help='scenario binary (default: found under NS3_DIR/build/scratch)')
+    parser.add_argument('--out', default='bench', help='directory for the runs and the table (default: bench)')
+    parser.add_argument('--sectors', nargs='+', default=['2', '8', '32'])
+    parser.add_argument('--aps', nargs='+', default=['2', '8', '32'])
+    parser.add_argument('--mobile', nargs='+', default=['1'])
+    parser.add_argument('--endTime', default='2', help='simulated seconds of every run (default: 2)')
+    parser.add_argument('--baseline', help='earlier setup.tsv to compare against')
+    parser.add_argument('--tolerance', type=float, default=0.2,
+                        help='relative slowdown of a phase reported as a regression (default: 0.2)')
+    parser.add_argument('--min-seconds', type=float, default=0.05,
+                        help='ignore slowdowns smaller than this many seconds (default: 0.05)')
+    args = parser.parse_args()
+
+    runs = os.path.join(args.out, 'runs')
+    cmd = [sys.executable, os.path.join(HERE, 'run-sweep.py'), '--ns3-dir', args.ns3_dir, '--out', runs,
+           '-j', '1', '--force', '--speed', '5', '--fake', '0',
+           '--sectors'] + args.sectors + ['--aps'] + args.aps + ['--mobile'] + args.mobile
+    if args.binary:
+        cmd += ['--binary', args.binary]
+    cmd += ['--', '-profile=1', '-endTime=%s' % args.endTime]
+
+    status = subprocess.call(cmd)
+    if status != 0:
+        print('some benchmark runs failed, the table only holds the others')
+
+    rows = collect(runs)
+    table = os.path.join(args.out, 'setup.tsv')
+    write_table(table, rows)
+    print('%d phase rows written to %s' % (len(rows), table))
+
+    if args.baseline:
+        slower = compare(rows, args.baseline, args.tolerance, args.min_seconds)
+        print('%d phases slower than %s' % (slower, args.baseline))
+        if slower:
+            return 1
+
+    return 1 if status else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-alloc-count.h
+ *  Global operator new and delete counting the heap allocations
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-alloc-count is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-alloc-count is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-alloc-count.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Replaces the global operator new and delete of the program, so include
+// it from the one file holding main: icc-scenario.cc and icc-fw-bench.cc.
+// Every heap allocation of the process goes into the counters of
+// AllocStatsReporter, which costs two increments. Counting from the start
+// keeps the live block count right whenever a reporter starts. The
+// exception specifications match the declarations of <new> in every
+// standard
+
+#ifndef ICC_ALLOC_COUNT_H
+#define ICC_ALLOC_COUNT_H
+
+#include <cstdlib>
+#include <new>
+
+#include "icc-pool.h"
+
+#if __cplusplus >= 201103L
+#define ICC_THROW_BAD_ALLOC
+#define ICC_NOTHROW noexcept
+#else
+#define ICC_THROW_BAD_ALLOC throw (std::bad_alloc)
+#define ICC_NOTHROW throw ()
+#endif
+
+void *operator new (std::size_t size) ICC_THROW_BAD_ALLOC
+{
+	ns3::AllocationCounters &counters = ns3::AllocStatsReporter::GetCounters ();
+	counters.allocations++;
+	counters.bytes += size;
+
+	void *p = malloc (size > 0 ? size : 1);
+	if (p == 0)
+		throw std::bad_alloc ();
+	return p;
+}
+
+void operator delete (void *p) ICC_NOTHROW
+{
+	if (p == 0)
+		return;
+	ns3::AllocStatsReporter::GetCounters ().frees++;
+	free (p);
+}
+
+// C++14 sized deallocation goes to the same place
+#ifdef __cpp_sized_deallocation
+void operator delete (void *p, std::size_t) ICC_NOTHROW
+{
+	operator delete (p);
+}
+#endif
+
+#endif // ICC_ALLOC_COUNT_H
@@ -0,0 +1,491 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-apps.h
+ *  Producer and consumer applications of the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-apps is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-apps is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-apps.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_APPS_H
+#define ICC_APPS_H
+
+#include <algorithm>
+#include <limits>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/wifi-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+#include <ns3-dev/ns3/ndnSIM/utils/ndn-fw-hop-count-tag.h>
+
+#include "icc-pool.h"
+#include "icc-timer-wheel.h"
+
+namespace ns3 {
+
+// ndn::Producer that can answer with one shared payload and pooled packets.
+// Every Data of the stock producer gets a payload of its own, though they
+// are all the same PayloadSize zeros. With SharedPayload the payload is made
+// once and every Data gets a copy of the packet, which shares its buffer,
+// so no bytes are allocated or copied. With Pool the Data packets and names
+// are taken from pools, and a reused Data keeps its payload packet
+class IccProducer : public ndn::App
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccProducer")
+			.SetParent<ndn::App> ()
+			.AddConstructor<IccProducer> ()
+			.AddAttribute ("Prefix", "Prefix the producer has the Data of",
+					StringValue ("/"),
+					ndn::MakeNameAccessor (&IccProducer::m_prefix),
+					ndn::MakeNameChecker ())
+			.AddAttribute ("Postfix", "Postfix added to the name of every Data",
+					StringValue ("/"),
+					ndn::MakeNameAccessor (&IccProducer::m_postfix),
+					ndn::MakeNameChecker ())
+			.AddAttribute ("PayloadSize", "Virtual payload size of the Data packets",
+					UintegerValue (1024),
+					MakeUintegerAccessor (&IccProducer::m_payloadSize),
+					MakeUintegerChecker<uint32_t> ())
+			.AddAttribute ("Freshness", "Freshness of the Data packets, 0 is unlimited",
+					TimeValue (Seconds (0)),
+					MakeTimeAccessor (&IccProducer::m_freshness),
+					MakeTimeChecker ())
+			.AddAttribute ("Signature", "Fake signature, 0 is a valid one",
+					UintegerValue (0),
+					MakeUintegerAccessor (&IccProducer::m_signature),
+					MakeUintegerChecker<uint32_t> ())
+			.AddAttribute ("SharedPayload", "Give every Data a reference to one payload buffer",
+					BooleanValue (true),
+					MakeBooleanAccessor (&IccProducer::m_shared),
+					MakeBooleanChecker ())
+			.AddAttribute ("Pool", "Reuse released Data packets and names",
+					BooleanValue (false),
+					MakeBooleanAccessor (&IccProducer::m_pool),
+					MakeBooleanChecker ())
+			.AddAttribute ("PoolSize", "Most Data packets kept for reuse",
+					UintegerValue (4096),
+					MakeUintegerAccessor (&IccProducer::m_poolSize),
+					MakeUintegerChecker<uint32_t> ());
+		return tid;
+	}
+
+	IccProducer ()
+		: m_payloadSize (1024), m_signature (0), m_shared (true), m_pool (false), m_poolSize (4096)
+	{
+	}
+
+protected:
+	virtual void StartApplication ()
+	{
+		App::StartApplication ();
+
+		Ptr<ndn::Fib> fib = GetNode ()->GetObject<ndn::Fib> ();
+		Ptr<ndn::fib::Entry> entry = fib->Add (m_prefix, m_face, 0);
+		entry->UpdateStatus (m_face, ndn::fib::FaceMetric::NDN_FIB_GREEN);
+
+		m_payload = Create<Packet> (m_payloadSize);
+		m_datas.SetCapacity (m_poolSize);
+		m_names.SetCapacity (m_poolSize);
+	}
+
+	virtual void StopApplication ()
+	{
+		App::StopApplication ();
+	}
+
+	virtual void OnInterest (Ptr<const ndn::Interest> interest)
+	{
+		App::OnInterest (interest);
+		if (!m_active)
+			return;
+
+		bool reused = false;
+		Ptr<ndn::Name> name = m_pool ? m_names.Get () : Create<ndn::Name> ();
+		*name = interest->GetName ();
+		name->append (m_postfix);
+
+		Ptr<ndn::Data> data = m_pool ? m_datas.Get (reused) : Create<ndn::Data> ();
+		if (reused)
+			ConstCast<Packet> (data->GetPayload ())->RemoveAllPacketTags ();
+		else
+			data->SetPayload (m_shared ? m_payload->Copy () : Create<Packet> (m_payloadSize));
+
+		data->SetName (name);
+		data->SetFreshness (m_freshness);
+		data->SetTimestamp (Simulator::Now ());
+		data->SetSignature (m_signature);
+
+		// Echo the hop count of the interest, like ndn::Producer
+		ndn::FwHopCountTag hopCountTag;
+		if (interest->GetPayload ()->PeekPacketTag (hopCountTag))
+			data->GetPayload ()->AddPacketTag (hopCountTag);
+
+		m_face->ReceiveData (data);
+		m_transmittedDatas (data, this, m_face);
+	}
+
+private:
+	ndn::Name m_prefix;
+	ndn::Name m_postfix;
+	uint32_t m_payloadSize;
+	Time m_freshness;
+	uint32_t m_signature;
+	bool m_shared;
+	bool m_pool;
+	uint32_t m_poolSize;
+
+	Ptr<Packet> m_payload;                        // Shared by the Data packets, never changed
+	RefPool<ndn::Data> m_datas;
+	RefPool<ndn::Name> m_names;
+};
+
+// An interest the retransmission wheel holds, by the time it was sent
+struct RetxPending
+{
+	RetxPending ()
+		: seq (0)
+	{
+	}
+
+	RetxPending (uint32_t s, Time t)
+		: seq (s), sent (t)
+	{
+	}
+
+	uint32_t seq;
+	Time sent;
+};
+
+// What the retransmission wheels of the consumers found when their
+// interests came up
+struct RetxWheelCounters
+{
+	RetxWheelCounters ()
+		: timeouts (0), answered (0), rearmed (0)
+	{
+	}
+
+	uint64_t timeouts;                            // Timed out and retransmitted
+	uint64_t answered;                            // Answered or sent again meanwhile, dropped
+	uint64_t rearmed;                             // Not timed out yet under a grown RTO
+};
+
+// What the consumers did around the reassociations of their stations
+struct HandoverPauseCounters
+{
+	HandoverPauseCounters ()
+		: pauses (0), held (0), missed (0), paused (0)
+	{
+	}
+
+	uint64_t pauses;                              // Disassociations the consumers paused at
+	uint64_t held;                                // Outstanding interests held, sent again in the burst
+	uint64_t missed;                              // Interests not sent while paused, made up in the burst
+	double paused;                                // Seconds spent paused
+};
+
+// ndn::ConsumerCbr sending interests taken from pools. The stock consumer
+// creates a name and an interest for every one it sends, this one reuses
+// those the network has released. It schedules its own send instead of
+// Consumer::SendPacket, and otherwise behaves the same, retransmissions
+// and delay traces included.
+//
+// With RetxWheel the retransmission timeouts are not polled every
+// RetxTimer: every interest sent goes into a timer wheel for the time the
+// RTO ends, and is looked at when it comes up. Nothing runs while no
+// timeout is due. An interest answered meanwhile is dropped from the wheel
+// then; one whose RTO has grown since it was sent goes back in. An RTO that
+// shrinks takes effect for the interests sent after it did.
+//
+// With HandoverPause the consumer follows the association of the station
+// MAC of its node. When the station loses its AP it stops sending, and
+// its outstanding interests, which went out on the lost link, are held
+// instead of left to time out. When the station is associated again the
+// held interests and those it did not send meanwhile go out at BurstRate
+// times the Frequency, then it goes on at the Frequency
+class IccConsumerCbr : public ndn::ConsumerCbr
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccConsumerCbr")
+			.SetParent<ndn::ConsumerCbr> ()
+			.AddConstructor<IccConsumerCbr> ()
+			.AddAttribute ("Pool", "Reuse released interests and names",
+					BooleanValue (true),
+					MakeBooleanAccessor (&IccConsumerCbr::m_pool),
+					MakeBooleanChecker ())
+			.AddAttribute ("PoolSize", "Most interests kept for reuse",
+					UintegerValue (4096),
+					MakeUintegerAccessor (&IccConsumerCbr::m_poolSize),
+					MakeUintegerChecker<uint32_t> ())
+			.AddAttribute ("RetxWheel", "Keep the retransmission timeouts in a timer wheel instead of checking every RetxTimer",
+					BooleanValue (false),
+					MakeBooleanAccessor (&IccConsumerCbr::m_wheel),
+					MakeBooleanChecker ())
+			.AddAttribute ("WheelTick", "Resolution of the retransmission timer wheel",
+					TimeValue (MilliSeconds (5)),
+					MakeTimeAccessor (&IccConsumerCbr::m_wheelTick),
+					MakeTimeChecker ())
+			.AddAttribute ("HandoverPause", "Hold interests while the station is not associated and send them in a burst once it is",
+					BooleanValue (false),
+					MakeBooleanAccessor (&IccConsumerCbr::m_handoverPause),
+					MakeBooleanChecker ())
+			.AddAttribute ("BurstRate", "Rate of the burst after a reassociation, relative to the Frequency",
+					DoubleValue (4),
+					MakeDoubleAccessor (&IccConsumerCbr::m_burstRate),
+					MakeDoubleChecker<double> (1))
+			.AddAttribute ("BurstMax", "Most interests not sent while paused that the burst makes up",
+					UintegerValue (1000),
+					MakeUintegerAccessor (&IccConsumerCbr::m_burstMax),
+					MakeUintegerChecker<uint32_t> ());
+		return tid;
+	}
+
+	IccConsumerCbr ()
+		: m_pool (true), m_poolSize (4096), m_wheel (false), m_wheelTick (MilliSeconds (5)), m_handoverPause (false),
+		  m_burstRate (4), m_burstMax (1000), m_associated (true), m_burst (0)
+	{
+	}
+
+	static RetxWheelCounters &GetRetxCounters ()
+	{
+		static RetxWheelCounters counters;
+		return counters;
+	}
+
+	static HandoverPauseCounters &GetPauseCounters ()
+	{
+		static HandoverPauseCounters counters;
+		return counters;
+	}
+
+protected:
+	virtual void StartApplication ()
+	{
+		m_interests.SetCapacity (m_poolSize);
+		m_names.SetCapacity (m_poolSize);
+		if (m_wheel)
+		{
+			// Setting RetxTimer started the polling, the wheel replaces it
+			Simulator::Cancel (m_retxEvent);
+			m_retx.SetTick (m_wheelTick);
+			m_retx.SetCallback (MakeCallback (&IccConsumerCbr::Expire, this));
+		}
+		if (m_handoverPause)
+			ConnectStation ();
+		ConsumerCbr::StartApplication ();
+	}
+
+	virtual void StopApplication ()
+	{
+		m_retx.Clear ();
+		ConsumerCbr::StopApplication ();
+	}
+
+	virtual void WillSendOutInterest (uint32_t seq)
+	{
+		ConsumerCbr::WillSendOutInterest (seq);
+		if (m_wheel)
+		{
+			Time now = Simulator::Now ();
+			m_retx.Insert (now + m_rtt->RetransmitTimeout (), RetxPending (seq, now));
+		}
+	}
+
+	// Data of a held interest can still come in late from the old AP, the
+	// interest is not sent again then
+	virtual void OnData (Ptr<const ndn::Data> data)
+	{
+		uint32_t seq = data->GetName ().get (-1).toSeqNum ();
+		bool held = m_retxSeqs.count (seq) > 0;
+
+		ConsumerCbr::OnData (data);
+		if (held)
+		{
+			m_retxSeqs.erase (seq);
+			// The burst was sized with it
+			if (m_associated && m_burst > 0)
+				m_burst--;
+		}
+	}
+
+	// ConsumerCbr::ScheduleNextPacket, sending with Send, faster in a burst
+	virtual void ScheduleNextPacket ()
+	{
+		if (m_firstTime)
+		{
+			m_sendEvent = Simulator::Schedule (Seconds (0.0), &IccConsumerCbr::Send, this);
+			m_firstTime = false;
+		}
+		else if (!m_sendEvent.IsRunning ())
+		{
+			Time gap = (m_random == 0) ? Seconds (1.0 / m_frequency) : Seconds (m_random->GetValue ());
+			if (m_burst > 0)
+				gap = Seconds (1.0 / (m_frequency * m_burstRate));
+			m_sendEvent = Simulator::Schedule (gap, &IccConsumerCbr::Send, this);
+		}
+	}
+
+	// Consumer::SendPacket with pooled packets, nothing while paused
+	void Send ()
+	{
+		if (!m_active || !m_associated)
+			return;
+
+		uint32_t seq = std::numeric_limits<uint32_t>::max ();
+		if (!m_retxSeqs.empty ())
+		{
+			seq = *m_retxSeqs.begin ();
+			m_retxSeqs.erase (m_retxSeqs.begin ());
+		}
+		else
+		{
+			if (m_seqMax != std::numeric_limits<uint32_t>::max () && m_seq >= m_seqMax)
+				return;
+			seq = m_seq++;
+		}
+
+		bool reused = false;
+		Ptr<ndn::Name> name = m_pool ? m_names.Get () : Create<ndn::Name> ();
+		*name = m_interestName;
+		name->appendSeqNum (seq);
+
+		Ptr<ndn::Interest> interest = m_pool ? m_interests.Get (reused) : Create<ndn::Interest> ();
+		if (reused)
+			ConstCast<Packet> (interest->GetPayload ())->RemoveAllPacketTags ();
+		interest->SetNonce (m_rand.GetValue ());
+		interest->SetName (name);
+		interest->SetInterestLifetime (m_interestLifeTime);
+
+		WillSendOutInterest (seq);
+
+		ndn::FwHopCountTag hopCountTag;
+		interest->GetPayload ()->AddPacketTag (hopCountTag);
+
+		m_transmittedInterests (interest, this, m_face);
+		m_face->ReceiveInterest (interest);
+
+		if (m_burst > 0)
+			m_burst--;
+		ScheduleNextPacket ();
+	}
+
+	// Follow the station MACs of the node, there is one on a mobile
+	void ConnectStation ()
+	{
+		Ptr<Node> node = GetNode ();
+		for (uint32_t i = 0; i < node->GetNDevices (); i++)
+		{
+			Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (node->GetDevice (i));
+			if (device == 0)
+				continue;
+			Ptr<StaWifiMac> mac = DynamicCast<StaWifiMac> (device->GetMac ());
+			if (mac == 0)
+				continue;
+
+			mac->TraceConnectWithoutContext ("Assoc", MakeCallback (&IccConsumerCbr::Associated, this));
+			mac->TraceConnectWithoutContext ("DeAssoc", MakeCallback (&IccConsumerCbr::Deassociated, this));
+		}
+	}
+
+	// The station lost its AP: stop, and hold what went out on the lost link
+	void Deassociated (Mac48Address bssid)
+	{
+		if (!m_active || !m_associated)
+			return;
+
+		HandoverPauseCounters &counters = GetPauseCounters ();
+		counters.pauses++;
+		counters.held += m_seqTimeouts.size ();
+
+		for (SeqTimeoutsContainer::iterator entry = m_seqTimeouts.begin (); entry != m_seqTimeouts.end (); ++entry)
+			m_retxSeqs.insert (entry->seq);
+		m_seqTimeouts.clear ();
+
+		Simulator::Cancel (m_sendEvent);
+		m_associated = false;
+		m_pausedAt = Simulator::Now ();
+	}
+
+	// The station has an AP again: send the held interests and make up
+	// those not sent, in a burst
+	void Associated (Mac48Address bssid)
+	{
+		if (!m_active || m_associated)
+			return;
+
+		Time paused = Simulator::Now () - m_pausedAt;
+		uint32_t missed = std::min<double> (m_burstMax, paused.GetSeconds () * m_frequency);
+
+		HandoverPauseCounters &counters = GetPauseCounters ();
+		counters.missed += missed;
+		counters.paused += paused.GetSeconds ();
+
+		m_associated = true;
+		m_burst = m_retxSeqs.size () + missed;
+		// A send left pending while paused would go out apart from the burst
+		Simulator::Cancel (m_sendEvent);
+		m_sendEvent = Simulator::ScheduleNow (&IccConsumerCbr::Send, this);
+	}
+
+	// What Consumer::CheckRetxTimeout does for one interest
+	void Expire (RetxPending pending)
+	{
+		RetxWheelCounters &counters = GetRetxCounters ();
+		SeqTimeoutsContainer::iterator entry = m_seqTimeouts.find (pending.seq);
+		if (entry == m_seqTimeouts.end () || entry->time != pending.sent)
+		{
+			counters.answered++;
+			return;
+		}
+
+		Time expiry = entry->time + m_rtt->RetransmitTimeout ();
+		if (expiry > Simulator::Now ())
+		{
+			counters.rearmed++;
+			m_retx.Insert (expiry, pending);
+			return;
+		}
+
+		m_seqTimeouts.erase (entry);
+		counters.timeouts++;
+		OnTimeout (pending.seq);
+	}
+
+private:
+	bool m_pool;
+	uint32_t m_poolSize;
+	RefPool<ndn::Interest> m_interests;
+	RefPool<ndn::Name> m_names;
+
+	bool m_wheel;
+	Time m_wheelTick;
+	TimerWheel<RetxPending> m_retx;               // Sent interests, by the end of their RTO
+
+	bool m_handoverPause;
+	double m_burstRate;
+	uint32_t m_burstMax;
+	bool m_associated;                            // False while paused
+	Time m_pausedAt;
+	uint32_t m_burst;                             // Interests left to send at the burst rate
+};
+
+} // namespace ns3
+
+#endif // ICC_APPS_H
@@ -0,0 +1,343 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-binary-tracer.h
+ *  L3 and application delay tracers writing binary column traces
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-binary-tracer is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-binary-tracer is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-binary-tracer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_BINARY_TRACER_H
+#define ICC_BINARY_TRACER_H
+
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+#include "icc-trace-format.h"
+
+namespace ns3 {
+
+// One trace file, shared by the tracers of all the nodes writing into it
+class BinaryTraceFile : public SimpleRefCount<BinaryTraceFile>
+{
+public:
+	BinaryTraceFile (const std::string &path, icctrace::Content content, Time period, bool compress)
+	{
+		if (!m_writer.Open (path, content, period.GetSeconds (), compress))
+			NS_FATAL_ERROR ("Cannot open trace file " << path);
+	}
+
+	~BinaryTraceFile ()
+	{
+		Close ();
+	}
+
+	icctrace::TraceWriter &GetWriter ()
+	{
+		return m_writer;
+	}
+
+	// Remember the last period written, the reader prints up to it
+	void NotePeriod (Time now)
+	{
+		m_lastPeriod = std::max (m_lastPeriod, now);
+	}
+
+	void Close ()
+	{
+		m_writer.Close (m_lastPeriod.GetSeconds ());
+	}
+
+	// How a node appears in the Node column, same as the text tracers
+	static std::string NodeName (Ptr<Node> node)
+	{
+		std::string name = Names::FindName (node);
+		return name.empty () ? boost::lexical_cast<std::string> (node->GetId ()) : name;
+	}
+
+private:
+	icctrace::TraceWriter m_writer;
+	Time m_lastPeriod;
+};
+
+// Counts the forwarding strategy events of a node per face and writes the
+// non zero counts every period. Counts the same events L3AggregateTracer does
+class BinaryL3Tracer : public SimpleRefCount<BinaryL3Tracer>
+{
+public:
+	BinaryL3Tracer (Ptr<BinaryTraceFile> file, Ptr<Node> node, Time period)
+		: m_file (file), m_period (period)
+	{
+		m_node = m_file->GetWriter ().Intern (BinaryTraceFile::NodeName (node));
+
+		Ptr<ndn::ForwardingStrategy> fw = node->GetObject<ndn::ForwardingStrategy> ();
+
+		fw->TraceConnectWithoutContext ("OutInterests", MakeCallback (&BinaryL3Tracer::OutInterests, this));
+		fw->TraceConnectWithoutContext ("InInterests", MakeCallback (&BinaryL3Tracer::InInterests, this));
+		fw->TraceConnectWithoutContext ("DropInterests", MakeCallback (&BinaryL3Tracer::DropInterests, this));
+
+		fw->TraceConnectWithoutContext ("OutData", MakeCallback (&BinaryL3Tracer::OutData, this));
+		fw->TraceConnectWithoutContext ("InData", MakeCallback (&BinaryL3Tracer::InData, this));
+		fw->TraceConnectWithoutContext ("DropData", MakeCallback (&BinaryL3Tracer::DropData, this));
+
+		// Only some strategies have these
+		fw->TraceConnectWithoutContext ("OutNacks", MakeCallback (&BinaryL3Tracer::OutNacks, this));
+		fw->TraceConnectWithoutContext ("InNacks", MakeCallback (&BinaryL3Tracer::InNacks, this));
+		fw->TraceConnectWithoutContext ("DropNacks", MakeCallback (&BinaryL3Tracer::DropNacks, this));
+
+		fw->TraceConnectWithoutContext ("SatisfiedInterests", MakeCallback (&BinaryL3Tracer::SatisfiedInterests, this));
+		fw->TraceConnectWithoutContext ("TimedOutInterests", MakeCallback (&BinaryL3Tracer::TimedOutInterests, this));
+
+		m_printEvent = Simulator::Schedule (m_period, &BinaryL3Tracer::PeriodicPrinter, this);
+	}
+
+	~BinaryL3Tracer ()
+	{
+		m_printEvent.Cancel ();
+	}
+
+private:
+	struct Counts
+	{
+		Counts ()
+			: faceId (icctrace::FACE_ALL)
+		{
+			memset (packets, 0, sizeof (packets));
+			memset (bytes, 0, sizeof (bytes));
+		}
+
+		int32_t faceId;
+		uint64_t packets[icctrace::L3_TYPES];
+		uint64_t bytes[icctrace::L3_TYPES];
+	};
+
+	// Counters of face, a null face holds the node totals
+	Counts &Get (Ptr<const ndn::Face> face)
+	{
+		std::map<Ptr<const ndn::Face>, Counts>::iterator it = m_stats.find (face);
+		if (it != m_stats.end ())
+			return it->second;
+
+		Counts &counts = m_stats[face];
+		std::string descr ("all");
+
+		if (face)
+		{
+			std::ostringstream os;
+			os << *face;
+			descr = os.str ();
+			counts.faceId = face->GetId ();
+		}
+
+		icctrace::TraceWriter &writer = m_file->GetWriter ();
+		writer.AddFace (Simulator::Now ().GetSeconds (), m_node, counts.faceId, writer.Intern (descr));
+		return counts;
+	}
+
+	template <class T>
+	static uint64_t WireSize (Ptr<const T> packet)
+	{
+		return packet->GetWire () ? packet->GetWire ()->GetSize () : 0;
+	}
+
+	void Count (Ptr<const ndn::Face> face, icctrace::L3Type type, uint64_t bytes)
+	{
+		Counts &counts = Get (face);
+		counts.packets[type]++;
+		counts.bytes[type] += bytes;
+	}
+
+	void OutInterests (Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::OUT_INTERESTS, WireSize (interest));
+	}
+
+	void InInterests (Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::IN_INTERESTS, WireSize (interest));
+	}
+
+	void DropInterests (Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::DROP_INTERESTS, WireSize (interest));
+	}
+
+	void OutNacks (Ptr<const ndn::Interest> nack, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::OUT_NACKS, WireSize (nack));
+	}
+
+	void InNacks (Ptr<const ndn::Interest> nack, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::IN_NACKS, WireSize (nack));
+	}
+
+	void DropNacks (Ptr<const ndn::Interest> nack, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::DROP_NACKS, WireSize (nack));
+	}
+
+	void OutData (Ptr<const ndn::Data> data, bool fromCache, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::OUT_DATA, WireSize (data));
+	}
+
+	void InData (Ptr<const ndn::Data> data, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::IN_DATA, WireSize (data));
+	}
+
+	void DropData (Ptr<const ndn::Data> data, Ptr<const ndn::Face> face)
+	{
+		Count (face, icctrace::DROP_DATA, WireSize (data));
+	}
+
+	// PIT outcomes count for the node and for every face the Interest came in on
+	void PitOutcome (Ptr<const ndn::pit::Entry> entry, icctrace::L3Type type)
+	{
+		Get (0).packets[type]++;
+
+		for (ndn::pit::Entry::in_container::const_iterator i = entry->GetIncoming ().begin ();
+				i != entry->GetIncoming ().end (); i++)
+		{
+			Get (i->m_face).packets[type]++;
+		}
+	}
+
+	void SatisfiedInterests (Ptr<const ndn::pit::Entry> entry)
+	{
+		PitOutcome (entry, icctrace::SATISFIED_INTERESTS);
+	}
+
+	void TimedOutInterests (Ptr<const ndn::pit::Entry> entry)
+	{
+		PitOutcome (entry, icctrace::TIMED_OUT_INTERESTS);
+	}
+
+	void PeriodicPrinter ()
+	{
+		icctrace::TraceWriter &writer = m_file->GetWriter ();
+		double now = Simulator::Now ().GetSeconds ();
+
+		for (std::map<Ptr<const ndn::Face>, Counts>::iterator it = m_stats.begin (); it != m_stats.end (); it++)
+		{
+			Counts &counts = it->second;
+			for (uint8_t type = 0; type < icctrace::L3_TYPES; type++)
+			{
+				if (counts.packets[type] == 0 && counts.bytes[type] == 0)
+					continue;
+
+				writer.AddL3 (now, m_node, counts.faceId, type, counts.packets[type], counts.bytes[type]);
+				counts.packets[type] = 0;
+				counts.bytes[type] = 0;
+			}
+		}
+
+		m_file->NotePeriod (Simulator::Now ());
+		m_printEvent = Simulator::Schedule (m_period, &BinaryL3Tracer::PeriodicPrinter, this);
+	}
+
+	Ptr<BinaryTraceFile> m_file;
+	Time m_period;
+	uint32_t m_node;
+	EventId m_printEvent;
+	std::map<Ptr<const ndn::Face>, Counts> m_stats;
+};
+
+// Writes the consumer delay samples of a node, like AppDelayTracer
+class BinaryAppDelayTracer : public SimpleRefCount<BinaryAppDelayTracer>
+{
+public:
+	BinaryAppDelayTracer (Ptr<BinaryTraceFile> file, Ptr<Node> node)
+		: m_file (file)
+	{
+		m_node = m_file->GetWriter ().Intern (BinaryTraceFile::NodeName (node));
+
+		for (uint32_t i = 0; i < node->GetNApplications (); i++)
+		{
+			Ptr<ndn::App> app = DynamicCast<ndn::App> (node->GetApplication (i));
+			if (app == 0)
+				continue;
+
+			app->TraceConnectWithoutContext ("LastRetransmittedInterestDataDelay", MakeCallback (&BinaryAppDelayTracer::LastRetxDelay, this));
+			app->TraceConnectWithoutContext ("FirstInterestDataDelay", MakeCallback (&BinaryAppDelayTracer::FirstDelay, this));
+		}
+	}
+
+private:
+	void LastRetxDelay (Ptr<ndn::App> app, uint32_t seqno, Time delay, int32_t hopCount)
+	{
+		m_file->GetWriter ().AddApp (Simulator::Now ().GetSeconds (), m_node, app->GetId (), seqno,
+				icctrace::LAST_DELAY, delay.GetSeconds (), 1, hopCount);
+	}
+
+	void FirstDelay (Ptr<ndn::App> app, uint32_t seqno, Time delay, uint32_t retxCount, int32_t hopCount)
+	{
+		m_file->GetWriter ().AddApp (Simulator::Now ().GetSeconds (), m_node, app->GetId (), seqno,
+				icctrace::FULL_DELAY, delay.GetSeconds (), retxCount, hopCount);
+	}
+
+	Ptr<BinaryTraceFile> m_file;
+	uint32_t m_node;
+};
+
+// Keeps the binary tracers of a run alive and closes their files after it
+class BinaryTracers
+{
+public:
+	// Like L3AggregateTracer::Install, for every node in nodes
+	void InstallL3 (const NodeContainer &nodes, const std::string &path, Time period, bool compress)
+	{
+		Ptr<BinaryTraceFile> file = Create<BinaryTraceFile> (path, icctrace::CONTENT_L3, period, compress);
+		m_files.push_back (file);
+
+		for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+			m_l3.push_back (Create<BinaryL3Tracer> (file, *i, period));
+	}
+
+	// Like AppDelayTracer::Install, for every node in nodes
+	void InstallAppDelay (const NodeContainer &nodes, const std::string &path, bool compress)
+	{
+		Ptr<BinaryTraceFile> file = Create<BinaryTraceFile> (path, icctrace::CONTENT_APP, Seconds (0), compress);
+		m_files.push_back (file);
+
+		for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+			m_app.push_back (Create<BinaryAppDelayTracer> (file, *i));
+	}
+
+	// Write out what is still buffered, call once the simulation has run
+	void Close ()
+	{
+		for (uint32_t i = 0; i < m_files.size (); i++)
+			m_files[i]->Close ();
+	}
+
+private:
+	std::vector<Ptr<BinaryTraceFile> > m_files;
+	std::vector<Ptr<BinaryL3Tracer> > m_l3;
+	std::vector<Ptr<BinaryAppDelayTracer> > m_app;
+};
+
+} // namespace ns3
+
+#endif // ICC_BINARY_TRACER_H
@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-capture.h
+ *  Capture of the interests the consumers of the ICC scenario send
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-capture is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-capture is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-capture.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A capture is a tab separated file. Two # lines give the number of
+// sectors and the sector of every AP, then one row per interest: the
+// simulated second it was sent, where it entered the routers (ap or
+// central), the AP or sector index and the name. An interest of a mobile
+// enters at the AP the mobile was last handed to; one of an application on
+// a central node (fake interests, prefetching) at that central node
+
+#ifndef ICC_CAPTURE_H
+#define ICC_CAPTURE_H
+
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+#include "icc-handover.h"
+#include "icc-topology.h"
+
+namespace ns3 {
+
+// One interest of a capture
+struct CapturedInterest
+{
+	double time;
+	bool central;                                 // Entered at a central node, else at an AP
+	uint32_t index;                               // Sector of the central node or AP
+	std::string name;
+};
+
+// Writes the interests the consumers send to a capture file
+class InterestCapture
+{
+public:
+	InterestCapture (const HandoverEngine &handover)
+		: m_handover (handover), m_written (0), m_unplaced (0)
+	{
+	}
+
+	void Open (const std::string &path, const IccTopology &topo)
+	{
+		m_os.open (path.c_str ());
+		m_os << "# sectors " << topo.GetNSectors () << "\n";
+		m_os << "# ap_sectors";
+		for (uint32_t i = 0; i < topo.GetNAps (); i++)
+			m_os << " " << topo.GetSector (i);
+		m_os << "\n";
+		m_os << "time_s\tnode\tindex\tname\n";
+		m_os << std::fixed << std::setprecision (6);
+	}
+
+	// The mobiles in the order they were added to the handover engine
+	void AddMobiles (const NodeContainer &mobiles)
+	{
+		for (uint32_t i = 0; i < mobiles.GetN (); i++)
+			Connect (mobiles.Get (i), false, i);
+	}
+
+	// The central nodes by sector
+	void AddCentrals (const NodeContainer &centrals)
+	{
+		for (uint32_t s = 0; s < centrals.GetN (); s++)
+			Connect (centrals.Get (s), true, s);
+	}
+
+	void Close ()
+	{
+		m_os.close ();
+	}
+
+	uint64_t GetWritten () const
+	{
+		return m_written;
+	}
+
+	// Interests of mobiles not handed to an AP yet, not written
+	uint64_t GetUnplaced () const
+	{
+		return m_unplaced;
+	}
+
+	// Reads the capture at path. Returns false with a message in error when
+	// it cannot be read
+	static bool Read (const std::string &path, std::vector<uint32_t> &apSector, std::vector<CapturedInterest> &interests,
+			std::string &error)
+	{
+		std::ifstream in (path.c_str ());
+		if (!in)
+		{
+			error = "Cannot read " + path;
+			return false;
+		}
+
+		uint32_t sectors = 0;
+		std::string line;
+		for (uint32_t number = 1; std::getline (in, line); number++)
+		{
+			std::istringstream fields (line);
+			if (line.empty () || line.compare (0, 6, "time_s") == 0)
+				continue;
+
+			if (line[0] == '#')
+			{
+				std::string hash, key;
+				fields >> hash >> key;
+				uint32_t value;
+				if (key == "sectors")
+					fields >> sectors;
+				else if (key == "ap_sectors")
+					while (fields >> value)
+						apSector.push_back (value);
+				continue;
+			}
+
+			CapturedInterest interest;
+			std::string node;
+			if (!(fields >> interest.time >> node >> interest.index >> interest.name) || (node != "ap" && node != "central"))
+			{
+				std::ostringstream message;
+				message << path << ":" << number << ": expected time, ap or central, index and name";
+				error = message.str ();
+				return false;
+			}
+			interest.central = node == "central";
+
+			if (interest.index >= (interest.central ? sectors : apSector.size ()))
+			{
+				std::ostringstream message;
+				message << path << ":" << number << ": no " << node << " " << interest.index;
+				error = message.str ();
+				return false;
+			}
+			interests.push_back (interest);
+		}
+
+		for (uint32_t i = 0; i < apSector.size (); i++)
+		{
+			if (apSector[i] >= sectors)
+			{
+				error = path + ": an AP is in a sector past the number of sectors";
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	// Where the interests of an application enter the routers
+	struct Source
+	{
+		InterestCapture *capture;
+		bool central;
+		uint32_t index;                               // Sector, or mobile in the handover engine
+	};
+
+	void Connect (Ptr<Node> node, bool central, uint32_t index)
+	{
+		for (uint32_t i = 0; i < node->GetNApplications (); i++)
+		{
+			Ptr<ndn::App> app = DynamicCast<ndn::App> (node->GetApplication (i));
+			if (app == 0)
+				continue;
+
+			Source source;
+			source.capture = this;
+			source.central = central;
+			source.index = index;
+			m_sources.push_back (source);
+			app->TraceConnectWithoutContext ("TransmittedInterests", MakeBoundCallback (&InterestCapture::Sent, &m_sources.back ()));
+		}
+	}
+
+	static void Sent (Source *source, Ptr<const ndn::Interest> interest, Ptr<ndn::App> app, Ptr<ndn::Face> face)
+	{
+		InterestCapture *capture = source->capture;
+
+		int32_t index = source->index;
+		if (!source->central)
+			index = capture->m_handover.GetCurrentAp (source->index);
+		if (index < 0)
+		{
+			capture->m_unplaced++;
+			return;
+		}
+
+		capture->m_os << Simulator::Now ().GetSeconds () << "\t" << (source->central ? "central" : "ap") << "\t" << index << "\t"
+				<< interest->GetName () << "\n";
+		capture->m_written++;
+	}
+
+	const HandoverEngine &m_handover;
+	std::ofstream m_os;
+	std::deque<Source> m_sources;                 // Bound to the trace callbacks, never moved
+	uint64_t m_written;
+	uint64_t m_unplaced;
+};
+
+} // namespace ns3
+
+#endif // ICC_CAPTURE_H
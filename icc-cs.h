@@ -0,0 +1,479 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-cs.h
+ *  Compact Content Store and Content Store occupancy sampling
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-cs is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-cs is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-cs.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_CS_H
+#define ICC_CS_H
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+#include "icc-metrics.h"
+
+namespace ns3 {
+
+// No slot, as a list link or in the hash index of the arena store
+static const uint32_t ICC_CS_NIL = 0xffffffff;
+
+// Slots the arena store grows by, at least
+static const uint32_t ICC_CS_CHUNK = 1024;
+
+// LRU Content Store kept in an arena of slots instead of a trie with a node,
+// an entry and policy hooks allocated per Data packet. The slots grow in
+// chunks up to MaxSize and are reused once the store is full, so a store
+// that has reached its working set allocates nothing more: evicting and
+// adding is relinking two list indices and one hash index entry. The hash
+// index is open addressed with linear probing and kept at most half full.
+//
+// Lookups match the full Data name, as every interest of the scenario names
+// a segment. Prefix matching and Exclude are not supported, and neither is
+// freshness, which the scenario's producers leave unset
+class ArenaContentStore : public ndn::ContentStore
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccArenaContentStore")
+			.SetParent<ndn::ContentStore> ()
+			.AddConstructor<ArenaContentStore> ()
+			.AddAttribute ("MaxSize", "Most Data packets the store holds, 0 caches nothing",
+					UintegerValue (100),
+					MakeUintegerAccessor (&ArenaContentStore::SetMaxSize, &ArenaContentStore::GetMaxSize),
+					MakeUintegerChecker<uint32_t> ());
+		return tid;
+	}
+
+	ArenaContentStore ()
+		: m_maxSize (100), m_size (0), m_head (ICC_CS_NIL), m_tail (ICC_CS_NIL), m_free (ICC_CS_NIL), m_mask (0)
+	{
+	}
+
+	virtual Ptr<ndn::Data> Lookup (Ptr<const ndn::Interest> interest)
+	{
+		uint32_t slot = Find (interest->GetName ());
+		if (slot == ICC_CS_NIL)
+		{
+			this->m_cacheMissesTrace (interest);
+			return 0;
+		}
+
+		Unlink (slot);
+		PushFront (slot);
+
+		this->m_cacheHitsTrace (interest, m_slots[slot].data);
+
+		// As the ndnSIM stores do, hand out a copy without the stored tags
+		Ptr<ndn::Data> copy = m_slots[slot].data->Copy ();
+		ConstCast<Packet> (copy->GetPayload ())->RemoveAllPacketTags ();
+		return copy;
+	}
+
+	// Data already held is left where it is, as in the ndnSIM LRU store
+	virtual bool Add (Ptr<const ndn::Data> data)
+	{
+		if (m_maxSize == 0 || Find (data->GetName ()) != ICC_CS_NIL)
+			return false;
+
+		uint32_t slot;
+		if (m_size >= m_maxSize)
+		{
+			slot = m_tail;
+			Remove (slot);
+		}
+		else if (m_free != ICC_CS_NIL)
+		{
+			slot = m_free;
+			m_free = m_slots[slot].next;
+		}
+		else
+		{
+			Reserve (m_slots.size () + 1);
+			slot = m_slots.size ();
+			m_slots.push_back (Slot ());
+		}
+
+		Slot &s = m_slots[slot];
+		s.data = data;
+		s.hash = Hash (data->GetName ());
+		m_index[Probe (data->GetName (), s.hash)] = slot;
+		PushFront (slot);
+		m_size++;
+		return true;
+	}
+
+	virtual void Print (std::ostream &os) const
+	{
+		for (uint32_t slot = m_head; slot != ICC_CS_NIL; slot = m_slots[slot].next)
+			os << m_slots[slot].data->GetName () << std::endl;
+	}
+
+	virtual uint32_t GetSize () const
+	{
+		return m_size;
+	}
+
+	// From the most to the least recently used
+	virtual Ptr<ndn::cs::Entry> Begin ()
+	{
+		return MakeEntry (m_head);
+	}
+
+	virtual Ptr<ndn::cs::Entry> End ()
+	{
+		return 0;
+	}
+
+	virtual Ptr<ndn::cs::Entry> Next (Ptr<ndn::cs::Entry> from)
+	{
+		if (from == 0)
+			return 0;
+
+		uint32_t slot = Find (from->GetName ());
+		return slot != ICC_CS_NIL ? MakeEntry (m_slots[slot].next) : 0;
+	}
+
+	// Shrinking evicts the least recently used Data, the freed slots are
+	// kept for later
+	void SetMaxSize (uint32_t maxSize)
+	{
+		m_maxSize = maxSize;
+		while (m_size > m_maxSize)
+		{
+			uint32_t slot = m_tail;
+			Remove (slot);
+			m_slots[slot].next = m_free;
+			m_free = slot;
+		}
+	}
+
+	uint32_t GetMaxSize () const
+	{
+		return m_maxSize;
+	}
+
+	// Slots allocated so far, held or free
+	uint32_t GetReserved () const
+	{
+		return m_slots.capacity ();
+	}
+
+protected:
+	virtual void DoDispose (void)
+	{
+		m_slots.clear ();
+		m_index.clear ();
+		m_size = 0;
+		m_head = m_tail = m_free = ICC_CS_NIL;
+		ndn::ContentStore::DoDispose ();
+	}
+
+private:
+	struct Slot
+	{
+		Slot ()
+			: hash (0), prev (ICC_CS_NIL), next (ICC_CS_NIL)
+		{
+		}
+
+		Ptr<const ndn::Data> data;
+		uint32_t hash;
+		uint32_t prev;                                // Towards the most recently used, ICC_CS_NIL at the head
+		uint32_t next;                                // Towards the least recently used, or the next free slot
+	};
+
+	// FNV-1a over the name components, with their lengths between them
+	static uint32_t Hash (const ndn::Name &name)
+	{
+		uint32_t h = 2166136261u;
+		for (ndn::Name::const_iterator c = name.begin (); c != name.end (); ++c)
+		{
+			for (ndn::name::Component::const_iterator b = c->begin (); b != c->end (); ++b)
+				h = (h ^ static_cast<uint8_t> (*b)) * 16777619u;
+			h = (h ^ static_cast<uint32_t> (c->size ())) * 16777619u;
+		}
+		return h;
+	}
+
+	// Index position holding name, or the empty one where it would go
+	uint32_t Probe (const ndn::Name &name, uint32_t hash) const
+	{
+		uint32_t i = hash & m_mask;
+		while (m_index[i] != ICC_CS_NIL)
+		{
+			const Slot &s = m_slots[m_index[i]];
+			if (s.hash == hash && s.data->GetName () == name)
+				break;
+			i = (i + 1) & m_mask;
+		}
+		return i;
+	}
+
+	uint32_t Find (const ndn::Name &name) const
+	{
+		return m_index.empty () ? ICC_CS_NIL : m_index[Probe (name, Hash (name))];
+	}
+
+	// Makes room for slots slots without moving them later on every push_back.
+	// The index is grown with them, to twice their number
+	void Reserve (uint32_t slots)
+	{
+		if (slots <= m_slots.capacity ())
+			return;
+
+		uint32_t capacity = std::max<uint32_t> (slots, std::max<uint32_t> (ICC_CS_CHUNK, m_slots.capacity () * 2));
+		m_slots.reserve (std::min (capacity, std::max (m_maxSize, slots)));
+
+		uint32_t size = 1;
+		while (size < 2 * m_slots.capacity ())
+			size *= 2;
+		if (size <= m_index.size ())
+			return;
+
+		m_index.assign (size, ICC_CS_NIL);
+		m_mask = size - 1;
+		for (uint32_t slot = m_head; slot != ICC_CS_NIL; slot = m_slots[slot].next)
+			m_index[Probe (m_slots[slot].data->GetName (), m_slots[slot].hash)] = slot;
+	}
+
+	// Takes a held slot out of the list and the index, and drops its Data
+	void Remove (uint32_t slot)
+	{
+		Slot &s = m_slots[slot];
+
+		// Backward shift deletion: later entries of the probe run move into
+		// the hole unless that would put them before their home position
+		uint32_t hole = Probe (s.data->GetName (), s.hash);
+		for (uint32_t i = (hole + 1) & m_mask; m_index[i] != ICC_CS_NIL; i = (i + 1) & m_mask)
+		{
+			uint32_t home = m_slots[m_index[i]].hash & m_mask;
+			if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+			{
+				m_index[hole] = m_index[i];
+				hole = i;
+			}
+		}
+		m_index[hole] = ICC_CS_NIL;
+
+		Unlink (slot);
+		s.data = 0;
+		m_size--;
+	}
+
+	void Unlink (uint32_t slot)
+	{
+		Slot &s = m_slots[slot];
+		if (s.prev != ICC_CS_NIL)
+			m_slots[s.prev].next = s.next;
+		else
+			m_head = s.next;
+		if (s.next != ICC_CS_NIL)
+			m_slots[s.next].prev = s.prev;
+		else
+			m_tail = s.prev;
+		s.prev = s.next = ICC_CS_NIL;
+	}
+
+	void PushFront (uint32_t slot)
+	{
+		Slot &s = m_slots[slot];
+		s.prev = ICC_CS_NIL;
+		s.next = m_head;
+		if (m_head != ICC_CS_NIL)
+			m_slots[m_head].prev = slot;
+		else
+			m_tail = slot;
+		m_head = slot;
+	}
+
+	Ptr<ndn::cs::Entry> MakeEntry (uint32_t slot)
+	{
+		if (slot == ICC_CS_NIL)
+			return 0;
+		return Create<ndn::cs::Entry> (this, m_slots[slot].data);
+	}
+
+	std::vector<Slot> m_slots;                    // The arena, never shrinks
+	std::vector<uint32_t> m_index;                // Slot by hash, ICC_CS_NIL where empty
+	uint32_t m_maxSize;
+	uint32_t m_size;                              // Slots holding Data
+	uint32_t m_head;                              // Most recently used
+	uint32_t m_tail;                              // Least recently used, evicted first
+	uint32_t m_free;                              // Slots freed by shrinking, linked through next
+	uint32_t m_mask;                              // Index size - 1
+};
+
+// Samples the Content Stores of the router nodes every interval, one row
+// per node with the Data held, their payload bytes, and the hits and
+// misses so far. On Stop the peak over the samples of each node class, and
+// of all classes together, are kept for WriteSummary
+class CsMonitor
+{
+public:
+	void Add (const NodeContainer &nodes, NodeClass cls)
+	{
+		for (uint32_t i = 0; i < nodes.GetN (); i++)
+		{
+			m_stores.push_back (Store ());
+			m_stores.back ().node = nodes.Get (i)->GetId ();
+			m_stores.back ().cls = cls;
+			m_stores.back ().cs = nodes.Get (i)->GetObject<ndn::ContentStore> ();
+		}
+	}
+
+	// Nodes must not be added after this is called
+	void Start (const std::string &path, Time interval)
+	{
+		for (uint32_t i = 0; i < m_stores.size (); i++)
+		{
+			m_stores[i].cs->TraceConnectWithoutContext ("CacheHits", MakeBoundCallback (&CsMonitor::CacheHit, &m_stores[i]));
+			m_stores[i].cs->TraceConnectWithoutContext ("CacheMisses", MakeBoundCallback (&CsMonitor::CacheMiss, &m_stores[i]));
+		}
+
+		m_peaks.assign (NODE_CLASSES + 1, Peak ());
+
+		m_interval = interval;
+		m_os.open (path.c_str ());
+		m_os << "time\tnode\tclass\tentries\tbytes\thits\tmisses\n";
+
+		m_event = Simulator::Schedule (m_interval, &CsMonitor::Sample, this);
+	}
+
+	void Stop ()
+	{
+		if (!m_os.is_open ())
+			return;
+
+		Simulator::Cancel (m_event);
+		Sample ();
+		m_os.close ();
+	}
+
+	// One row per node class with stores, and the total, written after Stop
+	void WriteSummary (const std::string &path, const std::string &header) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "# " << header << "\n";
+		os << "class\tnodes\tpeak_entries\tpeak_bytes\thits\tmisses\thit_ratio\n";
+
+		for (uint32_t c = 0; c <= NODE_CLASSES; c++)
+		{
+			uint32_t nodes = 0;
+			uint64_t hits = 0, misses = 0;
+			for (uint32_t i = 0; i < m_stores.size (); i++)
+			{
+				if (c != NODE_CLASSES && m_stores[i].cls != c)
+					continue;
+				nodes++;
+				hits += m_stores[i].hits;
+				misses += m_stores[i].misses;
+			}
+			if (nodes == 0)
+				continue;
+
+			os << (c == NODE_CLASSES ? "all" : NODE_CLASS_NAMES[c]) << "\t" << nodes << "\t" << m_peaks[c].entries << "\t"
+					<< m_peaks[c].bytes << "\t" << hits << "\t" << misses << "\t"
+					<< (hits + misses ? static_cast<double> (hits) / (hits + misses) : 0) << "\n";
+		}
+	}
+
+private:
+	struct Store
+	{
+		Store ()
+			: node (0), cls (CLASS_CENTRAL), hits (0), misses (0)
+		{
+		}
+
+		uint32_t node;
+		NodeClass cls;
+		Ptr<ndn::ContentStore> cs;
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	struct Peak
+	{
+		Peak ()
+			: entries (0), bytes (0)
+		{
+		}
+
+		uint64_t entries;
+		uint64_t bytes;
+	};
+
+	static void CacheHit (Store *store, Ptr<const ndn::Interest> interest, Ptr<const ndn::Data> data)
+	{
+		store->hits++;
+	}
+
+	static void CacheMiss (Store *store, Ptr<const ndn::Interest> interest)
+	{
+		store->misses++;
+	}
+
+	void Sample ()
+	{
+		double now = Simulator::Now ().GetSeconds ();
+		std::vector<Peak> sums (NODE_CLASSES + 1);
+
+		for (uint32_t i = 0; i < m_stores.size (); i++)
+		{
+			Store &store = m_stores[i];
+
+			uint64_t bytes = 0;
+			for (Ptr<ndn::cs::Entry> e = store.cs->Begin (); e != store.cs->End (); e = store.cs->Next (e))
+				bytes += e->GetData ()->GetPayload ()->GetSize ();
+
+			uint32_t entries = store.cs->GetSize ();
+			m_os << now << "\t" << store.node << "\t" << NODE_CLASS_NAMES[store.cls] << "\t" << entries << "\t" << bytes
+					<< "\t" << store.hits << "\t" << store.misses << "\n";
+
+			sums[store.cls].entries += entries;
+			sums[store.cls].bytes += bytes;
+			sums[NODE_CLASSES].entries += entries;
+			sums[NODE_CLASSES].bytes += bytes;
+		}
+
+		for (uint32_t c = 0; c <= NODE_CLASSES; c++)
+		{
+			m_peaks[c].entries = std::max (m_peaks[c].entries, sums[c].entries);
+			m_peaks[c].bytes = std::max (m_peaks[c].bytes, sums[c].bytes);
+		}
+
+		if (!Simulator::IsFinished ())
+			m_event = Simulator::Schedule (m_interval, &CsMonitor::Sample, this);
+	}
+
+	std::vector<Store> m_stores;
+	std::vector<Peak> m_peaks;                    // By node class, then all classes
+	Time m_interval;
+	EventId m_event;
+	std::ofstream m_os;
+};
+
+} // namespace ns3
+
+#endif // ICC_CS_H
@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-distributed.h
+ *  Partitioning of the ICC scenario over MPI ranks
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-distributed is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-distributed is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-distributed.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Every rank builds the whole topology with the same node ids, and each
+// node carries the rank that runs it as its system id. Links between nodes
+// of different ranks become remote point to point channels, the 5 ms of
+// the central to server links being the lookahead. A Wifi channel cannot
+// span ranks, so each rank only installs Wifi, applications and tracers
+// on its own nodes: its sectors' APs and the mobiles that live there.
+//
+// Without MPI there is one rank and everything is local.
+
+#ifndef ICC_DISTRIBUTED_H
+#define ICC_DISTRIBUTED_H
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+
+#include "icc-topology.h"
+#include "icc-waypoint-format.h"
+
+namespace ns3 {
+
+// Which rank runs which node. Sectors go to ranks in consecutive blocks, so
+// a rank holds one stretch of road (or of the hex grid), and the APs and
+// central node of a sector always share its rank. The servers are on rank 0
+// and mobile i on rank i % ranks, within the area of that rank's sectors.
+// A trace that takes a mobile elsewhere is refused, see CheckRecords
+class RankPlan
+{
+public:
+	RankPlan ()
+		: m_rank (0), m_ranks (1)
+	{
+	}
+
+	// Ranks must not outnumber the sectors, every rank needs APs for its mobiles
+	void Assign (const IccTopology &topo, uint32_t rank, uint32_t ranks)
+	{
+		m_rank = rank;
+		m_ranks = ranks;
+
+		uint32_t sectors = topo.GetNSectors ();
+		m_sectorRank.resize (sectors);
+		for (uint32_t s = 0; s < sectors; s++)
+			m_sectorRank[s] = static_cast<uint64_t> (s) * ranks / sectors;
+
+		m_apRank.resize (topo.GetNAps ());
+		for (uint32_t i = 0; i < topo.GetNAps (); i++)
+			m_apRank[i] = m_sectorRank[topo.GetSector (i)];
+	}
+
+	uint32_t GetRank () const
+	{
+		return m_rank;
+	}
+
+	uint32_t GetNRanks () const
+	{
+		return m_ranks;
+	}
+
+	uint32_t GetSectorRank (uint32_t sector) const
+	{
+		return m_sectorRank[sector];
+	}
+
+	uint32_t GetApRank (uint32_t ap) const
+	{
+		return m_apRank[ap];
+	}
+
+	uint32_t GetMobileRank (uint32_t mobile) const
+	{
+		return mobile % m_ranks;
+	}
+
+	uint32_t GetServerRank (uint32_t server) const
+	{
+		return 0;
+	}
+
+	// A mobile only ever reaches the APs of its own rank, a traced one has
+	// to stay in their area. Returns false with a message in error at the
+	// first record that takes one of the mobiles (the ns-2 nodes below
+	// mobiles) nearer to an AP of another rank, at a waypoint or at the end
+	// of a setdest
+	bool CheckRecords (const IccTopology &topo, const iccwaypoint::Record *records, uint64_t n, uint32_t mobiles,
+			std::string &error) const
+	{
+		double nan = std::numeric_limits<double>::quiet_NaN ();
+		std::vector<Vector> position (mobiles, Vector (nan, nan, 0));
+		for (uint64_t i = 0; i < n; i++)
+		{
+			const iccwaypoint::Record &r = records[i];
+			if (r.node >= mobiles)
+				continue;
+
+			Vector &p = position[r.node];
+			if (iccwaypoint::IsSet (r.x)) p.x = r.x;
+			if (iccwaypoint::IsSet (r.y)) p.y = r.y;
+			if (!iccwaypoint::IsSet (p.x) || !iccwaypoint::IsSet (p.y))
+				continue;
+
+			uint32_t ap = NearestAp (topo, p);
+			if (m_apRank[ap] != GetMobileRank (r.node))
+			{
+				std::ostringstream message;
+				message << "-distributed: mobile " << r.node << " runs on rank " << GetMobileRank (r.node)
+						<< " but its trace takes it to (" << p.x << ", " << p.y << ") at " << r.time
+						<< " s, nearest to AP " << ap << " of rank " << m_apRank[ap]
+						<< ". Traced mobiles have to stay within their rank's sectors";
+				error = message.str ();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IsLocal (Ptr<Node> node) const
+	{
+		return node->GetSystemId () == m_rank;
+	}
+
+	// The nodes of a container this rank runs, in container order
+	NodeContainer GetLocal (const NodeContainer &nodes) const
+	{
+		NodeContainer local;
+		for (uint32_t i = 0; i < nodes.GetN (); i++)
+		{
+			if (IsLocal (nodes.Get (i)))
+				local.Add (nodes.Get (i));
+		}
+		return local;
+	}
+
+private:
+	static uint32_t NearestAp (const IccTopology &topo, const Vector &p)
+	{
+		uint32_t nearest = 0;
+		double best = std::numeric_limits<double>::max ();
+		for (uint32_t i = 0; i < topo.GetNAps (); i++)
+		{
+			const Vector &ap = topo.GetAp (i);
+			double d = (ap.x - p.x) * (ap.x - p.x) + (ap.y - p.y) * (ap.y - p.y);
+			if (d < best)
+			{
+				best = d;
+				nearest = i;
+			}
+		}
+		return nearest;
+	}
+
+	uint32_t m_rank;
+	uint32_t m_ranks;
+	std::vector<uint32_t> m_sectorRank;
+	std::vector<uint32_t> m_apRank;
+};
+
+} // namespace ns3
+
+#endif // ICC_DISTRIBUTED_H
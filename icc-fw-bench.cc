@@ -0,0 +1,477 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-fw-bench.cc
+ *  Forwarding strategy, PIT and Content Store benchmark on the ICC routers
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-fw-bench is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-fw-bench is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-fw-bench.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Replays the interests of a scenario capture (icc-scenario -capture)
+// through the routers of the ICC topology: the APs, the central nodes and
+// the server, with the forwarding strategies and Content Stores of the
+// scenario. There is no Wifi and no net device: the routers are joined by
+// faces that hand a copy of each packet to the face at the other end after
+// the link delay. An interest of a mobile enters at its AP, one of a
+// central node application at that node, and the Data comes from an
+// ndn::Producer on the server, as in the scenario.
+//
+// Every strategy runs with every Content Store size, one after the other.
+// The wall time and the heap allocations of each replay are divided by the
+// packets the forwarding strategies handled (interests and Data in), and
+// written to fw-bench.tsv
+
+// Standard C++ modules
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+// ns3 modules
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+
+// ndnSIM modules
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+// Extensions
+#include "icc-alloc-count.h"
+#include "icc-capture.h"
+#include "icc-pool.h"
+
+using namespace ns3;
+using namespace std;
+
+typedef struct timeval TIMER_TYPE;
+#define TIMER_NOW(_t) gettimeofday (&_t,NULL);
+#define TIMER_SECONDS(_t) ((double)(_t).tv_sec + (_t).tv_usec*1e-6)
+#define TIMER_DIFF(_t1, _t2) (TIMER_SECONDS (_t1)-TIMER_SECONDS (_t2))
+
+NS_LOG_COMPONENT_DEFINE ("icc-fw-bench");
+
+// Strategies of the scenario, by the names of run-sweep.py
+static const char *const STRATEGY_NAMES[] = { "flood", "smart", "bestr" };
+static const char *const STRATEGY_TYPES[] = {
+	"ns3::ndn::fw::Flooding::PerOutFaceLimits",
+	"ns3::ndn::fw::SmartFlooding::PerOutFaceLimits",
+	"ns3::ndn::fw::BestRoute::PerOutFaceLimits"
+};
+static const uint32_t STRATEGIES = 3;
+
+// Face of a router standing in for a link or a Wifi card. Joined to a peer,
+// it hands every packet sent to the peer after the delay, as a copy like a
+// received packet would be. Without one, the packets stop here and are
+// counted
+class BenchFace : public ndn::Face
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccBenchFace")
+			.SetParent<ndn::Face> ();
+		return tid;
+	}
+
+	BenchFace (Ptr<Node> node)
+		: Face (node), m_interests (0), m_datas (0)
+	{
+	}
+
+	void Connect (Ptr<BenchFace> peer, Time delay)
+	{
+		m_peer = peer;
+		m_delay = delay;
+	}
+
+	// The peers of a link hold each other
+	void Disconnect ()
+	{
+		m_peer = 0;
+	}
+
+	virtual bool SendInterest (Ptr<const ndn::Interest> interest)
+	{
+		if (!IsUp ())
+			return false;
+
+		m_interests++;
+		if (m_peer != 0)
+			Simulator::Schedule (m_delay, &ndn::Face::ReceiveInterest, m_peer, Create<ndn::Interest> (*interest));
+		return true;
+	}
+
+	virtual bool SendData (Ptr<const ndn::Data> data)
+	{
+		if (!IsUp ())
+			return false;
+
+		m_datas++;
+		if (m_peer != 0)
+			Simulator::Schedule (m_delay, &ndn::Face::ReceiveData, m_peer, Create<ndn::Data> (*data));
+		return true;
+	}
+
+	virtual std::ostream &Print (std::ostream &os) const
+	{
+		os << "dev=bench(" << GetId () << ")";
+		return os;
+	}
+
+	uint64_t GetInterests () const
+	{
+		return m_interests;
+	}
+
+	uint64_t GetDatas () const
+	{
+		return m_datas;
+	}
+
+private:
+	Ptr<BenchFace> m_peer;
+	Time m_delay;
+	uint64_t m_interests;                         // Sent to this face
+	uint64_t m_datas;
+};
+
+// Benchmark arguments
+struct BenchConfig
+{
+	BenchConfig ()
+		: results ("results"), strategies ("flood,smart,bestr"), csSizes ("100,10000,10000000"), delay (0.005),
+		  lifetime (2), limit (0), drain (5)
+	{
+	}
+
+	std::string capture;                          // Capture written by icc-scenario -capture
+	std::string results;                          // Directory for fw-bench.tsv
+	std::string strategies;                       // Strategies to run, comma separated (flood | smart | bestr)
+	std::string csSizes;                          // Content Store sizes to run, comma separated
+	double delay;                                 // Delay of the router links (seconds)
+	double lifetime;                              // Interest lifetime (seconds)
+	uint32_t limit;                               // Interests of the capture replayed (0 is all)
+	double drain;                                 // Simulated seconds run past the last interest
+};
+
+// What a replay of the capture cost
+struct BenchResult
+{
+	uint64_t packets;                             // Interests and Data in, at every router
+	uint64_t delivered;                           // Data handed back where the interests entered, not per interest
+	double wall;                                  // Seconds spent in Simulator::Run
+	uint64_t allocations;                         // Heap allocations in Simulator::Run
+	uint32_t pitPeak;                             // Most PIT entries over all routers at a sample
+	uint32_t csEntries;                           // Content Store entries over all routers at the end
+};
+
+static void CountPacket (uint64_t *packets, Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+{
+	(*packets)++;
+}
+
+static void CountData (uint64_t *packets, Ptr<const ndn::Data> data, Ptr<const ndn::Face> face)
+{
+	(*packets)++;
+}
+
+// Injects the captured interests at their simulated times, one event at a time
+class Replay
+{
+public:
+	Replay (const std::vector<CapturedInterest> &interests, const std::vector<Ptr<ndn::Name> > &names, uint32_t count,
+			Time lifetime)
+		: m_interests (interests), m_names (names), m_count (count), m_lifetime (lifetime), m_next (0)
+	{
+		// Every replay draws the same nonces
+		m_rand = CreateObject<UniformRandomVariable> ();
+		m_rand->SetStream (0);
+	}
+
+	void Start (const std::vector<Ptr<BenchFace> > &apFaces, const std::vector<Ptr<BenchFace> > &centralFaces)
+	{
+		m_apFaces = apFaces;
+		m_centralFaces = centralFaces;
+		if (m_count > 0)
+			Simulator::Schedule (Seconds (m_interests[0].time), &Replay::Inject, this);
+	}
+
+	// Sampled every interval while the replay runs
+	void SamplePit (const NodeContainer &routers, Time interval)
+	{
+		m_routers = routers;
+		m_pitPeak = 0;
+		m_interval = interval;
+		Simulator::Schedule (interval, &Replay::Sample, this);
+	}
+
+	uint32_t GetPitPeak () const
+	{
+		return m_pitPeak;
+	}
+
+private:
+	void Inject ()
+	{
+		const CapturedInterest &captured = m_interests[m_next];
+
+		Ptr<ndn::Interest> interest = Create<ndn::Interest> ();
+		interest->SetNonce (m_rand->GetInteger (0, std::numeric_limits<uint32_t>::max ()));
+		interest->SetName (m_names[m_next]);
+		interest->SetInterestLifetime (m_lifetime);
+
+		Ptr<BenchFace> face = captured.central ? m_centralFaces[captured.index] : m_apFaces[captured.index];
+		face->ReceiveInterest (interest);
+
+		if (++m_next < m_count)
+			Simulator::Schedule (Seconds (m_interests[m_next].time) - Simulator::Now (), &Replay::Inject, this);
+	}
+
+	void Sample ()
+	{
+		uint32_t entries = 0;
+		for (uint32_t i = 0; i < m_routers.GetN (); i++)
+			entries += m_routers.Get (i)->GetObject<ndn::Pit> ()->GetSize ();
+		m_pitPeak = std::max (m_pitPeak, entries);
+
+		if (m_next < m_count)
+			Simulator::Schedule (m_interval, &Replay::Sample, this);
+	}
+
+	const std::vector<CapturedInterest> &m_interests;
+	const std::vector<Ptr<ndn::Name> > &m_names;
+	uint32_t m_count;
+	Time m_lifetime;
+	uint32_t m_next;                              // Interest injected next
+	Ptr<UniformRandomVariable> m_rand;            // Nonces
+	std::vector<Ptr<BenchFace> > m_apFaces;       // Wifi cards of the APs
+	std::vector<Ptr<BenchFace> > m_centralFaces;  // Applications of the central nodes
+	NodeContainer m_routers;
+	Time m_interval;
+	uint32_t m_pitPeak;
+};
+
+// Adds a face to the node, with the default route the stack helper gives
+// net device faces when route is set
+static Ptr<BenchFace> AddFace (Ptr<Node> node, bool route)
+{
+	Ptr<BenchFace> face = CreateObject<BenchFace> (node);
+	node->GetObject<ndn::L3Protocol> ()->AddFace (face);
+	face->SetUp (true);
+	if (route)
+		node->GetObject<ndn::Fib> ()->Add (ndn::Name ("/"), face, std::numeric_limits<int32_t>::max ());
+	return face;
+}
+
+// A pair of faces joining a and b, added to links
+static void Link (Ptr<Node> a, Ptr<Node> b, Time delay, std::vector<Ptr<BenchFace> > &links)
+{
+	Ptr<BenchFace> fa = AddFace (a, true);
+	Ptr<BenchFace> fb = AddFace (b, true);
+	fa->Connect (fb, delay);
+	fb->Connect (fa, delay);
+	links.push_back (fa);
+	links.push_back (fb);
+}
+
+// Replays the capture once through routers running strategy with csSize
+// Content Stores
+BenchResult RunBench (const BenchConfig &cfg, const std::vector<uint32_t> &apSector,
+		const std::vector<CapturedInterest> &interests, const std::vector<Ptr<ndn::Name> > &names, uint32_t count,
+		const char *strategy, const std::string &csSize)
+{
+	uint32_t sectors = 0;
+	for (uint32_t i = 0; i < apSector.size (); i++)
+		sectors = std::max (sectors, apSector[i] + 1);
+	for (uint32_t i = 0; i < count; i++)
+		if (interests[i].central)
+			sectors = std::max (sectors, interests[i].index + 1);
+
+	NodeContainer centrals;
+	centrals.Create (sectors);
+	NodeContainer aps;
+	aps.Create (apSector.size ());
+	NodeContainer servers;
+	servers.Create (1);
+
+	NodeContainer routers;
+	routers.Add (centrals);
+	routers.Add (aps);
+
+	ndn::StackHelper routerStack;
+	routerStack.SetForwardingStrategy (strategy, "Limit", "ns3::ndn::Limits::Window");
+	routerStack.SetContentStore ("ns3::ndn::cs::Freshness::Lru", "MaxSize", csSize);
+	routerStack.Install (routers);
+
+	ndn::StackHelper serverStack;
+	serverStack.SetForwardingStrategy ("ns3::ndn::fw::BestRoute");
+	serverStack.SetContentStore ("ns3::ndn::cs::Nocache");
+	serverStack.Install (servers);
+
+	// Every AP to the central node of its sector, the server to every central node
+	Time delay = Seconds (cfg.delay);
+	std::vector<Ptr<BenchFace> > links;
+	for (uint32_t i = 0; i < aps.GetN (); i++)
+		Link (centrals.Get (apSector[i]), aps.Get (i), delay, links);
+	for (uint32_t s = 0; s < sectors; s++)
+		Link (servers.Get (0), centrals.Get (s), delay, links);
+
+	// The Wifi card of every AP has a default route, the applications of the central nodes do not
+	std::vector<Ptr<BenchFace> > apFaces;
+	for (uint32_t i = 0; i < aps.GetN (); i++)
+		apFaces.push_back (AddFace (aps.Get (i), true));
+	std::vector<Ptr<BenchFace> > centralFaces;
+	for (uint32_t s = 0; s < sectors; s++)
+		centralFaces.push_back (AddFace (centrals.Get (s), false));
+
+	ndn::AppHelper producerHelper ("ns3::ndn::Producer");
+	producerHelper.SetPrefix ("/waseda/sato");
+	producerHelper.SetAttribute ("PayloadSize", UintegerValue (1024));
+	producerHelper.Install (servers);
+
+	BenchResult result;
+	result.packets = 0;
+	for (uint32_t i = 0; i < routers.GetN (); i++)
+	{
+		Ptr<ndn::ForwardingStrategy> fw = routers.Get (i)->GetObject<ndn::ForwardingStrategy> ();
+		fw->TraceConnectWithoutContext ("InInterests", MakeBoundCallback (&CountPacket, &result.packets));
+		fw->TraceConnectWithoutContext ("InData", MakeBoundCallback (&CountData, &result.packets));
+	}
+
+	Replay replay (interests, names, count, Seconds (cfg.lifetime));
+	replay.Start (apFaces, centralFaces);
+	replay.SamplePit (routers, Seconds (0.1));
+
+	Simulator::Stop (Seconds ((count > 0 ? interests[count - 1].time : 0) + cfg.drain));
+
+	uint64_t allocations = AllocStatsReporter::GetCounters ().allocations;
+	TIMER_TYPE start, end;
+	TIMER_NOW (start);
+	Simulator::Run ();
+	TIMER_NOW (end);
+
+	result.wall = TIMER_DIFF (end, start);
+	result.allocations = AllocStatsReporter::GetCounters ().allocations - allocations;
+	result.pitPeak = replay.GetPitPeak ();
+
+	result.delivered = 0;
+	for (uint32_t i = 0; i < apFaces.size (); i++)
+		result.delivered += apFaces[i]->GetDatas ();
+	for (uint32_t s = 0; s < centralFaces.size (); s++)
+		result.delivered += centralFaces[s]->GetDatas ();
+
+	result.csEntries = 0;
+	for (uint32_t i = 0; i < routers.GetN (); i++)
+		result.csEntries += routers.Get (i)->GetObject<ndn::ContentStore> ()->GetSize ();
+
+	for (uint32_t i = 0; i < links.size (); i++)
+		links[i]->Disconnect ();
+	Simulator::Destroy ();
+	return result;
+}
+
+// Splits a comma separated list
+static std::vector<std::string> SplitList (const std::string &list)
+{
+	std::vector<std::string> items;
+	std::istringstream in (list);
+	std::string item;
+	while (std::getline (in, item, ','))
+	{
+		if (!item.empty ())
+			items.push_back (item);
+	}
+	return items;
+}
+
+int main (int argc, char *argv[])
+{
+	BenchConfig cfg;
+	char buffer[250];
+
+	CommandLine cmd;
+	cmd.AddValue ("capture", "Capture written by icc-scenario -capture (interests.tsv)", cfg.capture);
+	cmd.AddValue ("results", "Directory to place fw-bench.tsv", cfg.results);
+	cmd.AddValue ("strategies", "Forwarding strategies to run, comma separated: flood, smart, bestr", cfg.strategies);
+	cmd.AddValue ("csSizes", "Content Store sizes to run, comma separated", cfg.csSizes);
+	cmd.AddValue ("delay", "Delay of the links between the routers (Seconds)", cfg.delay);
+	cmd.AddValue ("lifetime", "Lifetime of the replayed interests (Seconds)", cfg.lifetime);
+	cmd.AddValue ("limit", "Interests of the capture replayed (0 is all)", cfg.limit);
+	cmd.AddValue ("drain", "Simulated seconds run past the last interest", cfg.drain);
+	cmd.Parse (argc, argv);
+
+	if (cfg.capture.empty ())
+		NS_FATAL_ERROR ("Give the capture to replay with -capture");
+
+	std::vector<uint32_t> apSector;
+	std::vector<CapturedInterest> interests;
+	std::string error;
+	if (!InterestCapture::Read (cfg.capture, apSector, interests, error))
+		NS_FATAL_ERROR (error);
+
+	uint32_t count = interests.size ();
+	if (cfg.limit > 0)
+		count = std::min (count, cfg.limit);
+
+	// Names are parsed once, and shared by the replays
+	std::vector<Ptr<ndn::Name> > names;
+	names.reserve (count);
+	for (uint32_t i = 0; i < count; i++)
+		names.push_back (Create<ndn::Name> (interests[i].name));
+
+	std::vector<uint32_t> strategies;
+	std::vector<std::string> strategyNames = SplitList (cfg.strategies);
+	for (uint32_t k = 0; k < strategyNames.size (); k++)
+	{
+		uint32_t s = 0;
+		while (s < STRATEGIES && strategyNames[k] != STRATEGY_NAMES[s])
+			s++;
+		if (s == STRATEGIES)
+			NS_FATAL_ERROR ("Unknown strategy " << strategyNames[k] << ", use flood, smart or bestr");
+		strategies.push_back (s);
+	}
+	std::vector<std::string> csSizes = SplitList (cfg.csSizes);
+
+	SystemPath::MakeDirectories (cfg.results);
+	std::string path = cfg.results + "/fw-bench.tsv";
+	std::ofstream table (path.c_str ());
+	table << "# " << cfg.capture << ": " << count << " interests, " << apSector.size () << " APs, link delay " << cfg.delay << " s\n";
+	table << "strategy\tcs_size\tpackets\tdata_delivered\twall_s\tns_per_packet\tallocs_per_packet\tpit_peak\tcs_entries\n";
+
+	for (uint32_t k = 0; k < strategies.size (); k++)
+	{
+		for (uint32_t c = 0; c < csSizes.size (); c++)
+		{
+			const char *name = STRATEGY_NAMES[strategies[k]];
+			BenchResult r = RunBench (cfg, apSector, interests, names, count, STRATEGY_TYPES[strategies[k]], csSizes[c]);
+
+			double nsPerPacket = r.packets ? r.wall * 1e9 / r.packets : 0;
+			double allocsPerPacket = r.packets ? (double) r.allocations / r.packets : 0;
+			table << name << "\t" << csSizes[c] << "\t" << r.packets << "\t" << r.delivered << "\t" << r.wall << "\t"
+					<< nsPerPacket << "\t" << allocsPerPacket << "\t" << r.pitPeak << "\t" << r.csEntries << "\n";
+
+			sprintf(buffer, "%s csSize %s: %lu packets, %.0f ns and %.1f allocations per packet, %lu Data delivered for %u interests",
+					name, csSizes[c].c_str (), (unsigned long) r.packets, nsPerPacket, allocsPerPacket,
+					(unsigned long) r.delivered, count);
+			NS_LOG_INFO(buffer);
+		}
+	}
+
+	table.close ();
+	sprintf(buffer, "Written to %s", path.c_str ());
+	NS_LOG_INFO(buffer);
+	return 0;
+}
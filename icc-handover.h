@@ -0,0 +1,603 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-handover.h
+ *  Nearest AP spatial index and handover engine for the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-handover is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-handover is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-handover.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_HANDOVER_H
+#define ICC_HANDOVER_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/mobility-module.h>
+#include <ns3-dev/ns3/wifi-module.h>
+
+namespace ns3 {
+
+// Uniform grid over the (static) AP positions. The grid is built once at
+// setup and stored as a compressed cell list, so a nearest AP query only
+// walks rings of cells around the query point and never allocates.
+class ApSpatialIndex
+{
+public:
+	ApSpatialIndex ()
+		: m_minX (0), m_minY (0), m_cellSize (1), m_nx (0), m_ny (0)
+	{
+	}
+
+	// Build the grid. A cellSize <= 0 picks one that leaves roughly one AP per cell
+	void Build (const std::vector<Vector> &positions, double cellSize = 0)
+	{
+		m_pos = positions;
+		m_cellStart.clear ();
+		m_cellAps.clear ();
+		m_nx = m_ny = 0;
+
+		if (m_pos.empty ())
+			return;
+
+		double maxX = m_pos[0].x;
+		double maxY = m_pos[0].y;
+		m_minX = m_pos[0].x;
+		m_minY = m_pos[0].y;
+
+		for (uint32_t i = 1; i < m_pos.size (); i++)
+		{
+			m_minX = std::min (m_minX, m_pos[i].x);
+			m_minY = std::min (m_minY, m_pos[i].y);
+			maxX = std::max (maxX, m_pos[i].x);
+			maxY = std::max (maxY, m_pos[i].y);
+		}
+
+		double width = maxX - m_minX;
+		double height = maxY - m_minY;
+
+		if (cellSize <= 0)
+		{
+			double area = width * height;
+			// APs laid out along a road have no area, so split the longest side instead
+			if (area > 0)
+				cellSize = std::sqrt (area / m_pos.size ());
+			else
+				cellSize = std::max (width, height) / m_pos.size ();
+		}
+
+		m_cellSize = (cellSize > 0) ? cellSize : 1.0;
+		m_nx = static_cast<int32_t> (width / m_cellSize) + 1;
+		m_ny = static_cast<int32_t> (height / m_cellSize) + 1;
+
+		// Counting sort of the APs into their cells
+		m_cellStart.assign (m_nx * m_ny + 1, 0);
+		m_cellAps.resize (m_pos.size ());
+
+		for (uint32_t i = 0; i < m_pos.size (); i++)
+			m_cellStart[CellOf (m_pos[i]) + 1]++;
+
+		for (uint32_t c = 0; c < m_cellStart.size () - 1; c++)
+			m_cellStart[c + 1] += m_cellStart[c];
+
+		std::vector<uint32_t> fill (m_cellStart.begin (), m_cellStart.end () - 1);
+		for (uint32_t i = 0; i < m_pos.size (); i++)
+			m_cellAps[fill[CellOf (m_pos[i])]++] = i;
+	}
+
+	// Index of the AP closest to pos, -1 when the index is empty. Ties go to
+	// the lowest AP index
+	int32_t Nearest (const Vector &pos, double *distance = 0) const
+	{
+		if (m_pos.empty ())
+			return -1;
+
+		int32_t cx = ClampX (pos.x);
+		int32_t cy = ClampY (pos.y);
+		int32_t best = -1;
+		double bestD2 = std::numeric_limits<double>::infinity ();
+
+		for (int32_t r = 0; ; r++)
+		{
+			int32_t x0 = cx - r;
+			int32_t x1 = cx + r;
+			int32_t y0 = cy - r;
+			int32_t y1 = cy + r;
+
+			// Only the outer ring of the (2r+1)^2 box is new on this pass
+			for (int32_t y = std::max (y0, 0); y <= std::min (y1, m_ny - 1); y++)
+			{
+				int32_t step = (y == y0 || y == y1) ? 1 : x1 - x0;
+
+				for (int32_t x = x0; x <= x1; x += step)
+				{
+					if (x < 0 || x >= m_nx)
+						continue;
+
+					uint32_t c = y * m_nx + x;
+					for (uint32_t k = m_cellStart[c]; k < m_cellStart[c + 1]; k++)
+					{
+						uint32_t ap = m_cellAps[k];
+						double dx = m_pos[ap].x - pos.x;
+						double dy = m_pos[ap].y - pos.y;
+						double dz = m_pos[ap].z - pos.z;
+						double d2 = dx * dx + dy * dy + dz * dz;
+
+						if (d2 < bestD2 || (d2 == bestD2 && static_cast<int32_t> (ap) < best))
+						{
+							bestD2 = d2;
+							best = ap;
+						}
+					}
+				}
+			}
+
+			// Any AP not yet visited lies beyond one of the box sides that has
+			// not reached the edge of the grid
+			bool more = false;
+			double bound = std::numeric_limits<double>::infinity ();
+
+			if (x0 > 0)
+			{
+				bound = std::min (bound, pos.x - (m_minX + x0 * m_cellSize));
+				more = true;
+			}
+			if (x1 < m_nx - 1)
+			{
+				bound = std::min (bound, m_minX + (x1 + 1) * m_cellSize - pos.x);
+				more = true;
+			}
+			if (y0 > 0)
+			{
+				bound = std::min (bound, pos.y - (m_minY + y0 * m_cellSize));
+				more = true;
+			}
+			if (y1 < m_ny - 1)
+			{
+				bound = std::min (bound, m_minY + (y1 + 1) * m_cellSize - pos.y);
+				more = true;
+			}
+
+			if (!more || (best >= 0 && bestD2 <= bound * bound))
+				break;
+		}
+
+		if (distance)
+			*distance = std::sqrt (bestD2);
+
+		return best;
+	}
+
+	// Call f (ap) for every AP within radius of pos
+	template <class F>
+	void ForEachWithin (const Vector &pos, double radius, F &f) const
+	{
+		if (m_pos.empty ())
+			return;
+
+		int32_t x0 = ClampX (pos.x - radius);
+		int32_t x1 = ClampX (pos.x + radius);
+		int32_t y0 = ClampY (pos.y - radius);
+		int32_t y1 = ClampY (pos.y + radius);
+		double r2 = radius * radius;
+
+		for (int32_t y = y0; y <= y1; y++)
+		{
+			for (int32_t x = x0; x <= x1; x++)
+			{
+				uint32_t c = y * m_nx + x;
+				for (uint32_t k = m_cellStart[c]; k < m_cellStart[c + 1]; k++)
+				{
+					uint32_t ap = m_cellAps[k];
+					double dx = m_pos[ap].x - pos.x;
+					double dy = m_pos[ap].y - pos.y;
+					double dz = m_pos[ap].z - pos.z;
+
+					if (dx * dx + dy * dy + dz * dz <= r2)
+						f (ap);
+				}
+			}
+		}
+	}
+
+	uint32_t GetN () const
+	{
+		return m_pos.size ();
+	}
+
+	const Vector &GetPosition (uint32_t ap) const
+	{
+		return m_pos[ap];
+	}
+
+private:
+	int32_t ClampX (double x) const
+	{
+		double c = std::floor ((x - m_minX) / m_cellSize);
+		return static_cast<int32_t> (std::max (0.0, std::min (c, m_nx - 1.0)));
+	}
+
+	int32_t ClampY (double y) const
+	{
+		double c = std::floor ((y - m_minY) / m_cellSize);
+		return static_cast<int32_t> (std::max (0.0, std::min (c, m_ny - 1.0)));
+	}
+
+	uint32_t CellOf (const Vector &pos) const
+	{
+		return ClampY (pos.y) * m_nx + ClampX (pos.x);
+	}
+
+	std::vector<Vector> m_pos;
+	std::vector<uint32_t> m_cellStart;  // m_cellAps offsets, one per cell plus an end marker
+	std::vector<uint32_t> m_cellAps;    // AP indices grouped by cell
+	double m_minX;
+	double m_minY;
+	double m_cellSize;
+	int32_t m_nx;
+	int32_t m_ny;
+};
+
+class HandoverEngine;
+
+// Handover state kept for every mobile terminal
+struct MobileHandoverState
+{
+	HandoverEngine *engine;
+	uint32_t index;            // Position in the engine's mobile list
+	uint32_t nodeId;
+	Ptr<MobilityModel> mobility;
+	int32_t currentAp;         // AP whose SSID the station was last given
+	Ptr<WifiMac> mac;          // Station MAC, resolved once at setup
+	EventId nextCheck;         // Pending check for this mobile
+	Callback<double> timeToCourseChange;  // For mobility models without CourseChange events
+};
+
+// Finds the first bisector between the current AP and a neighbour that a
+// mobile crosses while moving in a straight line. Used with
+// ApSpatialIndex::ForEachWithin over the candidate neighbours
+struct BoundaryCrossing
+{
+	BoundaryCrossing (const ApSpatialIndex &index, uint32_t ap, const Vector &pos, const Vector &vel)
+		: index (index), ap (ap), pos (pos), vel (vel),
+		  time (std::numeric_limits<double>::infinity ()), next (-1)
+	{
+	}
+
+	void operator() (uint32_t b)
+	{
+		if (b == ap)
+			return;
+
+		const Vector &pa = index.GetPosition (ap);
+		const Vector &pb = index.GetPosition (b);
+
+		double dx = pb.x - pa.x;
+		double dy = pb.y - pa.y;
+		double dz = pb.z - pa.z;
+
+		// Points x equidistant to both APs satisfy 2 x.(b - a) = |b|^2 - |a|^2.
+		// The mobile only reaches that plane when moving towards b
+		double closing = vel.x * dx + vel.y * dy + vel.z * dz;
+		if (closing <= 0)
+			return;
+
+		double rhs = (pb.x * pb.x + pb.y * pb.y + pb.z * pb.z) - (pa.x * pa.x + pa.y * pa.y + pa.z * pa.z);
+		double t = (rhs - 2 * (pos.x * dx + pos.y * dy + pos.z * dz)) / (2 * closing);
+		t = std::max (t, 0.0);
+
+		if (t < time)
+		{
+			time = t;
+			next = b;
+		}
+	}
+
+	const ApSpatialIndex &index;
+	uint32_t ap;
+	Vector pos;
+	Vector vel;
+	double time;     // Seconds until the crossing, infinity if none
+	int32_t next;    // AP on the other side of the crossing
+};
+
+// Wifi channel of every AP. Stations are moved to the channel of the AP
+// they are handed over to, so a transmission is only received, and its
+// propagation loss only computed, by the PHYs on the sender's channel
+class ChannelPlan
+{
+public:
+	// APs in groups (sectors, or single APs) take channels round robin from
+	// channels distinct ones: 1, 6 and 11 for up to three, 1 to 13 otherwise
+	void Assign (const std::vector<uint32_t> &apGroup, uint32_t channels)
+	{
+		channels = std::max (1u, std::min (13u, channels));
+		uint32_t step = channels <= 3 ? 5 : 1;
+
+		m_apChannel.resize (apGroup.size ());
+		for (uint32_t i = 0; i < apGroup.size (); i++)
+			m_apChannel[i] = 1 + (apGroup[i] % channels) * step;
+	}
+
+	uint16_t GetApChannel (uint32_t ap) const
+	{
+		return ap < m_apChannel.size () ? m_apChannel[ap] : 1;
+	}
+
+	void AddStation (uint32_t nodeId, Ptr<YansWifiPhy> phy)
+	{
+		if (nodeId >= m_stations.size ())
+			m_stations.resize (nodeId + 1);
+		m_stations[nodeId] = phy;
+	}
+
+	// Handover callback
+	void Handover (uint32_t nodeId, uint32_t ap, double distance)
+	{
+		if (nodeId >= m_stations.size () || m_stations[nodeId] == 0)
+			return;
+
+		uint16_t channel = GetApChannel (ap);
+		if (m_stations[nodeId]->GetChannelNumber () != channel)
+			m_stations[nodeId]->SetChannelNumber (channel);
+	}
+
+private:
+	std::vector<uint16_t> m_apChannel;
+	std::vector<Ptr<YansWifiPhy> > m_stations;    // By node id
+};
+
+// Answers nearest AP queries for the mobile terminals against the spatial
+// index and moves the stations to the SSID of the closest AP
+class HandoverEngine
+{
+public:
+	// Register an AP. Its position is read once, when Build is called
+	void AddAp (const Ssid &ssid, Ptr<MobilityModel> mobility)
+	{
+		m_ssids.push_back (ssid);
+		m_apMobility.push_back (mobility);
+	}
+
+	// Build the spatial index over the registered APs
+	void Build (double cellSize = 0)
+	{
+		std::vector<Vector> positions;
+		positions.reserve (m_apMobility.size ());
+
+		for (uint32_t i = 0; i < m_apMobility.size (); i++)
+			positions.push_back (m_apMobility[i]->GetPosition ());
+
+		m_index.Build (positions, cellSize);
+	}
+
+	HandoverEngine ()
+		: m_checked (0), m_applied (0)
+	{
+	}
+
+	// Register a mobile terminal, returns the index used by CheckMobile. The
+	// station MAC is kept so SSID changes skip the Config path lookup
+	uint32_t AddMobile (uint32_t nodeId, Ptr<MobilityModel> mobility, Ptr<WifiMac> mac, int32_t initialAp)
+	{
+		MobileHandoverState state;
+		state.engine = this;
+		state.index = m_mobiles.size ();
+		state.nodeId = nodeId;
+		state.mobility = mobility;
+		state.currentAp = initialAp;
+		state.mac = mac;
+
+		m_mobiles.push_back (state);
+		return m_mobiles.size () - 1;
+	}
+
+	// Mobility models that move without course change events (trajectories)
+	// tell through cb how many seconds remain until their velocity changes
+	void SetCourseChangeHorizon (uint32_t mobile, Callback<double> cb)
+	{
+		m_mobiles[mobile].timeToCourseChange = cb;
+	}
+
+	// Look up the AP nearest to the mobile and point its station at that SSID,
+	// unless it is already there
+	void CheckMobile (uint32_t mobile)
+	{
+		MobileHandoverState &state = m_mobiles[mobile];
+
+		double distance;
+		int32_t ap = m_index.Nearest (state.mobility->GetPosition (), &distance);
+
+		m_checked++;
+
+		if (ap < 0 || ap == state.currentAp)
+			return;
+
+		m_applied++;
+		m_handover (state.nodeId, ap, distance);
+
+		state.mac->SetSsid (m_ssids[ap]);
+		state.currentAp = ap;
+	}
+
+	// Check every mobile now, and then again every interval
+	void StartPolling (Time interval)
+	{
+		for (uint32_t i = 0; i < m_mobiles.size (); i++)
+			m_mobiles[i].nextCheck = Simulator::ScheduleNow (&HandoverEngine::Poll, this, i, interval);
+	}
+
+	// Check every mobile now, and then only when it is due to cross into the
+	// area of another AP. Crossings are computed from the mobile's velocity
+	// whenever its course changes; a mobile that keeps moving in a straight
+	// line without crossing is looked at again after horizon. Mobiles must
+	// not be added after this is called
+	void StartEventDriven (Time horizon)
+	{
+		m_horizon = horizon;
+
+		for (uint32_t i = 0; i < m_mobiles.size (); i++)
+		{
+			m_mobiles[i].mobility->TraceConnectWithoutContext ("CourseChange",
+					MakeBoundCallback (&HandoverEngine::CourseChanged, &m_mobiles[i]));
+			m_mobiles[i].nextCheck = Simulator::ScheduleNow (&HandoverEngine::Evaluate, this, i);
+		}
+	}
+
+	// Called with (node id, AP index, distance) whenever a station is moved to another AP
+	void ConnectHandover (Callback<void, uint32_t, uint32_t, double> cb)
+	{
+		m_handover.ConnectWithoutContext (cb);
+	}
+
+	const Ssid &GetSsid (uint32_t ap) const
+	{
+		return m_ssids[ap];
+	}
+
+	// AP the mobile was last handed to, the one it was added with until its
+	// first handover
+	int32_t GetCurrentAp (uint32_t mobile) const
+	{
+		return m_mobiles[mobile].currentAp;
+	}
+
+	// The AP the mobile is handed to next if it keeps its course, and in how
+	// many seconds. Looks no further than horizon or the next course change
+	bool PredictNextAp (uint32_t mobile, double horizon, uint32_t &next, double &time) const
+	{
+		const MobileHandoverState &state = m_mobiles[mobile];
+		if (state.currentAp < 0)
+			return false;
+
+		Vector vel = state.mobility->GetVelocity ();
+		if (vel.x == 0 && vel.y == 0 && vel.z == 0)
+			return false;
+
+		double h = horizon;
+		if (!state.timeToCourseChange.IsNull ())
+			h = std::min (h, state.timeToCourseChange ());
+
+		BoundaryCrossing crossing = FindCrossing (state, state.mobility->GetPosition (), vel, h);
+		if (crossing.next < 0 || crossing.time >= h)
+			return false;
+
+		next = crossing.next;
+		time = crossing.time;
+		return true;
+	}
+
+	uint32_t GetNMobiles () const
+	{
+		return m_mobiles.size ();
+	}
+
+	// Number of nearest AP checks done
+	uint64_t GetChecked () const
+	{
+		return m_checked;
+	}
+
+	// Number of checks that moved a station to another AP
+	uint64_t GetApplied () const
+	{
+		return m_applied;
+	}
+
+private:
+	void Poll (uint32_t mobile, Time interval)
+	{
+		CheckMobile (mobile);
+		m_mobiles[mobile].nextCheck = Simulator::Schedule (interval, &HandoverEngine::Poll, this, mobile, interval);
+	}
+
+	static void CourseChanged (MobileHandoverState *state, Ptr<const MobilityModel> model)
+	{
+		state->engine->Evaluate (state->index);
+	}
+
+	// Check the mobile and schedule the next check for its next boundary crossing
+	void Evaluate (uint32_t mobile)
+	{
+		MobileHandoverState &state = m_mobiles[mobile];
+
+		Simulator::Cancel (state.nextCheck);
+		CheckMobile (mobile);
+
+		if (state.currentAp < 0)
+			return;
+
+		Vector pos = state.mobility->GetPosition ();
+		Vector vel = state.mobility->GetVelocity ();
+		double speed = std::sqrt (vel.x * vel.x + vel.y * vel.y + vel.z * vel.z);
+
+		double change = std::numeric_limits<double>::infinity ();
+		if (!state.timeToCourseChange.IsNull ())
+			change = state.timeToCourseChange ();
+
+		// A stopped mobile is looked at again on its next course change
+		if (speed == 0)
+		{
+			if (change < std::numeric_limits<double>::infinity ())
+				state.nextCheck = Simulator::Schedule (Seconds (change), &HandoverEngine::Evaluate, this, mobile);
+			return;
+		}
+
+		// The straight line ends at the next course change
+		double h = std::min (m_horizon.GetSeconds (), change);
+		BoundaryCrossing crossing = FindCrossing (state, pos, vel, h);
+
+		// Land just past the bisector so the nearest AP query sees the new AP
+		if (crossing.time < h)
+			state.nextCheck = Simulator::Schedule (Seconds (crossing.time) + MicroSeconds (1), &HandoverEngine::Evaluate, this, mobile);
+		else
+			state.nextCheck = Simulator::Schedule (Seconds (h), &HandoverEngine::Evaluate, this, mobile);
+	}
+
+	// First bisector around the current AP crossed within h seconds of moving
+	// at vel. Whatever bisector is crossed lies at most reach away from the
+	// current AP, so its neighbour is at most twice that away
+	BoundaryCrossing FindCrossing (const MobileHandoverState &state, const Vector &pos, const Vector &vel, double h) const
+	{
+		const Vector &ap = m_index.GetPosition (state.currentAp);
+		double dx = pos.x - ap.x;
+		double dy = pos.y - ap.y;
+		double dz = pos.z - ap.z;
+		double ex = dx + vel.x * h;
+		double ey = dy + vel.y * h;
+		double ez = dz + vel.z * h;
+		double reach = std::sqrt (std::max (dx * dx + dy * dy + dz * dz, ex * ex + ey * ey + ez * ez));
+
+		BoundaryCrossing crossing (m_index, state.currentAp, pos, vel);
+		m_index.ForEachWithin (ap, 2 * reach, crossing);
+		return crossing;
+	}
+
+	ApSpatialIndex m_index;
+	std::vector<Ssid> m_ssids;
+	std::vector<Ptr<MobilityModel> > m_apMobility;
+	std::vector<MobileHandoverState> m_mobiles;
+	TracedCallback<uint32_t, uint32_t, double> m_handover;
+	Time m_horizon;
+	uint64_t m_checked;
+	uint64_t m_applied;
+};
+
+} // namespace ns3
+
+#endif // ICC_HANDOVER_H
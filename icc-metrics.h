@@ -0,0 +1,477 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-metrics.h
+ *  In simulation metric aggregation for the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-metrics is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-metrics is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-metrics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_METRICS_H
+#define ICC_METRICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+namespace ns3 {
+
+// Log bucketed histogram of delays. Buckets are 1/64 of a power of two wide,
+// so percentiles are within about 1% of the true value, from 1us up to
+// about 12 days, in a fixed 20KB
+class DelayHistogram
+{
+public:
+	static const uint32_t SUB_BUCKETS = 64;
+	static const uint32_t OCTAVES = 40;
+	static const uint32_t BUCKETS = SUB_BUCKETS * OCTAVES;
+
+	DelayHistogram ()
+	{
+		Reset ();
+	}
+
+	void Reset ()
+	{
+		memset (m_counts, 0, sizeof (m_counts));
+		m_n = 0;
+		m_sum = 0;
+		m_min = std::numeric_limits<double>::infinity ();
+		m_max = 0;
+	}
+
+	void Add (double seconds)
+	{
+		double us = seconds * 1e6;
+		uint32_t bucket = 0;
+
+		if (us >= 1)
+			bucket = std::min<double> (BUCKETS - 1, std::floor (std::log (us) / std::log (2.0) * SUB_BUCKETS));
+
+		m_counts[bucket]++;
+		m_n++;
+		m_sum += seconds;
+		m_min = std::min (m_min, seconds);
+		m_max = std::max (m_max, seconds);
+	}
+
+	uint64_t GetCount () const
+	{
+		return m_n;
+	}
+
+	double GetMean () const
+	{
+		return m_n ? m_sum / m_n : 0;
+	}
+
+	double GetSum () const
+	{
+		return m_sum;
+	}
+
+	double GetMin () const
+	{
+		return m_n ? m_min : 0;
+	}
+
+	double GetMax () const
+	{
+		return m_max;
+	}
+
+	// Delay below which a fraction q of the samples fall, in seconds
+	double GetQuantile (double q) const
+	{
+		if (m_n == 0)
+			return 0;
+
+		uint64_t rank = static_cast<uint64_t> (std::ceil (q * m_n));
+		uint64_t seen = 0;
+
+		for (uint32_t i = 0; i < BUCKETS; i++)
+		{
+			seen += m_counts[i];
+			if (seen >= rank && m_counts[i] > 0)
+			{
+				// Middle of the bucket, clamped to what was actually seen
+				double mid = std::pow (2.0, (i + 0.5) / SUB_BUCKETS) * 1e-6;
+				return std::max (m_min, std::min (m_max, mid));
+			}
+		}
+
+		return m_max;
+	}
+
+private:
+	uint64_t m_counts[BUCKETS];
+	uint64_t m_n;
+	double m_sum;
+	double m_min;
+	double m_max;
+};
+
+// The node roles of the ICC topology
+enum NodeClass
+{
+	CLASS_MOBILE,
+	CLASS_CENTRAL,
+	CLASS_WIRELESS,
+	CLASS_SERVER,
+	NODE_CLASSES
+};
+
+static const char *const NODE_CLASS_NAMES[NODE_CLASSES] = { "mobile", "central", "wireless", "server" };
+
+// Everything kept for one class of nodes
+struct ClassMetrics
+{
+	ClassMetrics ()
+		: nodes (0), interestsSent (0), dataReceived (0), dataBytes (0), retransmissions (0), hopSum (0),
+		  handoverRetransmissions (0)
+	{
+		memset (l3, 0, sizeof (l3));
+	}
+
+	// Forwarding strategy counters
+	enum L3Counter
+	{
+		IN_INTERESTS, OUT_INTERESTS, DROP_INTERESTS,
+		IN_DATA, OUT_DATA, OUT_DATA_CACHED, DROP_DATA,
+		SATISFIED, TIMED_OUT,
+		L3_COUNTERS
+	};
+
+	uint32_t nodes;
+	uint64_t interestsSent;            // By the applications
+	uint64_t dataReceived;             // By the applications
+	uint64_t dataBytes;                // Payload bytes received by the applications
+	uint64_t retransmissions;          // Extra Interests sent for the Data received
+	double hopSum;                     // Hop counts of the Data received
+	DelayHistogram fullDelay;          // First Interest to Data
+	DelayHistogram lastDelay;          // Last retransmitted Interest to Data
+	DelayHistogram handoverDelay;      // First Interest to Data, for the Data received shortly after an AP change
+	uint64_t handoverRetransmissions;  // Extra Interests sent for those
+	std::vector<uint64_t> bytesPerSecond;
+	uint64_t l3[L3_COUNTERS];
+};
+
+// Counters kept for single nodes, small enough for thousands of mobiles
+struct NodeMetrics
+{
+	NodeMetrics ()
+		: tracked (false), interestsSent (0), dataReceived (0), retransmissions (0), delaySum (0), delayMax (0),
+		  hopSum (0), handovers (0)
+	{
+	}
+
+	bool tracked;
+	uint64_t interestsSent;
+	uint64_t dataReceived;
+	uint64_t retransmissions;
+	double delaySum;                              // Full delays of the Data received
+	double delayMax;
+	double hopSum;
+	uint64_t handovers;
+};
+
+// Attaches to the application and forwarding strategy trace sources of
+// the nodes, folds every event into the metrics of the node's class and
+// writes a single summary per run. Memory does not grow with the number of
+// packets, only with the simulated seconds of the throughput series
+class MetricsAggregator
+{
+public:
+	MetricsAggregator ()
+		: m_handoverWindow (0)
+	{
+	}
+
+	// Count the applications installed on nodes, call after installing them
+	void InstallApps (const NodeContainer &nodes, NodeClass cls)
+	{
+		for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+		{
+			for (uint32_t i = 0; i < (*n)->GetNApplications (); i++)
+			{
+				Ptr<ndn::App> app = DynamicCast<ndn::App> ((*n)->GetApplication (i));
+				if (app == 0)
+					continue;
+
+				ClassMetrics *m = &m_classes[cls];
+				app->TraceConnectWithoutContext ("FirstInterestDataDelay", MakeBoundCallback (&MetricsAggregator::FirstDelay, m));
+				app->TraceConnectWithoutContext ("LastRetransmittedInterestDataDelay", MakeBoundCallback (&MetricsAggregator::LastDelay, m));
+				app->TraceConnectWithoutContext ("TransmittedInterests", MakeBoundCallback (&MetricsAggregator::SentInterest, m));
+				app->TraceConnectWithoutContext ("ReceivedDatas", MakeBoundCallback (&MetricsAggregator::ReceivedData, m));
+			}
+		}
+	}
+
+	// Also keep NodeMetrics for each of nodes, call after installing the applications
+	void InstallPerNode (const NodeContainer &nodes)
+	{
+		for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+		{
+			uint32_t id = (*n)->GetId ();
+			if (id >= m_nodes.size ())
+				m_nodes.resize (id + 1);
+			m_nodes[id].tracked = true;
+
+			for (uint32_t i = 0; i < (*n)->GetNApplications (); i++)
+			{
+				Ptr<ndn::App> app = DynamicCast<ndn::App> ((*n)->GetApplication (i));
+				if (app == 0)
+					continue;
+
+				app->TraceConnectWithoutContext ("FirstInterestDataDelay", MakeCallback (&MetricsAggregator::NodeFirstDelay, this));
+				app->TraceConnectWithoutContext ("TransmittedInterests", MakeCallback (&MetricsAggregator::NodeSentInterest, this));
+			}
+		}
+	}
+
+	// Also keep the delays of the Data the mobiles receive within window
+	// after each of their AP changes, call after installing the applications
+	void InstallHandoverWindow (const NodeContainer &mobiles, Time window)
+	{
+		m_handoverWindow = window.GetSeconds ();
+		for (NodeContainer::Iterator n = mobiles.Begin (); n != mobiles.End (); ++n)
+		{
+			for (uint32_t i = 0; i < (*n)->GetNApplications (); i++)
+			{
+				Ptr<ndn::App> app = DynamicCast<ndn::App> ((*n)->GetApplication (i));
+				if (app != 0)
+					app->TraceConnectWithoutContext ("FirstInterestDataDelay", MakeCallback (&MetricsAggregator::HandoverDelay, this));
+			}
+		}
+	}
+
+	// Handover callback, counts the AP changes of tracked nodes and
+	// opens the handover window of the node
+	void NoteHandover (uint32_t nodeId, uint32_t ap, double distance)
+	{
+		if (nodeId < m_nodes.size ())
+			m_nodes[nodeId].handovers++;
+
+		if (nodeId >= m_lastHandover.size ())
+			m_lastHandover.resize (nodeId + 1, -1);
+		m_lastHandover[nodeId] = Simulator::Now ().GetSeconds ();
+	}
+
+	// Count the forwarding strategy events of nodes
+	void InstallL3 (const NodeContainer &nodes, NodeClass cls)
+	{
+		for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+		{
+			Ptr<ndn::ForwardingStrategy> fw = (*n)->GetObject<ndn::ForwardingStrategy> ();
+			ClassMetrics *m = &m_classes[cls];
+			m->nodes++;
+
+			fw->TraceConnectWithoutContext ("InInterests", MakeBoundCallback (&MetricsAggregator::InInterests, m));
+			fw->TraceConnectWithoutContext ("OutInterests", MakeBoundCallback (&MetricsAggregator::OutInterests, m));
+			fw->TraceConnectWithoutContext ("DropInterests", MakeBoundCallback (&MetricsAggregator::DropInterests, m));
+			fw->TraceConnectWithoutContext ("InData", MakeBoundCallback (&MetricsAggregator::InData, m));
+			fw->TraceConnectWithoutContext ("OutData", MakeBoundCallback (&MetricsAggregator::OutData, m));
+			fw->TraceConnectWithoutContext ("DropData", MakeBoundCallback (&MetricsAggregator::DropData, m));
+			fw->TraceConnectWithoutContext ("SatisfiedInterests", MakeBoundCallback (&MetricsAggregator::Satisfied, m));
+			fw->TraceConnectWithoutContext ("TimedOutInterests", MakeBoundCallback (&MetricsAggregator::TimedOut, m));
+		}
+	}
+
+	const ClassMetrics &GetClass (NodeClass cls) const
+	{
+		return m_classes[cls];
+	}
+
+	// Write the summary as "class.metric value" lines, header lines start with #
+	void Write (const std::string &path, const std::string &header) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "# " << header << "\n";
+
+		for (uint32_t c = 0; c < NODE_CLASSES; c++)
+		{
+			const ClassMetrics &m = m_classes[c];
+			const char *cls = NODE_CLASS_NAMES[c];
+
+			os << cls << ".nodes\t" << m.nodes << "\n";
+			os << cls << ".interests.sent\t" << m.interestsSent << "\n";
+			os << cls << ".data.received\t" << m.dataReceived << "\n";
+			os << cls << ".data.bytes\t" << m.dataBytes << "\n";
+			os << cls << ".retransmissions\t" << m.retransmissions << "\n";
+			os << cls << ".hops.mean\t" << (m.fullDelay.GetCount () ? m.hopSum / m.fullDelay.GetCount () : 0) << "\n";
+			WriteDelay (os, cls, "delay.full", m.fullDelay);
+			WriteDelay (os, cls, "delay.last", m.lastDelay);
+			WriteDelay (os, cls, "handover.delay", m.handoverDelay);
+			os << cls << ".handover.retransmissions\t" << m.handoverRetransmissions << "\n";
+
+			static const char *const l3Names[ClassMetrics::L3_COUNTERS] = {
+				"in_interests", "out_interests", "drop_interests",
+				"in_data", "out_data", "out_data_cached", "drop_data",
+				"satisfied", "timed_out"
+			};
+			for (uint32_t i = 0; i < ClassMetrics::L3_COUNTERS; i++)
+				os << cls << ".l3." << l3Names[i] << "\t" << m.l3[i] << "\n";
+
+			// Received payload per simulated second, in kilobytes
+			os << cls << ".throughput.kBps";
+			for (uint32_t s = 0; s < m.bytesPerSecond.size (); s++)
+				os << (s ? " " : "\t") << m.bytesPerSecond[s] / 1024.0;
+			os << "\n";
+		}
+	}
+
+	// One tab separated row per tracked node
+	void WritePerNode (const std::string &path) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "node\tinterests\tdata\tretx\tmean_delay_s\tmax_delay_s\tmean_hops\thandovers\n";
+
+		for (uint32_t id = 0; id < m_nodes.size (); id++)
+		{
+			const NodeMetrics &m = m_nodes[id];
+			if (!m.tracked)
+				continue;
+
+			os << id << "\t" << m.interestsSent << "\t" << m.dataReceived << "\t" << m.retransmissions << "\t"
+					<< (m.dataReceived ? m.delaySum / m.dataReceived : 0) << "\t" << m.delayMax << "\t"
+					<< (m.dataReceived ? m.hopSum / m.dataReceived : 0) << "\t" << m.handovers << "\n";
+		}
+	}
+
+private:
+	void NodeFirstDelay (Ptr<ndn::App> app, uint32_t seqno, Time delay, uint32_t retxCount, int32_t hopCount)
+	{
+		NodeMetrics &m = m_nodes[app->GetNode ()->GetId ()];
+		m.dataReceived++;
+		m.retransmissions += retxCount - 1;
+		m.delaySum += delay.GetSeconds ();
+		m.delayMax = std::max (m.delayMax, delay.GetSeconds ());
+		m.hopSum += hopCount;
+	}
+
+	void HandoverDelay (Ptr<ndn::App> app, uint32_t seqno, Time delay, uint32_t retxCount, int32_t hopCount)
+	{
+		uint32_t id = app->GetNode ()->GetId ();
+		if (id >= m_lastHandover.size () || m_lastHandover[id] < 0 ||
+				Simulator::Now ().GetSeconds () - m_lastHandover[id] > m_handoverWindow)
+			return;
+
+		ClassMetrics &m = m_classes[CLASS_MOBILE];
+		m.handoverDelay.Add (delay.GetSeconds ());
+		m.handoverRetransmissions += retxCount - 1;
+	}
+
+	void NodeSentInterest (Ptr<const ndn::Interest> interest, Ptr<ndn::App> app, Ptr<ndn::Face> face)
+	{
+		m_nodes[app->GetNode ()->GetId ()].interestsSent++;
+	}
+
+	static void WriteDelay (std::ostream &os, const char *cls, const char *name, const DelayHistogram &h)
+	{
+		os << cls << "." << name << ".count\t" << h.GetCount () << "\n";
+		os << cls << "." << name << ".mean\t" << h.GetMean () << "\n";
+		os << cls << "." << name << ".min\t" << h.GetMin () << "\n";
+		os << cls << "." << name << ".p50\t" << h.GetQuantile (0.50) << "\n";
+		os << cls << "." << name << ".p90\t" << h.GetQuantile (0.90) << "\n";
+		os << cls << "." << name << ".p95\t" << h.GetQuantile (0.95) << "\n";
+		os << cls << "." << name << ".p99\t" << h.GetQuantile (0.99) << "\n";
+		os << cls << "." << name << ".max\t" << h.GetMax () << "\n";
+	}
+
+	static void FirstDelay (ClassMetrics *m, Ptr<ndn::App> app, uint32_t seqno, Time delay, uint32_t retxCount, int32_t hopCount)
+	{
+		m->fullDelay.Add (delay.GetSeconds ());
+		m->retransmissions += retxCount - 1;
+		m->hopSum += hopCount;
+	}
+
+	static void LastDelay (ClassMetrics *m, Ptr<ndn::App> app, uint32_t seqno, Time delay, int32_t hopCount)
+	{
+		m->lastDelay.Add (delay.GetSeconds ());
+	}
+
+	static void SentInterest (ClassMetrics *m, Ptr<const ndn::Interest> interest, Ptr<ndn::App> app, Ptr<ndn::Face> face)
+	{
+		m->interestsSent++;
+	}
+
+	static void ReceivedData (ClassMetrics *m, Ptr<const ndn::Data> data, Ptr<ndn::App> app, Ptr<ndn::Face> face)
+	{
+		uint32_t second = static_cast<uint32_t> (Simulator::Now ().GetSeconds ());
+		if (second >= m->bytesPerSecond.size ())
+			m->bytesPerSecond.resize (second + 1, 0);
+
+		uint32_t size = data->GetPayload ()->GetSize ();
+		m->bytesPerSecond[second] += size;
+		m->dataBytes += size;
+		m->dataReceived++;
+	}
+
+	static void InInterests (ClassMetrics *m, Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		m->l3[ClassMetrics::IN_INTERESTS]++;
+	}
+
+	static void OutInterests (ClassMetrics *m, Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		m->l3[ClassMetrics::OUT_INTERESTS]++;
+	}
+
+	static void DropInterests (ClassMetrics *m, Ptr<const ndn::Interest> interest, Ptr<const ndn::Face> face)
+	{
+		m->l3[ClassMetrics::DROP_INTERESTS]++;
+	}
+
+	static void InData (ClassMetrics *m, Ptr<const ndn::Data> data, Ptr<const ndn::Face> face)
+	{
+		m->l3[ClassMetrics::IN_DATA]++;
+	}
+
+	static void OutData (ClassMetrics *m, Ptr<const ndn::Data> data, bool fromCache, Ptr<const ndn::Face> face)
+	{
+		m->l3[fromCache ? ClassMetrics::OUT_DATA_CACHED : ClassMetrics::OUT_DATA]++;
+	}
+
+	static void DropData (ClassMetrics *m, Ptr<const ndn::Data> data, Ptr<const ndn::Face> face)
+	{
+		m->l3[ClassMetrics::DROP_DATA]++;
+	}
+
+	static void Satisfied (ClassMetrics *m, Ptr<const ndn::pit::Entry> entry)
+	{
+		m->l3[ClassMetrics::SATISFIED]++;
+	}
+
+	static void TimedOut (ClassMetrics *m, Ptr<const ndn::pit::Entry> entry)
+	{
+		m->l3[ClassMetrics::TIMED_OUT]++;
+	}
+
+	ClassMetrics m_classes[NODE_CLASSES];
+	std::vector<NodeMetrics> m_nodes;             // By node id
+	std::vector<double> m_lastHandover;           // Last AP change by node id, -1 before the first
+	double m_handoverWindow;                      // Seconds after an AP change its Data counts for
+};
+
+} // namespace ns3
+
+#endif // ICC_METRICS_H
@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-pool.h
+ *  Packet object pools and allocation counts for the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-pool is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-pool is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-pool.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_POOL_H
+#define ICC_POOL_H
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+
+namespace ns3 {
+
+// Pooled objects looked at by a Get before it gives up and creates one
+static const uint32_t ICC_POOL_SCAN = 8;
+
+// What the pools of one packet type have done since the start of the process
+struct PoolCounters
+{
+	PoolCounters ()
+		: reused (0), created (0), unpooled (0)
+	{
+	}
+
+	uint64_t reused;                              // Gets answered with a released object
+	uint64_t created;                             // Objects created into a pool
+	uint64_t unpooled;                            // Objects created past the capacity, not kept
+};
+
+// Hands out objects of a reference counted ndnSIM type (Interest, Data,
+// Name) again once nothing but the pool holds them. Nobody tells the pool
+// when a packet is released, so Get looks at up to ICC_POOL_SCAN objects
+// from where it stopped last. Packets are mostly released in the order they
+// were handed out, so the next one is usually free. When none is, a new one
+// is created, and kept if the pool is under its capacity.
+//
+// A reused object keeps every field it had, the caller sets all it uses
+template <typename T>
+class RefPool
+{
+public:
+	RefPool (uint32_t capacity = 4096)
+		: m_capacity (capacity), m_next (0)
+	{
+	}
+
+	void SetCapacity (uint32_t capacity)
+	{
+		m_capacity = capacity;
+	}
+
+	// A free object, reused tells whether it has been handed out before
+	Ptr<T> Get (bool &reused)
+	{
+		PoolCounters &counters = GetCounters ();
+		uint32_t n = m_items.size ();
+		uint32_t scan = std::min (n, ICC_POOL_SCAN);
+		for (uint32_t k = 0; k < scan; k++)
+		{
+			const Ptr<T> &item = m_items[m_next];
+			m_next = m_next + 1 < n ? m_next + 1 : 0;
+			if (item->GetReferenceCount () == 1)
+			{
+				counters.reused++;
+				reused = true;
+				return item;
+			}
+		}
+
+		reused = false;
+		Ptr<T> item = Create<T> ();
+		if (n < m_capacity)
+		{
+			m_items.push_back (item);
+			counters.created++;
+		}
+		else
+			counters.unpooled++;
+		return item;
+	}
+
+	Ptr<T> Get ()
+	{
+		bool reused;
+		return Get (reused);
+	}
+
+	uint32_t GetSize () const
+	{
+		return m_items.size ();
+	}
+
+	static PoolCounters &GetCounters ()
+	{
+		static PoolCounters counters;
+		return counters;
+	}
+
+private:
+	uint32_t m_capacity;
+	uint32_t m_next;                              // Where the next Get starts looking
+	std::vector<Ptr<T> > m_items;
+};
+
+// Heap allocations of the process, counted by the operator new and delete
+// of icc-alloc-count.h
+struct AllocationCounters
+{
+	AllocationCounters ()
+		: allocations (0), frees (0), bytes (0)
+	{
+	}
+
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t bytes;                               // Asked for by the allocations
+};
+
+// Reports every interval of simulated time the heap allocations and frees
+// over the interval, per simulated second, as tab separated rows
+class AllocStatsReporter
+{
+public:
+	AllocStatsReporter ()
+		: m_lastSim (0), m_startSim (0)
+	{
+	}
+
+	// Read by operator new, so it must not allocate
+	static AllocationCounters &GetCounters ()
+	{
+		static AllocationCounters counters;
+		return counters;
+	}
+
+	void Start (const std::string &path, Time interval)
+	{
+		m_interval = interval;
+		m_os.open (path.c_str ());
+		m_os << "sim_s\tallocations\tallocations_per_s\tbytes\tfrees\tlive\n";
+
+		m_start = m_last = GetCounters ();
+		m_startSim = m_lastSim = Simulator::Now ().GetSeconds ();
+
+		Simulator::Schedule (m_interval, &AllocStatsReporter::Report, this);
+	}
+
+	// Write the row of the last partial interval and a total row
+	void Stop ()
+	{
+		if (!m_os.is_open ())
+			return;
+
+		Report ();
+
+		AllocationCounters now = GetCounters ();
+		uint64_t allocations = now.allocations - m_start.allocations;
+		double sim = Simulator::Now ().GetSeconds () - m_startSim;
+		m_os << "# total\t" << allocations << "\t" << (sim > 0 ? allocations / sim : 0) << "\t" << now.bytes - m_start.bytes <<
+				"\t" << now.frees - m_start.frees << "\t" << now.allocations - now.frees << "\n";
+
+		m_os.close ();
+	}
+
+	// Allocations per simulated second since Start
+	double GetRate () const
+	{
+		double sim = Simulator::Now ().GetSeconds () - m_startSim;
+		return sim > 0 ? (GetCounters ().allocations - m_start.allocations) / sim : 0;
+	}
+
+private:
+	void Report ()
+	{
+		AllocationCounters now = GetCounters ();
+		double sim = Simulator::Now ().GetSeconds ();
+		uint64_t allocations = now.allocations - m_last.allocations;
+
+		m_os << sim << "\t" << allocations << "\t" << (sim > m_lastSim ? allocations / (sim - m_lastSim) : 0) << "\t" <<
+				now.bytes - m_last.bytes << "\t" << now.frees - m_last.frees << "\t" << now.allocations - now.frees << "\n";
+
+		m_last = now;
+		m_lastSim = sim;
+
+		if (!Simulator::IsFinished ())
+			m_next = Simulator::Schedule (m_interval, &AllocStatsReporter::Report, this);
+	}
+
+	std::ofstream m_os;
+	Time m_interval;
+	EventId m_next;
+	AllocationCounters m_start;                   // Counters at Start
+	AllocationCounters m_last;                    // And at the last report
+	double m_lastSim;
+	double m_startSim;
+};
+
+} // namespace ns3
+
+#endif // ICC_POOL_H
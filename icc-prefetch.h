@@ -0,0 +1,640 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-prefetch.h
+ *  Handover aware prefetching into the sector caches of the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-prefetch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-prefetch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-prefetch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Instead of fake interests for everything at the mobile's rate on every
+// central node, a PrefetchPlanner watches the mobiles and asks the central
+// node of the sector a mobile is about to enter for the Data it will want
+// there. The PrefetchApp on that central node sends those interests at a
+// bounded rate, so the Data lands in its Content Store, and counts how much
+// of it is later served from the cache. A CacheWarmer goes one step further
+// and puts the next segments straight into the store of the next AP.
+
+#ifndef ICC_PREFETCH_H
+#define ICC_PREFETCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/ndnSIM-module.h>
+
+#include "icc-handover.h"
+
+namespace ns3 {
+
+// A segment of content: the prefix as a URI and the sequence number
+typedef std::pair<std::string, uint32_t> SegmentKey;
+
+inline SegmentKey SegmentKeyOf (const ndn::Name &name)
+{
+	return SegmentKey (name.getPrefix (name.size () - 1).toUri (), name.get (-1).toSeqNum ());
+}
+
+// Drops the segments of uri below the sequence number below
+inline void EraseBelow (std::set<SegmentKey> &keys, const std::string &uri, uint32_t below)
+{
+	keys.erase (keys.lower_bound (SegmentKey (uri, 0)), keys.lower_bound (SegmentKey (uri, below)));
+}
+
+// Fetches the sequence numbers it is given under a prefix, each once, at
+// most Frequency interests per second and MaxPending waiting to be sent.
+// Data it fetched that the node later sends out of its Content Store is
+// counted as used
+class PrefetchApp : public ndn::App
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccPrefetchApp")
+			.SetParent<ndn::App> ()
+			.AddConstructor<PrefetchApp> ()
+			.AddAttribute ("Frequency", "Most interests sent per second",
+					DoubleValue (100.0),
+					MakeDoubleAccessor (&PrefetchApp::m_frequency),
+					MakeDoubleChecker<double> (0))
+			.AddAttribute ("MaxPending", "Most interests waiting to be sent, later requests are dropped",
+					UintegerValue (1000),
+					MakeUintegerAccessor (&PrefetchApp::m_maxPending),
+					MakeUintegerChecker<uint32_t> ())
+			.AddAttribute ("LifeTime", "Interest lifetime",
+					StringValue ("2s"),
+					MakeTimeAccessor (&PrefetchApp::m_lifetime),
+					MakeTimeChecker ());
+		return tid;
+	}
+
+	PrefetchApp ()
+		: m_frequency (100.0), m_maxPending (1000), m_sent (0), m_fetched (0), m_used (0), m_dropped (0)
+	{
+		m_rand = CreateObject<UniformRandomVariable> ();
+	}
+
+	// Queue interests for count sequence numbers from first under prefix
+	void Prefetch (const ndn::Name &prefix, uint32_t first, uint32_t count)
+	{
+		if (!m_active)
+			return;
+
+		std::string uri = prefix.toUri ();
+		for (uint32_t seq = first; seq < first + count; seq++)
+		{
+			SegmentKey key (uri, seq);
+			if (m_requested.count (key))
+				continue;
+			if (m_queue.size () >= m_maxPending)
+			{
+				m_dropped++;
+				continue;
+			}
+
+			m_requested.insert (key);
+			m_queue.push_back (std::make_pair (prefix, seq));
+		}
+
+		if (!m_queue.empty () && !m_sendEvent.IsRunning ())
+			m_sendEvent = Simulator::ScheduleNow (&PrefetchApp::SendNext, this);
+	}
+
+	// Sequence numbers below below under uri are wanted no more, they may be
+	// requested again and their unused Data is no longer looked for
+	void Forget (const std::string &uri, uint32_t below)
+	{
+		EraseBelow (m_requested, uri, below);
+		EraseBelow (m_cached, uri, below);
+	}
+
+	uint64_t GetSent () const
+	{
+		return m_sent;
+	}
+
+	uint64_t GetFetched () const
+	{
+		return m_fetched;
+	}
+
+	uint64_t GetUsed () const
+	{
+		return m_used;
+	}
+
+	// New sequence numbers that found the queue full
+	uint64_t GetDropped () const
+	{
+		return m_dropped;
+	}
+
+protected:
+	virtual void StartApplication ()
+	{
+		// Interests go out 1 / Frequency seconds apart
+		if (m_frequency <= 0)
+			NS_FATAL_ERROR ("Prefetch frequency of " << m_frequency << " interests per second, it has to be positive");
+
+		App::StartApplication ();
+
+		Ptr<ndn::ForwardingStrategy> fw = GetNode ()->GetObject<ndn::ForwardingStrategy> ();
+		fw->TraceConnectWithoutContext ("OutData", MakeCallback (&PrefetchApp::OutData, this));
+	}
+
+	virtual void StopApplication ()
+	{
+		Ptr<ndn::ForwardingStrategy> fw = GetNode ()->GetObject<ndn::ForwardingStrategy> ();
+		fw->TraceDisconnectWithoutContext ("OutData", MakeCallback (&PrefetchApp::OutData, this));
+
+		Simulator::Cancel (m_sendEvent);
+		m_queue.clear ();
+		App::StopApplication ();
+	}
+
+	virtual void OnData (Ptr<const ndn::Data> data)
+	{
+		App::OnData (data);
+		if (!m_active)
+			return;
+
+		m_fetched++;
+		m_cached.insert (SegmentKeyOf (data->GetName ()));
+	}
+
+private:
+	void SendNext ()
+	{
+		if (!m_active || m_queue.empty ())
+			return;
+
+		Ptr<ndn::Name> name = Create<ndn::Name> (m_queue.front ().first);
+		name->appendSeqNum (m_queue.front ().second);
+		m_queue.pop_front ();
+
+		Ptr<ndn::Interest> interest = Create<ndn::Interest> ();
+		interest->SetNonce (m_rand->GetInteger (0, std::numeric_limits<uint32_t>::max ()));
+		interest->SetName (name);
+		interest->SetInterestLifetime (m_lifetime);
+
+		m_sent++;
+		m_transmittedInterests (interest, this, m_face);
+		m_face->ReceiveInterest (interest);
+
+		if (!m_queue.empty ())
+			m_sendEvent = Simulator::Schedule (Seconds (1.0 / m_frequency), &PrefetchApp::SendNext, this);
+	}
+
+	// Data the node sends out of its cache, counted once per fetched packet
+	void OutData (Ptr<const ndn::Data> data, bool fromCache, Ptr<const ndn::Face> face)
+	{
+		if (!fromCache || m_cached.empty ())
+			return;
+
+		if (m_cached.erase (SegmentKeyOf (data->GetName ())))
+			m_used++;
+	}
+
+	double m_frequency;
+	uint32_t m_maxPending;
+	Time m_lifetime;
+	Ptr<UniformRandomVariable> m_rand;
+
+	std::deque<std::pair<ndn::Name, uint32_t> > m_queue;
+	std::set<SegmentKey> m_requested;             // Queued and still wanted, so nothing is fetched twice
+	std::set<SegmentKey> m_cached;                // Fetched and not yet used
+	EventId m_sendEvent;
+
+	uint64_t m_sent;
+	uint64_t m_fetched;
+	uint64_t m_used;
+	uint64_t m_dropped;
+};
+
+// Highest sequence number the consumers of every mobile have asked for,
+// and the prefix they ask under, followed through their interests
+class ConsumerProgress
+{
+public:
+	// Mobiles in handover engine order, once their applications are installed
+	void AddMobile (Ptr<Node> node)
+	{
+		m_mobiles.push_back (Progress ());
+		m_mobiles.back ().node = node;
+	}
+
+	// Mobiles must not be added after this is called
+	void Start ()
+	{
+		for (uint32_t i = 0; i < m_mobiles.size (); i++)
+		{
+			Ptr<Node> node = m_mobiles[i].node;
+			for (uint32_t j = 0; j < node->GetNApplications (); j++)
+			{
+				Ptr<ndn::App> app = DynamicCast<ndn::App> (node->GetApplication (j));
+				if (app != 0)
+					app->TraceConnectWithoutContext ("TransmittedInterests",
+							MakeBoundCallback (&ConsumerProgress::SentInterest, &m_mobiles[i]));
+			}
+		}
+	}
+
+	uint32_t GetN () const
+	{
+		return m_mobiles.size ();
+	}
+
+	// Whether the mobile has sent an interest yet
+	bool IsKnown (uint32_t mobile) const
+	{
+		return m_mobiles[mobile].known;
+	}
+
+	const ndn::Name &GetPrefix (uint32_t mobile) const
+	{
+		return m_mobiles[mobile].prefix;
+	}
+
+	uint32_t GetLastSeq (uint32_t mobile) const
+	{
+		return m_mobiles[mobile].lastSeq;
+	}
+
+	// Per prefix, the last interest of the mobile furthest behind under it.
+	// No mobile asks again for what is below
+	std::map<std::string, uint32_t> GetLowestSeqs () const
+	{
+		std::map<std::string, uint32_t> lowest;
+		for (uint32_t i = 0; i < m_mobiles.size (); i++)
+		{
+			if (!m_mobiles[i].known)
+				continue;
+			std::string uri = m_mobiles[i].prefix.toUri ();
+			std::map<std::string, uint32_t>::iterator it = lowest.find (uri);
+			if (it == lowest.end ())
+				lowest[uri] = m_mobiles[i].lastSeq;
+			else
+				it->second = std::min (it->second, m_mobiles[i].lastSeq);
+		}
+		return lowest;
+	}
+
+private:
+	struct Progress
+	{
+		Progress ()
+			: known (false), lastSeq (0)
+		{
+		}
+
+		Ptr<Node> node;
+		bool known;
+		ndn::Name prefix;
+		uint32_t lastSeq;
+	};
+
+	static void SentInterest (Progress *m, Ptr<const ndn::Interest> interest, Ptr<ndn::App> app, Ptr<ndn::Face> face)
+	{
+		const ndn::Name &name = interest->GetName ();
+		uint32_t seq = name.get (-1).toSeqNum ();
+		if (m->known && seq <= m->lastSeq)
+			return;
+
+		if (!m->known)
+			m->prefix = name.getPrefix (name.size () - 1);
+		m->known = true;
+		m->lastSeq = seq;
+	}
+
+	std::vector<Progress> m_mobiles;
+};
+
+// Every interval, asks where the handover engine expects each mobile next.
+// A mobile due in another sector within lookahead gets the Data it will
+// ask for from then on prefetched by that sector's central node: window
+// seconds of it at the mobile's rate
+class PrefetchPlanner
+{
+public:
+	// apSector gives the sector of every AP as the handover engine numbers them
+	PrefetchPlanner (const HandoverEngine &engine, const ConsumerProgress &progress, const std::vector<uint32_t> &apSector,
+			double frequency)
+		: m_engine (engine), m_progress (progress), m_apSector (apSector), m_frequency (frequency), m_lookahead (10),
+		  m_window (10), m_maxSeq (std::numeric_limits<uint32_t>::max ()), m_plans (0)
+	{
+	}
+
+	void SetLookahead (double lookahead, double window)
+	{
+		m_lookahead = lookahead;
+		m_window = window;
+	}
+
+	// Sequence numbers past this are never requested
+	void SetMaxSeq (uint32_t maxSeq)
+	{
+		m_maxSeq = maxSeq;
+	}
+
+	// Central node application of a sector, sectors without one are not prefetched into
+	void AddSector (uint32_t sector, Ptr<PrefetchApp> app)
+	{
+		if (sector >= m_apps.size ())
+			m_apps.resize (sector + 1);
+		m_apps[sector] = app;
+	}
+
+	void Start (Time interval)
+	{
+		m_interval = interval;
+		m_event = Simulator::Schedule (interval, &PrefetchPlanner::Plan, this);
+	}
+
+	void Stop ()
+	{
+		Simulator::Cancel (m_event);
+	}
+
+	// Prefetch requests handed to the sector applications
+	uint64_t GetPlans () const
+	{
+		return m_plans;
+	}
+
+	// One row per sector application, and the totals
+	void Write (const std::string &path) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "sector\tinterests\tdata\tused\tdropped\n";
+
+		uint64_t sent = 0, fetched = 0, used = 0, dropped = 0;
+		for (uint32_t s = 0; s < m_apps.size (); s++)
+		{
+			if (m_apps[s] == 0)
+				continue;
+			os << s << "\t" << m_apps[s]->GetSent () << "\t" << m_apps[s]->GetFetched () << "\t" << m_apps[s]->GetUsed ()
+					<< "\t" << m_apps[s]->GetDropped () << "\n";
+			sent += m_apps[s]->GetSent ();
+			fetched += m_apps[s]->GetFetched ();
+			used += m_apps[s]->GetUsed ();
+			dropped += m_apps[s]->GetDropped ();
+		}
+		os << "# total\t" << sent << "\t" << fetched << "\t" << used << "\t" << dropped << "\n";
+	}
+
+private:
+	void Plan ()
+	{
+		// The applications forget what no mobile asks for again
+		std::map<std::string, uint32_t> lowest = m_progress.GetLowestSeqs ();
+		for (uint32_t s = 0; s < m_apps.size (); s++)
+		{
+			if (m_apps[s] == 0)
+				continue;
+			for (std::map<std::string, uint32_t>::const_iterator it = lowest.begin (); it != lowest.end (); ++it)
+				m_apps[s]->Forget (it->first, it->second);
+		}
+
+		for (uint32_t i = 0; i < m_progress.GetN (); i++)
+		{
+			uint32_t next;
+			double time;
+			if (!m_progress.IsKnown (i) || !m_engine.PredictNextAp (i, m_lookahead, next, time))
+				continue;
+
+			uint32_t sector = m_apSector[next];
+			if (sector == m_apSector[m_engine.GetCurrentAp (i)] || sector >= m_apps.size () || m_apps[sector] == 0)
+				continue;
+
+			// What the mobile asks for from when it gets there
+			double first = m_progress.GetLastSeq (i) + 1 + std::floor (m_frequency * time);
+			double count = std::ceil (m_frequency * m_window);
+			if (first > m_maxSeq)
+				continue;
+			count = std::min (count, m_maxSeq - first + 1);
+
+			m_apps[sector]->Prefetch (m_progress.GetPrefix (i), static_cast<uint32_t> (first), static_cast<uint32_t> (count));
+			m_plans++;
+		}
+
+		m_event = Simulator::Schedule (m_interval, &PrefetchPlanner::Plan, this);
+	}
+
+	const HandoverEngine &m_engine;
+	const ConsumerProgress &m_progress;
+	std::vector<uint32_t> m_apSector;
+	double m_frequency;                           // Interests per second of a mobile
+	double m_lookahead;                           // Seconds ahead a sector change is looked for
+	double m_window;                              // Seconds of Data prefetched per sector change
+	uint32_t m_maxSeq;
+	std::vector<Ptr<PrefetchApp> > m_apps;        // By sector
+	Time m_interval;
+	EventId m_event;
+	uint64_t m_plans;
+};
+
+// Every interval, asks where the handover engine expects each mobile next.
+// A mobile due at another AP within lookahead gets the next segments it
+// will ask for put straight into that AP's Content Store, as the producer
+// would have made them, so its first interests after the handover are
+// answered by the AP. Per AP it counts the segments pushed, the pushed
+// segments later served (hits), the interests its store could not answer
+// (misses), and pushed segments never served (wasted)
+class CacheWarmer
+{
+public:
+	CacheWarmer (const HandoverEngine &engine, const ConsumerProgress &progress, double frequency, uint32_t payloadSize)
+		: m_engine (engine), m_progress (progress), m_frequency (frequency), m_payloadSize (payloadSize), m_segments (0),
+		  m_lookahead (5), m_maxSeq (std::numeric_limits<uint32_t>::max ())
+	{
+	}
+
+	void SetSegments (uint32_t segments, double lookahead)
+	{
+		m_segments = segments;
+		m_lookahead = lookahead;
+	}
+
+	// Sequence numbers past this are never pushed
+	void SetMaxSeq (uint32_t maxSeq)
+	{
+		m_maxSeq = maxSeq;
+	}
+
+	// AP nodes in handover engine order
+	void AddAp (Ptr<Node> node)
+	{
+		m_aps.push_back (WarmedAp ());
+		m_aps.back ().cs = node->GetObject<ndn::ContentStore> ();
+	}
+
+	// APs must not be added after this is called
+	void Start (Time interval)
+	{
+		m_payload = Create<Packet> (m_payloadSize);
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+		{
+			m_aps[i].cs->TraceConnectWithoutContext ("CacheHits", MakeBoundCallback (&CacheWarmer::CacheHit, &m_aps[i]));
+			m_aps[i].cs->TraceConnectWithoutContext ("CacheMisses", MakeBoundCallback (&CacheWarmer::CacheMiss, &m_aps[i]));
+		}
+
+		m_interval = interval;
+		m_event = Simulator::Schedule (interval, &CacheWarmer::Warm, this);
+	}
+
+	void Stop ()
+	{
+		Simulator::Cancel (m_event);
+	}
+
+	// One row per AP, and the totals
+	void Write (const std::string &path) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "ap\tpushed\thits\tmisses\tevicted\twasted\n";
+
+		uint64_t pushed = 0, hits = 0, misses = 0, evicted = 0;
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+		{
+			const WarmedAp &ap = m_aps[i];
+			os << i << "\t" << ap.pushed << "\t" << ap.hits << "\t" << ap.misses << "\t" << ap.evicted << "\t"
+					<< ap.pushed - ap.hits << "\n";
+			pushed += ap.pushed;
+			hits += ap.hits;
+			misses += ap.misses;
+			evicted += ap.evicted;
+		}
+		os << "# total\t" << pushed << "\t" << hits << "\t" << misses << "\t" << evicted << "\t" << pushed - hits << "\n";
+	}
+
+	uint64_t GetPushed () const
+	{
+		uint64_t n = 0;
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+			n += m_aps[i].pushed;
+		return n;
+	}
+
+	uint64_t GetHits () const
+	{
+		uint64_t n = 0;
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+			n += m_aps[i].hits;
+		return n;
+	}
+
+private:
+	struct WarmedAp
+	{
+		WarmedAp ()
+			: pushed (0), hits (0), misses (0), evicted (0)
+		{
+		}
+
+		Ptr<ndn::ContentStore> cs;
+		std::set<SegmentKey> waiting;                 // Pushed and not yet served, maybe evicted since
+		uint64_t pushed;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evicted;                             // Pushed again after leaving the store unserved
+	};
+
+	static void CacheHit (WarmedAp *ap, Ptr<const ndn::Interest> interest, Ptr<const ndn::Data> data)
+	{
+		if (!ap->waiting.empty () && ap->waiting.erase (SegmentKeyOf (interest->GetName ())))
+			ap->hits++;
+	}
+
+	static void CacheMiss (WarmedAp *ap, Ptr<const ndn::Interest> interest)
+	{
+		ap->misses++;
+	}
+
+	void Warm ()
+	{
+		// Nobody asks again for what is below the last interests
+		std::map<std::string, uint32_t> lowest = m_progress.GetLowestSeqs ();
+		for (uint32_t a = 0; a < m_aps.size (); a++)
+		{
+			if (m_aps[a].waiting.empty ())
+				continue;
+			for (std::map<std::string, uint32_t>::const_iterator it = lowest.begin (); it != lowest.end (); ++it)
+				EraseBelow (m_aps[a].waiting, it->first, it->second);
+		}
+
+		for (uint32_t i = 0; i < m_progress.GetN (); i++)
+		{
+			uint32_t next;
+			double time;
+			if (!m_progress.IsKnown (i) || !m_engine.PredictNextAp (i, m_lookahead, next, time))
+				continue;
+
+			// What the mobile asks for from when it gets there
+			double first = m_progress.GetLastSeq (i) + 1 + std::floor (m_frequency * time);
+			double last = std::min<double> (first + m_segments - 1, m_maxSeq);
+
+			WarmedAp &ap = m_aps[next];
+			std::string uri = m_progress.GetPrefix (i).toUri ();
+			for (double seq = first; seq <= last; seq++)
+			{
+				SegmentKey key (uri, static_cast<uint32_t> (seq));
+
+				Ptr<ndn::Name> name = Create<ndn::Name> (m_progress.GetPrefix (i));
+				name->appendSeqNum (key.second);
+
+				// The payload buffer is shared, offering a segment again is cheap
+				Ptr<ndn::Data> data = Create<ndn::Data> (m_payload->Copy ());
+				data->SetName (name);
+				data->SetTimestamp (Simulator::Now ());
+
+				// Segments the store still holds are left alone. One pushed
+				// before and not served has been evicted, and goes in again
+				if (ap.cs->Add (data))
+				{
+					ap.pushed++;
+					if (!ap.waiting.insert (key).second)
+						ap.evicted++;
+				}
+			}
+		}
+
+		m_event = Simulator::Schedule (m_interval, &CacheWarmer::Warm, this);
+	}
+
+	const HandoverEngine &m_engine;
+	const ConsumerProgress &m_progress;
+	double m_frequency;                           // Interests per second of a mobile
+	uint32_t m_payloadSize;                       // Bytes of Data payload, as the producer makes them
+	Ptr<Packet> m_payload;                        // Shared by the pushed Data, never changed
+	uint32_t m_segments;                          // Segments pushed ahead of a handover
+	double m_lookahead;                           // Seconds ahead a handover is looked for
+	uint32_t m_maxSeq;
+	std::vector<WarmedAp> m_aps;                  // By handover engine AP
+	Time m_interval;
+	EventId m_event;
+};
+
+} // namespace ns3
+
+#endif // ICC_PREFETCH_H
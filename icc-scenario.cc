@@ -23,19 +23,29 @@
 
 // Standard C++ modules
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iterator>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <new>
 #include <string>
+#include <signal.h>
+#include <sstream>
+#include <sys/resource.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 // Random modules
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/math/distributions/students_t.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
@@ -51,6 +61,9 @@
 #include <ns3-dev/ns3/network-module.h>
 #include <ns3-dev/ns3/point-to-point-module.h>
 #include <ns3-dev/ns3/wifi-module.h>
+#ifdef NS3_MPI
+#include <ns3-dev/ns3/mpi-interface.h>
+#endif
 
 // ndnSIM modules
 #include <ns3-dev/ns3/ndnSIM-module.h>
@@ -59,6 +72,23 @@
 
 // Extension files
 // #include "minstrel-wifi-manager.h"
+#include "icc-alloc-count.h"
+#include "icc-apps.h"
+#include "icc-binary-tracer.h"
+#include "icc-capture.h"
+#include "icc-cs.h"
+#include "icc-distributed.h"
+#include "icc-handover.h"
+#include "icc-metrics.h"
+#include "icc-pool.h"
+#include "icc-prefetch.h"
+#include "icc-simstats.h"
+#include "icc-timer-wheel.h"
+#include "icc-topology.h"
+#include "icc-warmstart.h"
+#include "icc-waypoint-mobility.h"
+#include "icc-wifi-batch.h"
+#include "icc-wifi-culling.h"
 
 using namespace ns3;
 using namespace boost;
@@ -94,198 +124,571 @@ double obtain_Num(double min, double max)
 	return dist(gen);
 }
 
-// Function to change the SSID of a Node, depending on distance
-void SetSSIDviaDistance(uint32_t mtId, Ptr<MobilityModel> node, std::map<std::string, Ptr<MobilityModel> > aps)
+// Log the AP the handover engine has sent a mobile terminal to. The engine
+// numbers the APs of this rank, aps gives their index in the topology
+void LogHandover(const std::vector<uint32_t> *aps, uint32_t mtId, uint32_t ap, double distance)
 {
-	char configbuf[250];
 	char buffer[250];
 
-	// This causes the device in mtId to change the SSID, forcing AP change
-	sprintf(configbuf, "/NodeList/%d/DeviceList/0/$ns3::WifiNetDevice/Mac/Ssid", mtId);
+	sprintf(buffer, "Node %d: Change to SSID ap-%d at distance of %f", mtId, (*aps)[ap], distance);
 
-	std::map<double, std::string> SsidDistance;
+	NS_LOG_INFO(buffer);
+}
 
-	// Iterate through the map of seen Ssids
-	for (std::map<std::string, Ptr<MobilityModel> >::iterator ii=aps.begin(); ii!=aps.end(); ++ii)
+// These are our scenario arguments
+struct ScenarioConfig
+{
+	ScenarioConfig ()
+		: sectors (2),
+		  aps (2),
+		  mobile (1),
+		  servers (1),
+		  xaxis (300),
+		  yaxis (300),
+		  sec (0.0),
+		  fake (false),
+		  traceFiles (false),
+		  smart (false),
+		  bestr (false),
+		  walk (true),
+		  speed (5),
+		  results ("results"),
+		  endTime (200),
+		  MBps (0.15),
+		  contentSize (-1),
+		  retxtime (0.05),
+		  csSize (10000000),
+		  csStore ("lru"),
+		  csStats (0),
+		  layout ("road"),
+		  spacing (100),
+		  channels (1),
+		  channelPlan ("sector"),
+		  prefixPerMobile (false),
+		  cullRange (0),
+		  cullValidate (false),
+		  lossBatch (false),
+		  lossCheck (0),
+		  sharedPayload (false),
+		  pool (false),
+		  allocStats (0),
+		  retxWheel (false),
+		  handoverPause (false),
+		  burstRate (4),
+		  handoverWindow (2),
+		  capture (false),
+		  distributed (false),
+		  prefetch (false),
+		  prefetchLookahead (10),
+		  prefetchWindow (10),
+		  prefetchRate (2),
+		  warm (0),
+		  warmLookahead (5),
+		  handoverMode ("poll"),
+		  handoverHorizon (10),
+		  nsTDir ("./Waypoints"),
+		  waypointWindow (10),
+		  trajectory (false),
+		  traceFormat ("text"),
+		  traceCompress (false),
+		  summary (false),
+		  profile (false),
+		  simStats (0),
+		  seed (0),
+		  run (0),
+		  runs (1),
+		  jobs (1),
+		  minRuns (3),
+		  ciWidth (0.05),
+		  ciLevel (0.95),
+		  forkAt (0.5)
 	{
-		// Calculate the distance from the AP to the node and save into the map
-		SsidDistance[node->GetDistanceFrom((*ii).second)] = (*ii).first;
 	}
 
-	double distance = SsidDistance.begin()->first;
-	std::string ssid(SsidDistance.begin()->second);
-
-	sprintf(buffer, "Change to SSID %s at distance of %f", ssid.c_str(), distance);
+	uint32_t sectors;                             // Number of wireless sectors
+	uint32_t aps;                                 // Number of wireless access nodes in a sector
+	uint32_t mobile;                              // Number of mobile terminals
+	uint32_t servers;                             // Number of servers in the network
+	uint32_t xaxis;                               // Size of the X axis
+	uint32_t yaxis;                               // Size of the Y axis
+	double sec;                                   // Movement start
+	bool fake;                                    // Enable fake interest or not
+	bool traceFiles;                              // Tells to run the simulation with traceFiles
+	bool smart;                                   // Tells to run the simulation with SmartFlooding
+	bool bestr;                                   // Tells to run the simulation with BestRoute
+	bool walk;                                    // Do random walk at walking speed
+	double speed;                                 // MN's speed	change here (1.4 | 8.3 | 16.7)
+	std::string results;                          // Directory to place results
+	double endTime;                               // Number of seconds to run the simulation
+	double MBps;                                  // MB/s data rate desired for applications
+	int contentSize;                              // Size of content to be retrieved
+	double retxtime;                              // How frequent Interest retransmission timeouts should be checked (seconds)
+	int csSize;                                   // How big the Content Store should be
+	std::string csStore;                          // Content Store of the routers (lru | arena)
+	double csStats;                               // Simulated seconds between Content Store samples (0 is off)
+	std::string layout;                           // How generated APs are laid out (road | hex)
+	double spacing;                               // Distance between neighbouring generated APs (meters)
+	std::string topologyFile;                     // Topology description file, replaces the generated layout
+	uint32_t channels;                            // Distinct Wifi channels the APs are spread over
+	std::string channelPlan;                      // What shares a channel (sector | ap)
+	bool prefixPerMobile;                         // Every mobile requests its own prefix
+	double cullRange;                             // Wifi receivers further than this from the sender are skipped (meters, 0 is off)
+	bool cullValidate;                            // Evaluate culled receivers anyway and report the ones that mattered
+	bool lossBatch;                               // Evaluate the Wifi loss for all receivers of a frame at once
+	uint32_t lossCheck;                           // Samples per distance of the batched loss check (0 is off)
+	bool sharedPayload;                           // The producer answers with one shared payload buffer
+	bool pool;                                    // Producer and consumers reuse released packets
+	double allocStats;                            // Simulated seconds between allocation counts (0 is off)
+	bool retxWheel;                               // Consumers keep retransmission timeouts in a timer wheel instead of polling
+	bool handoverPause;                           // Mobile consumers hold interests while their station is not associated
+	double burstRate;                             // Rate of the burst after a reassociation, relative to the interest rate
+	double handoverWindow;                        // Seconds after an AP change the Data of a mobile counts as post-handover
+	bool capture;                                 // Write the interests the consumers send, for icc-fw-bench
+	bool distributed;                             // Split the sectors over the MPI ranks (needs ns-3 with MPI)
+	bool prefetch;                                // Prefetch into the sector a mobile is about to enter, instead of fake interests
+	double prefetchLookahead;                     // Seconds ahead a sector change is looked for
+	double prefetchWindow;                        // Seconds of the mobile's Data prefetched per sector change
+	double prefetchRate;                          // Prefetch interest rate, relative to the mobile's
+	uint32_t warm;                                // Segments pushed into the next AP's store ahead of a handover (0 is off)
+	double warmLookahead;                         // Seconds ahead a handover is looked for when warming
+	std::string handoverMode;                     // How AP changes are scheduled (poll | event)
+	double handoverHorizon;                       // Longest time between AP checks of a moving node in event mode (seconds)
+	std::string nsTDir;                           // Directory for the waypoint files
+	std::string waypoints;                        // Binary waypoint file, replaces the ns-2 trace picked by speed
+	double waypointWindow;                        // Seconds of waypoints scheduled at a time
+	bool trajectory;                              // Interpolate precomputed trajectories instead of waypoint events
+	std::string traceFormat;                      // Trace file format (text | binary)
+	bool traceCompress;                           // Compress binary trace files
+	bool summary;                                 // Write the per node class summary of the run
+	bool profile;                                 // Write the time and memory of the run phases
+	double simStats;                              // Simulated seconds between event rate reports (0 is off)
+	uint32_t seed;                                // ns-3 and boost RNG seed (0 takes ns-3's RngSeed)
+	uint32_t run;                                 // ns-3 run number (0 takes ns-3's RngRun)
+	uint32_t runs;                                // Number of replications to run
+	uint32_t jobs;                                // Replications running at the same time
+	uint32_t minRuns;                             // Replications before the confidence intervals are checked
+	double ciWidth;                               // Target confidence interval half width, relative to the mean
+	double ciLevel;                               // Confidence level of the intervals
+	std::string batch;                            // File of configurations to run in this process
+	std::string variants;                         // File of variants forked from one shared run
+	double forkAt;                                // Simulated second the variants are forked at
+};
+
+// Name of the results subdirectory for the kind of extra interests in the
+// run, and whether the AP caches are warmed
+std::string InterestMode (const ScenarioConfig &cfg)
+{
+	std::string mode = cfg.prefetch ? "prefetch" : cfg.fake ? "fake" : "normal";
+	if (cfg.warm > 0)
+		mode += "-warm";
+	return mode;
+}
 
-	NS_LOG_INFO(buffer);
+// Where the results of a run of cfg go
+std::string ResultDir (const ScenarioConfig &cfg)
+{
+	char speed[32];
+	snprintf (speed, sizeof (speed), "%.0f", cfg.speed);
+	return cfg.results + "/" + scenario + "/" + InterestMode (cfg) + "/" + speed;
+}
 
-	// Because the map sorts by std:less, the first position has the lowest distance
-	Config::Set(configbuf, SsidValue(ssid));
+// The ns-2 movement trace for the speed of cfg, the random walk one for
+// speeds without a trace of their own
+std::string Ns2TracePath (const ScenarioConfig &cfg)
+{
+	const char *file;
 
-	// Empty the maps
-	SsidDistance.clear();
+	uint32_t top = cfg.speed;
+	switch (top)
+	{
+	case 5:
+		file = "1.4.ns_movements";
+		break;
+	case 10:
+		file = "2.8.ns_movements";
+		break;
+	case 20:
+		file = "5.6.ns_movements";
+		break;
+	case 30:
+		file = "8.3.ns_movements";
+		break;
+	case 40:
+		file = "11.2.ns_movements";
+		break;
+	case 50:
+		file = "13.9.ns_movements";
+		break;
+	case 60:
+		file = "16.7.ns_movements";
+		break;
+	case 70:
+		file = "19.4.ns_movements";
+		break;
+	case 80:
+		file = "22.2.ns_movements";
+		break;
+	default:
+		file = "Walk_random.ns_movements";
+		break;
+	}
+	return cfg.nsTDir + "/" + file;
 }
 
-int main (int argc, char *argv[])
+// What a single run reports back about the mobile terminals
+struct ScenarioMetrics
+{
+	uint64_t satisfied;                           // Interests that got their Data back
+	uint64_t retransmissions;                     // Retransmissions those Interests needed
+	double delaySum;                              // Sum of the full Interest-Data delays (seconds)
+	double hopSum;                                // Sum of the Data hop counts
+	uint64_t handovers;                           // AP changes applied
+	uint64_t handoverSatisfied;                   // Interests satisfied within the window after an AP change
+	uint64_t handoverRetransmissions;             // Retransmissions those Interests needed
+	double handoverDelaySum;                      // Sum of their full delays (seconds)
+
+	double MeanDelay () const
+	{
+		return satisfied ? delaySum / satisfied : 0;
+	}
+
+	double MeanHandoverDelay () const
+	{
+		return handoverSatisfied ? handoverDelaySum / handoverSatisfied : 0;
+	}
+
+	double MeanHops () const
+	{
+		return satisfied ? hopSum / satisfied : 0;
+	}
+};
+
+// Inputs shared by the runs of a batch. They are read once by the parent
+// process, and every run forked from it finds them there
+struct ScenarioCache
+{
+	std::map<std::string, std::vector<iccwaypoint::Record> > traces;    // Normalized ns-2 traces by path
+	std::map<std::string, IccTopology> topologies;                       // Topology description files by path
+
+	// What the runs of cfg would read, a file that cannot be read is left
+	// for the run to report. Only -trajectory runs take the parsed ns-2
+	// traces, the others go through Ns2MobilityHelper
+	void Load (const ScenarioConfig &cfg)
+	{
+		if (cfg.waypoints.empty () && cfg.trajectory)
+		{
+			std::string path = Ns2TracePath (cfg);
+			if (!traces.count (path))
+			{
+				std::vector<iccwaypoint::Record> records;
+				iccwaypoint::Ns2Parser parser;
+				if (parser.Parse (path, records))
+				{
+					iccwaypoint::Normalize (records);
+					traces[path].swap (records);
+				}
+			}
+		}
+
+		if (!cfg.topologyFile.empty () && !topologies.count (cfg.topologyFile))
+		{
+			IccTopology topo;
+			std::string error;
+			if (IccTopology::Read (cfg.topologyFile, topo, error))
+				topologies[cfg.topologyFile] = topo;
+		}
+	}
+};
+
+// Streaming mean and variance (Welford)
+class RunningStat
 {
-	// These are our scenario arguments
-	uint32_t sectors = 2;                         // Number of wireless sectors
-	uint32_t aps = 2;					          // Number of wireless access nodes in a sector
-	uint32_t mobile = 1;				          // Number of mobile terminals
-	uint32_t servers = 1;				          // Number of servers in the network
-	uint32_t wnodes = aps * sectors;              // Number of nodes in the network
-	uint32_t xaxis = 300;                         // Size of the X axis
-	uint32_t yaxis = 300;                         // Size of the Y axis
-	double sec = 0.0;                             // Movement start
-	bool fake = false;							  // Enable fake interest or not
-	bool traceFiles = false;                      // Tells to run the simulation with traceFiles
-	bool smart = false;                           // Tells to run the simulation with SmartFlooding
-	bool bestr = false;                           // Tells to run the simulation with BestRoute
-	bool walk = true;                             // Do random walk at walking speed
-	double speed= 5;							  // MN's speed	change here (1.4 | 8.3 | 16.7)
-	char results[250] = "results";                // Directory to place results
-	double endTime = 200;                         // Number of seconds to run the simulation
-	double MBps = 0.15;                           // MB/s data rate desired for applications
-	int contentSize = -1;                         // Size of content to be retrieved
+public:
+	RunningStat ()
+		: m_n (0), m_mean (0), m_m2 (0)
+	{
+	}
+
+	void Add (double x)
+	{
+		m_n++;
+		double delta = x - m_mean;
+		m_mean += delta / m_n;
+		m_m2 += delta * (x - m_mean);
+	}
+
+	uint32_t GetN () const
+	{
+		return m_n;
+	}
+
+	double GetMean () const
+	{
+		return m_mean;
+	}
+
+	double GetVariance () const
+	{
+		return (m_n > 1) ? m_m2 / (m_n - 1) : 0;
+	}
+
+	// Half width of the Student t confidence interval of the mean
+	double GetHalfWidth (double level) const
+	{
+		if (m_n < 2)
+			return std::numeric_limits<double>::infinity ();
+
+		boost::math::students_t dist (m_n - 1);
+		double t = boost::math::quantile (boost::math::complement (dist, (1 - level) / 2));
+		return t * std::sqrt (GetVariance () / m_n);
+	}
+
+	// Whether the half width is within width times the mean
+	bool IsNarrow (double level, double width) const
+	{
+		double hw = GetHalfWidth (level);
+		return hw <= width * std::fabs (m_mean);
+	}
+
+private:
+	uint32_t m_n;
+	double m_mean;
+	double m_m2;
+};
+
+// Wall time and memory of the phases of a run, one Mark at the end of each phase
+class PhaseProfiler
+{
+public:
+	struct Phase
+	{
+		std::string name;
+		double wall;                              // Seconds spent in the phase
+		long rss;                                 // Resident set at the end of the phase (kB)
+		long peakRss;                             // Peak resident set so far (kB)
+	};
+
+	void Start ()
+	{
+		m_phases.clear ();
+		TIMER_NOW (m_start);
+		m_last = m_start;
+	}
+
+	void Mark (const char *name)
+	{
+		TIMER_TYPE now;
+		TIMER_NOW (now);
+
+		Phase phase;
+		phase.name = name;
+		phase.wall = TIMER_DIFF (now, m_last);
+		phase.rss = CurrentRss ();
+		phase.peakRss = PeakRss ();
+		m_phases.push_back (phase);
+
+		m_last = now;
+	}
+
+	// Tab separated, one phase per line and a total, # lines are comments
+	void Write (const std::string &path, const std::string &header) const
+	{
+		std::ofstream os (path.c_str ());
+		os << "# " << header << "\n";
+		os << "phase\twall_s\trss_kb\tpeak_rss_kb\n";
+
+		for (uint32_t i = 0; i < m_phases.size (); i++)
+			os << m_phases[i].name << "\t" << m_phases[i].wall << "\t" << m_phases[i].rss << "\t" << m_phases[i].peakRss << "\n";
+
+		os << "total\t" << TIMER_DIFF (m_last, m_start) << "\t" << CurrentRss () << "\t" << PeakRss () << "\n";
+	}
+
+	// Peak resident set of the process, in kB on Linux
+	static long PeakRss ()
+	{
+		struct rusage usage;
+		if (getrusage (RUSAGE_SELF, &usage) != 0)
+			return 0;
+		return usage.ru_maxrss;
+	}
+
+	// Current resident set of the process in kB, 0 where /proc is missing
+	static long CurrentRss ()
+	{
+		long pages = 0, resident = 0;
+		std::ifstream statm ("/proc/self/statm");
+		if (!(statm >> pages >> resident))
+			return 0;
+		return resident * (sysconf (_SC_PAGESIZE) / 1024);
+	}
+
+private:
+	TIMER_TYPE m_start;
+	TIMER_TYPE m_last;
+	std::vector<Phase> m_phases;
+};
+
+// Turns a warm started run into one of its variants, in the child forked
+// for it. Variants only differ in -fake and -results: the fake consumers of
+// the central nodes are installed here, to start at 1 s as they would have
+struct VariantSetup
+{
+	ScenarioConfig *cfg;                          // The configuration the run goes on with
+	std::string *resultDir;
+	const std::vector<ScenarioConfig> *variants;
+	ndn::AppHelper *consumerHelper;
+	NodeContainer centrals;
+	MetricsAggregator *aggregator;
+
+	void Apply (uint32_t variant)
+	{
+		*cfg = (*variants)[variant];
+		*resultDir = ResultDir (*cfg);
+
+		if (cfg->fake && !cfg->prefetch)
+		{
+			Time now = Simulator::Now ();
+			consumerHelper->SetAttribute ("StartTime", TimeValue (Seconds (1) - now));
+			consumerHelper->SetAttribute ("StopTime", TimeValue (Seconds (cfg->endTime - 1) - now));
+			consumerHelper->Install (centrals);
+
+			// Without prefetching these are the only applications of the central nodes
+			if (cfg->summary)
+				aggregator->InstallApps (centrals, CLASS_CENTRAL);
+		}
+	}
+};
+
+// The variants of a warm started run, and the forking of them
+struct WarmStartPlan
+{
+	std::vector<ScenarioConfig> variants;
+	WarmStart<ScenarioMetrics> fork;
+};
+
+// Builds the network described by config, runs it and reports back on the mobile
+// terminals. Traces and topologies found in cache are not read again. With a warm
+// start plan the run forks into its variants at config.forkAt, and the parent
+// returns once they are done, without results of its own
+ScenarioMetrics RunScenario (const ScenarioConfig &config, const ScenarioCache &cache, WarmStartPlan *warm = 0)
+{
+	ScenarioConfig cfg = config;                  // A warm start turns it into the variant
+
 	int maxSeq = -1;                              // Maximum number of Data packets to request
-	double retxtime = 0.05;                       // How frequent Interest retransmission timeouts should be checked (seconds)
-	int csSize = 10000000;                        // How big the Content Store should be
-	//double deltaTime = 10;
-        std::string nsTFile;                          // Name of the NS Trace file to use
-	char nsTDir[250] = "./Waypoints";           // Directory for the waypoint files
-	
+	std::string nsTFile;                          // Name of the NS Trace file to use
+
 	// Variable for buffer
 	char buffer[250];
 
-	CommandLine cmd;
-	cmd.AddValue ("mobile", "Number of mobile terminals in simulation", mobile);
-	cmd.AddValue ("servers", "Number of servers in the simulation", servers);
-	cmd.AddValue ("results", "Directory to place results", results);
-	cmd.AddValue ("start", "Starting second", sec);
-	cmd.AddValue ("fake", "Enable fake interest", fake);
-	cmd.AddValue ("trace", "Enable trace files", traceFiles);
-	cmd.AddValue ("smart", "Enable SmartFlooding forwarding", smart);
-	cmd.AddValue ("bestr", "Enable BestRoute forwarding", bestr);
-	cmd.AddValue ("csSize", "Number of Interests a Content Store can maintain", csSize);
-	cmd.AddValue ("walk", "Enable random walk at walking speed", walk);
-	cmd.AddValue ("speed", "Number of speed/hour of mobile terminals in the simulation", speed);
-	cmd.AddValue ("endTime", "How long the simulation will last (Seconds)", endTime);
-	cmd.AddValue ("mbps", "Data transmission rate for NDN App in MBps", MBps);
-	cmd.AddValue ("size", "Content size in MB (-1 is for no limit)", contentSize);
-	cmd.AddValue ("retx", "How frequent Interest retransmission timeouts should be checked in seconds", retxtime);
-	cmd.AddValue ("traceFile", "Directory containing Ns2 movement trace files (Usually created by Bonnmotion)", nsTDir);
-	//cmd.AddValue ("deltaTime", "time interval (s) between updates (default 100)", deltaTime);	
-	cmd.Parse (argc,argv);
+	// Time and memory of the setup phases and the run
+	PhaseProfiler profiler;
+	profiler.Start ();
 
-	NS_LOG_INFO("Random walk at human walking speed - 1.4m/s");
-	sprintf(buffer, "ns3::ConstantRandomVariable[Constant=%f]", speed);
+	// Where the results of this run go
+	std::string resultDir = ResultDir (cfg);
 
-	uint32_t top = speed;
+	// Which MPI rank this process is, the only one unless distributed. Every
+	// rank writes its results apart, merge-rank-traces.py joins the traces
+	uint32_t rank = 0;
+	uint32_t ranks = 1;
+#ifdef NS3_MPI
+	if (cfg.distributed)
+	{
+		rank = MpiInterface::GetSystemId ();
+		ranks = MpiInterface::GetSize ();
+		sprintf (buffer, "/rank%u", rank);
+		resultDir += buffer;
+	}
+#endif
 
-		sprintf(buffer, "%s/Walk_random.ns_movements", nsTDir);
-		switch (top)
-		{
-		case 5:
-                	sprintf(buffer, "%s/1.4.ns_movements", nsTDir);
-			break;
-		case 10:
-                	sprintf(buffer, "%s/2.8.ns_movements", nsTDir);
-			break;
-		case 20:
-                	sprintf(buffer, "%s/5.6.ns_movements", nsTDir);
-			break;
-		case 30:
-                	sprintf(buffer, "%s/8.3.ns_movements", nsTDir);
-			break;
-		case 40:
-                	sprintf(buffer, "%s/11.2.ns_movements", nsTDir);
-			break;
-		case 50:
-                	sprintf(buffer, "%s/13.9.ns_movements", nsTDir);
-			break;
-		case 60:
-                	sprintf(buffer, "%s/16.7.ns_movements", nsTDir);
-			break;
-		case 70:
-                	sprintf(buffer, "%s/19.4.ns_movements", nsTDir);
-			break;
-		case 80:
-                	sprintf(buffer, "%s/22.2.ns_movements", nsTDir);
-			break;
-		}
-		nsTFile = buffer;
+	// Event rates of the simulator, the counting scheduler goes in before anything is scheduled
+	SimStatsReporter simStats;
+	if (cfg.simStats > 0)
+	{
+		SystemPath::MakeDirectories (resultDir);
+		simStats.Start (resultDir + "/simstats.tsv", Seconds (cfg.simStats));
+	}
+
+	// Both ns-3 and our own generator are seeded from the seed and run number
+	// so every run can be repeated
+	RngSeedManager::SetSeed (cfg.seed);
+	RngSeedManager::SetRun (cfg.run);
+	gen.seed (((uint64_t) cfg.seed << 32) + cfg.run);
 
-	Ptr<ListPositionAllocator> initialMobile = CreateObject<ListPositionAllocator> ();
-	initialMobile->Add(Vector(100.0, 0.0, 0.0));
+	nsTFile = Ns2TracePath (cfg);
 
 	 // What the NDN Data packet payload size is fixed to 1024 bytes
 	uint32_t payLoadsize = 1024;
 
 	// Give the content size, find out how many sequence numbers are necessary
-	if (contentSize > 0)
+	if (cfg.contentSize > 0)
 	{
-		maxSeq = 1 + (((contentSize*1000000) - 1) / payLoadsize);
+		maxSeq = 1 + (((cfg.contentSize*1000000) - 1) / payLoadsize);
 	}
 
 	// How many Interests/second a producer creates
-	double intFreq = (MBps * 1000000) / payLoadsize;
-
-	vector<double> centralXpos;
-	vector<double> centralYpos;
-	centralXpos.push_back(50.0);
-	centralXpos.push_back(250.0);
-	centralYpos.push_back(-50.0);
-	centralYpos.push_back(-50.0);
-
-	vector<double> wirelessXpos;
-	vector<double> wirelessYpos;
-	wirelessXpos.push_back(0);
-	wirelessXpos.push_back(100);
-	wirelessXpos.push_back(200);
-	wirelessXpos.push_back(300);
-	wirelessYpos.push_back(0);
-	wirelessYpos.push_back(0);
-	wirelessYpos.push_back(0);
-	wirelessYpos.push_back(0);
+	double intFreq = (cfg.MBps * 1000000) / payLoadsize;
+
+	// Where the central nodes, APs and servers go, from the description file or generated
+	IccTopology topo;
+	std::map<std::string, IccTopology>::const_iterator cachedTopo = cache.topologies.find (cfg.topologyFile);
+	if (cachedTopo != cache.topologies.end ())
+		topo = cachedTopo->second;
+	else if (!cfg.topologyFile.empty ())
+	{
+		std::string error;
+		if (!IccTopology::Read (cfg.topologyFile, topo, error))
+			NS_FATAL_ERROR (error);
+	}
+	else if (cfg.layout == "hex")
+		topo = IccTopology::Hex (cfg.sectors, cfg.aps, cfg.spacing);
+	else if (cfg.layout == "road")
+		topo = IccTopology::Road (cfg.sectors, cfg.aps, cfg.spacing);
+	else
+		NS_FATAL_ERROR ("Unknown layout " << cfg.layout << ", use road or hex");
+
+	uint32_t sectors = topo.GetNSectors ();       // Number of wireless sectors
+	uint32_t wnodes = topo.GetNAps ();            // Number of wireless access nodes in the network
+
+	sprintf(buffer, "Topology of %u sectors with %u APs", sectors, wnodes);
+	NS_LOG_INFO(buffer);
+
+	// Mobiles associate with the first AP, and the producers need a server
+	if (wnodes == 0)
+		NS_FATAL_ERROR ("Topology without APs, use -sectors and -aps of at least 1 or ap lines in the file");
+	if (cfg.servers == 0)
+		NS_FATAL_ERROR ("No servers, -servers has to be at least 1");
+
+	// Every node is created on every rank, with the rank that runs it as system id
+	if (ranks > sectors)
+		NS_FATAL_ERROR ("More MPI ranks than sectors, every rank needs a sector");
+	RankPlan rankPlan;
+	rankPlan.Assign (topo, rank, ranks);
 
 	NS_LOG_INFO ("------Creating nodes------");
 	// Node definitions for mobile terminals (consumers)
 	NodeContainer mobileTerminalContainer;
-	mobileTerminalContainer.Create(mobile);
+	for (uint32_t i = 0; i < cfg.mobile; i++)
+		mobileTerminalContainer.Create (1, rankPlan.GetMobileRank (i));
 
 	std::vector<uint32_t> mobileNodeIds;
+	mobileNodeIds.reserve (cfg.mobile);
 
 	// Save all the mobile Node IDs
-	for (int i = 0; i < mobile; i++)
+	for (uint32_t i = 0; i < cfg.mobile; i++)
 	{
 		mobileNodeIds.push_back(mobileTerminalContainer.Get (i)->GetId ());
 	}
 
 	// Central Nodes
 	NodeContainer centralContainer;
-	centralContainer.Create (sectors);
+	for (uint32_t s = 0; s < sectors; s++)
+		centralContainer.Create (1, rankPlan.GetSectorRank (s));
 
 	// Wireless access Nodes
 	NodeContainer wirelessContainer;
-	wirelessContainer.Create (wnodes);
-
-	// Separate the wireless nodes into sector specific containers
-	std::vector<NodeContainer> sectorNodes;
-
-	for (int i = 0; i < sectors; i++)
-	{
-		NodeContainer wireless;
-		for (int j = i*aps; j < aps + i*aps; j++)
-		{
-			wireless.Add(wirelessContainer.Get (j));
-		}
-		sectorNodes.push_back(wireless);
-	}
-
-	// Find out how many first level nodes we will have
-	// The +1 is for the server which will be attached to the first level nodes
-	int first = (sectors / 3) + 1;
-
+	for (uint32_t i = 0; i < wnodes; i++)
+		wirelessContainer.Create (1, rankPlan.GetApRank (i));
 
 	// Container for all NDN capable nodes
 	NodeContainer allNdnNodes;
@@ -294,12 +697,14 @@ int main (int argc, char *argv[])
 
 	// Container for server (producer) nodes
 	NodeContainer serverNodes;
-	serverNodes.Create (servers);
+	for (uint32_t i = 0; i < cfg.servers; i++)
+		serverNodes.Create (1, rankPlan.GetServerRank (i));
 
 	std::vector<uint32_t> serverNodeIds;
+	serverNodeIds.reserve (cfg.servers);
 
 	// Save all the mobile Node IDs
-	for (int i = 0; i < servers; i++)
+	for (uint32_t i = 0; i < cfg.servers; i++)
 	{
 		serverNodeIds.push_back(serverNodes.Get (i)->GetId ());
 	}
@@ -309,92 +714,187 @@ int main (int argc, char *argv[])
 	allUserNodes.Add (mobileTerminalContainer);
 	allUserNodes.Add (serverNodes);
 
-	// Make sure to seed our random
-	gen.seed (std::time (0) + (long long)getpid () << 32);
+	// The nodes this rank runs, all of them unless distributed. Wifi, applications
+	// and tracers only go on these
+	NodeContainer localMobiles = rankPlan.GetLocal (mobileTerminalContainer);
+	NodeContainer localCentrals = rankPlan.GetLocal (centralContainer);
+	NodeContainer localWireless = rankPlan.GetLocal (wirelessContainer);
+	NodeContainer localServers = rankPlan.GetLocal (serverNodes);
+	NodeContainer localNodes = rankPlan.GetLocal (NodeContainer::GetGlobal ());
 
-	MobilityHelper Server;
-	Ptr<ListPositionAllocator> initialServer = CreateObject<ListPositionAllocator> ();
+	std::vector<uint32_t> localAps;
+	for (uint32_t i = 0; i < wnodes; i++)
+	{
+		if (rankPlan.GetApRank (i) == rank)
+			localAps.push_back (i);
+	}
 
-	Vector posServer (150, -100, 0.0);
-	initialServer->Add (posServer);
+	if (ranks > 1)
+	{
+		sprintf(buffer, "Rank %u of %u runs %u sectors, %u APs and %u mobile terminals", rank, ranks,
+				localCentrals.GetN (), (uint32_t) localAps.size (), localMobiles.GetN ());
+		NS_LOG_INFO(buffer);
+	}
 
-	Server.SetPositionAllocator(initialServer);
-	Server.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-	Server.Install(serverNodes);
+	profiler.Mark ("nodes");
 
-	NS_LOG_INFO ("------Placing Central nodes-------");
-	MobilityHelper centralStations;
+	NS_LOG_INFO ("------Placing servers, central nodes and wireless access nodes------");
+	topo.InstallMobility (centralContainer, wirelessContainer, serverNodes);
 
-	Ptr<ListPositionAllocator> initialCenter = CreateObject<ListPositionAllocator> ();
+	NS_LOG_INFO ("------Placing mobile node and determining direction and speed------");
 
-	for (int i = 0; i < sectors; i++)
+	// Binary waypoint files (see icc-waypoint-convert) are streamed a window at a
+	// time, ns-2 traces are read whole. Both move the mobile terminals, which are
+	// the first nodes created. A batch parses the ns-2 traces of its -trajectory
+	// lines once; the other lines read them with Ns2MobilityHelper, as the
+	// same command run alone would
+	std::map<std::string, std::vector<iccwaypoint::Record> >::const_iterator cachedTrace = cache.traces.find (nsTFile);
+	WaypointStreamer waypoints;
+	if (cfg.waypointWindow <= 0)
+		NS_FATAL_ERROR ("Waypoint window of " << cfg.waypointWindow << " s, it has to be positive");
+
+	// Over several ranks a mobile only reaches its own rank's APs, a trace
+	// taking it elsewhere would silently cut it off
+	if (ranks > 1)
 	{
-		Vector pos (centralXpos[i], centralYpos[i], 0.0);
-		initialCenter->Add (pos);
+		std::string error;
+		bool inArea = true;
+		if (!cfg.waypoints.empty ())
+		{
+			iccwaypoint::WaypointFile file;
+			if (!file.Open (cfg.waypoints))
+				NS_FATAL_ERROR (file.GetError ());
+			inArea = rankPlan.CheckRecords (topo, file.GetNRecords () ? &file.GetRecord (0) : 0, file.GetNRecords (),
+					cfg.mobile, error);
+		}
+		else if (cachedTrace != cache.traces.end ())
+		{
+			const std::vector<iccwaypoint::Record> &cached = cachedTrace->second;
+			inArea = rankPlan.CheckRecords (topo, cached.empty () ? 0 : &cached[0], cached.size (), cfg.mobile, error);
+		}
+		else
+		{
+			// Without a readable trace no mobile is traced
+			std::vector<iccwaypoint::Record> records;
+			iccwaypoint::Ns2Parser parser;
+			if (parser.Parse (nsTFile, records))
+				inArea = rankPlan.CheckRecords (topo, records.empty () ? 0 : &records[0], records.size (), cfg.mobile, error);
+		}
+		if (!inArea)
+			NS_FATAL_ERROR (error);
 	}
 
-	centralStations.SetPositionAllocator(initialCenter);
-	centralStations.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-	centralStations.Install(centralContainer);
-
-	NS_LOG_INFO ("------Placing wireless access nodes------");
-	MobilityHelper wirelessStations;
+	if (cfg.trajectory)
+	{
+		// Whole trajectories are computed up front, positions are interpolated
+		// on demand without any event per waypoint
+		iccwaypoint::WaypointFile file;
+		std::vector<iccwaypoint::Record> records;
+		uint32_t moved;
 
-	Ptr<ListPositionAllocator> initialWireless = CreateObject<ListPositionAllocator> ();
+		if (!cfg.waypoints.empty ())
+		{
+			if (!file.Open (cfg.waypoints))
+				NS_FATAL_ERROR (file.GetError ());
+			moved = TrajectoryBuilder::Install (file.GetNRecords () ? &file.GetRecord (0) : 0, file.GetNRecords (),
+					mobileTerminalContainer);
+		}
+		else if (cachedTrace != cache.traces.end ())
+		{
+			const std::vector<iccwaypoint::Record> &cached = cachedTrace->second;
+			moved = TrajectoryBuilder::Install (cached.empty () ? 0 : &cached[0], cached.size (), mobileTerminalContainer);
+		}
+		else
+		{
+			iccwaypoint::Ns2Parser parser;
+			if (!parser.Parse (nsTFile, records))
+				NS_FATAL_ERROR (parser.GetError ());
+			iccwaypoint::Normalize (records);
+			moved = TrajectoryBuilder::Install (records.empty () ? 0 : &records[0], records.size (), mobileTerminalContainer);
+		}
 
-	for (int i = 0; i < wnodes; i++)
-	{
-		Vector pos (wirelessXpos[i], wirelessYpos[i], 0.0);
-		initialWireless->Add (pos);
+		sprintf(buffer, "Trajectories for %u mobile terminals", moved);
+		NS_LOG_INFO(buffer);
 	}
+	else if (!cfg.waypoints.empty ())
+	{
+		snprintf(buffer, sizeof (buffer), "Streaming waypoint file %s", cfg.waypoints.c_str());
+		NS_LOG_INFO(buffer);
 
-	wirelessStations.SetPositionAllocator(initialWireless);
-	wirelessStations.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-	wirelessStations.Install(wirelessContainer);
+		if (!waypoints.Open (cfg.waypoints))
+			NS_FATAL_ERROR (waypoints.GetError ());
+		waypoints.Install (mobileTerminalContainer, Seconds (cfg.waypointWindow));
+	}
+	else
+	{
+		snprintf(buffer, sizeof (buffer), "Reading NS trace file %s", nsTFile.c_str());
+		NS_LOG_INFO(buffer);
 
-	NS_LOG_INFO ("------Placing mobile node and determining direction and speed------");
-	MobilityHelper mobileStations;
+		Ns2MobilityHelper ns2 = Ns2MobilityHelper (nsTFile);
+		ns2.Install ();
+	}
 
+	// Mobiles the trace does not cover walk randomly over the area of the
+	// rank's APs at the scenario speed (km/h)
+	NodeContainer unmoved;
+	for (uint32_t i = 0; i < localMobiles.GetN (); i++)
+	{
+		if (localMobiles.Get (i)->GetObject<MobilityModel> () == 0)
+			unmoved.Add (localMobiles.Get (i));
+	}
 
-	sprintf(buffer, "0|%d|0|%d", xaxis, yaxis);
-	string bounds = string(buffer);
+	if (unmoved.GetN () > 0)
+	{
+		const Vector &first = topo.GetAp (localAps[0]);
+		double minX = first.x, maxX = minX, minY = first.y, maxY = minY;
+		for (uint32_t k = 1; k < localAps.size (); k++)
+		{
+			const Vector &ap = topo.GetAp (localAps[k]);
+			minX = std::min (minX, ap.x);
+			maxX = std::max (maxX, ap.x);
+			minY = std::min (minY, ap.y);
+			maxY = std::max (maxY, ap.y);
+		}
+		// Keep some room to move on a line of APs, or around a single one
+		maxX = std::max (maxX, minX + 1);
+		maxY = std::max (maxY, minY + 1);
 
+		sprintf(buffer, "%u mobile terminals not in the trace walk randomly in [%.0f,%.0f]x[%.0f,%.0f]",
+				unmoved.GetN (), minX, maxX, minY, maxY);
+		NS_LOG_INFO(buffer);
 
-	sprintf(buffer, "Reading NS trace file %s", nsTFile.c_str());
-    NS_LOG_INFO(buffer);
+		MobilityHelper walkers;
+		char xRange[100], yRange[100];
+		sprintf(xRange, "ns3::UniformRandomVariable[Min=%f|Max=%f]", minX, maxX);
+		sprintf(yRange, "ns3::UniformRandomVariable[Min=%f|Max=%f]", minY, maxY);
+		walkers.SetPositionAllocator ("ns3::RandomRectanglePositionAllocator",
+				"X", StringValue (xRange),
+				"Y", StringValue (yRange));
+		sprintf(buffer, "ns3::ConstantRandomVariable[Constant=%f]", cfg.speed / 3.6);
+		walkers.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+				"Bounds", RectangleValue (Rectangle (minX, maxX, minY, maxY)),
+				"Speed", StringValue (buffer));
+		walkers.Install (unmoved);
+	}
 
-	Ns2MobilityHelper ns2 = Ns2MobilityHelper (nsTFile);
-	ns2.Install ();
+	profiler.Mark ("mobility");
 
 	// Connect Wireless Nodes to central nodes
 	// Because the simulation is using Wifi, PtP connections are 100Mbps
 	// with 5ms delay
 	NS_LOG_INFO("------Connecting Central nodes to wireless access nodes------");
 
-	vector <NetDeviceContainer> ptpWLANCenterDevices;
-
 	PointToPointHelper p2p_100mbps5ms;
 	p2p_100mbps5ms.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
 	p2p_100mbps5ms.SetChannelAttribute ("Delay", StringValue ("5ms"));
 
-	for (int i = 0; i < sectors; i++)
-	{
-		NetDeviceContainer ptpWirelessCenterDevices;
-
-		for (int j = 0; j < aps; j++)
-		{
-			ptpWirelessCenterDevices.Add (p2p_100mbps5ms.Install (centralContainer.Get (i), sectorNodes[i].Get (j) ));
-		}
-
-		ptpWLANCenterDevices.push_back (ptpWirelessCenterDevices);
-	}
-
-	// Connect the server to central node
+	// Every AP goes to the central node of its sector, and the server to every central node
+	vector <NetDeviceContainer> ptpWLANCenterDevices;
 	NetDeviceContainer ptpServerlowerNdnDevices;
-	for(int i =0; i < sectors; i++){
-		ptpServerlowerNdnDevices.Add (p2p_100mbps5ms.Install (serverNodes.Get (0), centralContainer.Get (i)));
+	topo.InstallLinks (p2p_100mbps5ms, centralContainer, wirelessContainer, serverNodes.Get (0),
+			ptpWLANCenterDevices, ptpServerlowerNdnDevices);
 
-	}
+	profiler.Mark ("links");
 
 
 	NS_LOG_INFO ("------Creating Wireless cards------");
@@ -413,13 +913,49 @@ int main (int argc, char *argv[])
 
 	YansWifiChannelHelper wifiChannel;
 	wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
-	wifiChannel.AddPropagationLoss ("ns3::ThreeLogDistancePropagationLossModel");
-	wifiChannel.AddPropagationLoss("ns3::NakagamiPropagationLossModel");
+	Ptr<YansWifiChannel> channel = wifiChannel.Create ();
+
+	Ptr<ThreeLogDistancePropagationLossModel> logDistance = CreateObject<ThreeLogDistancePropagationLossModel> ();
+	Ptr<NakagamiPropagationLossModel> nakagami = CreateObject<NakagamiPropagationLossModel> ();
+	Ptr<PropagationLossModel> loss = logDistance;
+	loss->SetNext (nakagami);
+
+	// With -lossBatch one model stands in for the chain and evaluates every
+	// receiver of a frame at once, it culls by itself. The receivers are added
+	// once the Wifi devices are installed
+	Ptr<BatchedLossModel> batched;
+	if (cfg.lossBatch)
+	{
+		if (cfg.cullValidate)
+			NS_FATAL_ERROR ("-cullValidate checks the culling of the ns-3 loss models, run it without -lossBatch");
+
+		batched = CreateObject<BatchedLossModel> ();
+		batched->CopyParameters (logDistance, nakagami);
+		batched->SetAttribute ("MaxRange", DoubleValue (cfg.cullRange));
+		loss = batched;
+
+		sprintf(buffer, "Batched Wifi loss with %s kernels", batched->UsesAvx2 () ? "AVX2" : "scalar");
+		NS_LOG_INFO(buffer);
+	}
 
-	// All interfaces are placed on the same channel. Makes AP changes easy. Might
-	// have to be reconsidered for multiple mobile nodes
+	// With -cullRange the loss chain only runs for receivers in range of the
+	// sender, which is what every transmission costs on a long road
+	Ptr<RangeCullingLossModel> culling;
+	if (cfg.cullRange > 0 && !cfg.lossBatch)
+	{
+		culling = CreateObject<RangeCullingLossModel> ();
+		culling->SetAttribute ("MaxRange", DoubleValue (cfg.cullRange));
+		culling->SetAttribute ("Validate", BooleanValue (cfg.cullValidate));
+		culling->SetInner (loss);
+		loss = culling;
+	}
+	channel->SetPropagationLossModel (loss);
+
+	// All interfaces share one YansWifiChannel. With -channels above 1 the APs are
+	// spread over several channel numbers and stations follow their AP, so only
+	// PHYs on the sender's channel receive (and compute the loss of) a transmission
 	YansWifiPhyHelper wifiPhyHelper = YansWifiPhyHelper::Default ();
-	wifiPhyHelper.SetChannel (wifiChannel.Create ());
+	wifiPhyHelper.SetChannel (channel);
 	wifiPhyHelper.Set("TxPowerStart", DoubleValue(16.0206));
 	wifiPhyHelper.Set("TxPowerEnd", DoubleValue(1));
 
@@ -428,14 +964,29 @@ int main (int argc, char *argv[])
 
 	// Create SSIDs for all the APs
 	std::vector<Ssid> ssidV;
+	ssidV.reserve (wnodes);
 
 	NS_LOG_INFO ("------Creating ssids for wireless cards------");
 
-	// We store the Wifi AP mobility models in a map, ordered by the ssid string. Will be easier to manage when
-	// calling the modified StaMApWifiMac
-	std::map<std::string, Ptr<MobilityModel> > apTerminalMobility;
-
-	for (int i = 0; i < wnodes; i++)
+	// The handover engine keeps the Wifi AP positions in a spatial index, built once
+	// all the APs are known, and answers the nearest AP queries for the mobile nodes
+	HandoverEngine handover;
+	handover.ConnectHandover (MakeBoundCallback (&LogHandover, &localAps));
+
+	// The engine and the channel plan number the APs of this rank in order,
+	// which are all of them unless distributed
+	ChannelPlan channelPlan;
+	if (cfg.channelPlan != "sector" && cfg.channelPlan != "ap")
+		NS_FATAL_ERROR ("Unknown channel plan " << cfg.channelPlan << ", use sector or ap");
+	std::vector<uint32_t> apGroup (localAps.size ());
+	for (uint32_t k = 0; k < localAps.size (); k++)
+		apGroup[k] = cfg.channelPlan == "ap" ? localAps[k] : topo.GetSector (localAps[k]);
+	channelPlan.Assign (apGroup, cfg.channels);
+
+	if (cfg.channels > 1)
+		handover.ConnectHandover (MakeCallback (&ChannelPlan::Handover, &channelPlan));
+
+	for (uint32_t i = 0; i < wnodes; i++)
 	{
 		// Temporary string containing our SSID
 		std::string ssidtmp("ap-" + boost::lexical_cast<std::string>(i));
@@ -443,46 +994,72 @@ int main (int argc, char *argv[])
 		// Push the newly created SSID into a vector
 		ssidV.push_back (Ssid (ssidtmp));
 
+		// Mobiles only reach the APs of their own rank
+		if (rankPlan.GetApRank (i) != rank)
+			continue;
+
 		// Get the mobility model for wnode i
 		Ptr<MobilityModel> tmp = (wirelessContainer.Get (i))->GetObject<MobilityModel> ();
 
-		// Store the information into our map
-		apTerminalMobility[ssidtmp] = tmp;
+		// Register the AP with the handover engine
+		handover.AddAp (ssidV[i], tmp);
 	}
 
+	handover.Build ();
+
 	NS_LOG_INFO ("------Assigning mobile terminal wireless cards------");
 
 	NS_LOG_INFO ("Assigning AP wireless cards");
 	std::vector<NetDeviceContainer> wifiAPNetDevices;
-	for (int i = 0; i < wnodes; i++)
+	wifiAPNetDevices.reserve (localAps.size ());
+	for (uint32_t k = 0; k < localAps.size (); k++)
 	{
 		wifiMacHelper.SetType ("ns3::ApWifiMac",
-						   "Ssid", SsidValue (ssidV[i]),
+						   "Ssid", SsidValue (ssidV[localAps[k]]),
 						   "BeaconGeneration", BooleanValue (true),
 						   "BeaconInterval", TimeValue (Seconds (0.102)));
+		wifiPhyHelper.Set ("ChannelNumber", UintegerValue (channelPlan.GetApChannel (k)));
 
-		wifiAPNetDevices.push_back (wifi.Install (wifiPhyHelper, wifiMacHelper, wirelessContainer.Get (i)));
+		wifiAPNetDevices.push_back (wifi.Install (wifiPhyHelper, wifiMacHelper, wirelessContainer.Get (localAps[k])));
 	}
 
 	// Create a Wifi station with a modified Station MAC.
 	wifiMacHelper.SetType("ns3::StaWifiMac",
-			"Ssid", SsidValue (ssidV[0]),
+			"Ssid", SsidValue (ssidV[localAps[0]]),
 			"ActiveProbing", BooleanValue (true));
+	wifiPhyHelper.Set ("ChannelNumber", UintegerValue (channelPlan.GetApChannel (0)));
+
+	NetDeviceContainer wifiMTNetDevices = wifi.Install (wifiPhyHelper, wifiMacHelper, localMobiles);
 
-	NetDeviceContainer wifiMTNetDevices = wifi.Install (wifiPhyHelper, wifiMacHelper, mobileTerminalContainer);
+	// Using the same calculation from the Yans-wifi-Channel, we hand the mobility models
+	// of the mobile nodes to the handover engine, together with the station MACs so
+	// SSID changes do not go through Config paths. All stations start on the first AP
+	for (uint32_t i = 0; i < localMobiles.GetN (); i++)
+	{
+		Ptr<WifiNetDevice> wifiDev = DynamicCast<WifiNetDevice> (wifiMTNetDevices.Get (i));
+		Ptr<MobilityModel> mobility = localMobiles.Get (i)->GetObject<MobilityModel> ();
+		uint32_t nodeId = localMobiles.Get (i)->GetId ();
 
-	// Using the same calculation from the Yans-wifi-Channel, we obtain the Mobility Models for the
-	// mobile node as well as all the Wifi capable nodes
-	Ptr<MobilityModel> mobileTerminalMobility = (mobileTerminalContainer.Get (0))->GetObject<MobilityModel> ();
+		uint32_t index = handover.AddMobile (nodeId, mobility, wifiDev->GetMac (), 0);
+		channelPlan.AddStation (nodeId, DynamicCast<YansWifiPhy> (wifiDev->GetPhy ()));
 
-	std::vector<Ptr<MobilityModel> > mobileTerminalsMobility;
+		// Trajectories change course without telling, the engine asks them when
+		Ptr<TrajectoryMobilityModel> trajectory = DynamicCast<TrajectoryMobilityModel> (mobility);
+		if (trajectory != 0)
+			handover.SetCourseChangeHorizon (index, MakeCallback (&TrajectoryMobilityModel::GetTimeToNextChange, trajectory));
+	}
 
-	// Get the list of mobile node mobility models
-	for (int i = 0; i < mobile; i++)
+	// Every PHY on the channel is a receiver of the batched loss
+	if (batched != 0)
 	{
-		mobileTerminalsMobility.push_back((mobileTerminalContainer.Get (i))->GetObject<MobilityModel> ());
+		for (uint32_t k = 0; k < localAps.size (); k++)
+			batched->AddReceiver (wirelessContainer.Get (localAps[k])->GetObject<MobilityModel> ());
+		for (uint32_t i = 0; i < localMobiles.GetN (); i++)
+			batched->AddReceiver (localMobiles.Get (i)->GetObject<MobilityModel> ());
 	}
 
+	profiler.Mark ("wifi");
+
 	char routeType[250];
 
 	// Now install content stores and the rest on the middle node. Leave
@@ -491,11 +1068,11 @@ int main (int argc, char *argv[])
 	ndn::StackHelper ndnHelperRouters;
 
 	// Decide what Forwarding strategy to use depending on user command line input
-	if (smart) {
+	if (cfg.smart) {
 		sprintf(routeType, "%s", "smart");
 		NS_LOG_INFO ("NDN Utilizing SmartFlooding");
 		ndnHelperRouters.SetForwardingStrategy ("ns3::ndn::fw::SmartFlooding::PerOutFaceLimits", "Limit", "ns3::ndn::Limits::Window");
-	} else if (bestr) {
+	} else if (cfg.bestr) {
 		sprintf(routeType, "%s", "bestr");
 		NS_LOG_INFO ("NDN Utilizing BestRoute");
 		ndnHelperRouters.SetForwardingStrategy ("ns3::ndn::fw::BestRoute::PerOutFaceLimits", "Limit", "ns3::ndn::Limits::Window");
@@ -507,9 +1084,14 @@ int main (int argc, char *argv[])
 
 	// Set the Content Stores
 
-	sprintf(buffer, "%d", csSize);
+	sprintf(buffer, "%d", cfg.csSize);
 
-	ndnHelperRouters.SetContentStore ("ns3::ndn::cs::Freshness::Lru", "MaxSize", buffer);
+	if (cfg.csStore == "arena")
+		ndnHelperRouters.SetContentStore (ArenaContentStore::GetTypeId ().GetName (), "MaxSize", buffer);
+	else if (cfg.csStore == "lru")
+		ndnHelperRouters.SetContentStore ("ns3::ndn::cs::Freshness::Lru", "MaxSize", buffer);
+	else
+		NS_FATAL_ERROR ("Unknown Content Store " << cfg.csStore << ", use lru or arena");
 	ndnHelperRouters.SetDefaultRoutes (true);
 	// Install on ICN capable routers
 	ndnHelperRouters.Install (allNdnNodes);
@@ -523,53 +1105,196 @@ int main (int argc, char *argv[])
 	ndnHelperUsers.SetDefaultRoutes (true);
 	ndnHelperUsers.Install (allUserNodes);
 
+	profiler.Mark ("ndn-stack");
+
 	NS_LOG_INFO ("------Installing Producer Application------");
 
 	sprintf(buffer, "Producer Payload size: %d", payLoadsize);
 	NS_LOG_INFO (buffer);
 
-	// Create the producer on the mobile node
-	ndn::AppHelper producerHelper ("ns3::ndn::Producer");
+	// Create the producer on the mobile node. With -sharedPayload or -pool
+	// it is our own, which allocates less per Data
+	bool iccProducer = cfg.sharedPayload || cfg.pool;
+	ndn::AppHelper producerHelper (iccProducer ? IccProducer::GetTypeId ().GetName () : "ns3::ndn::Producer");
 	producerHelper.SetPrefix ("/waseda/sato");
-	producerHelper.SetAttribute ("StopTime", TimeValue (Seconds(endTime-1)));
+	producerHelper.SetAttribute ("StopTime", TimeValue (Seconds(cfg.endTime-1)));
 	// Payload size is in bytes
 	producerHelper.SetAttribute ("PayloadSize", UintegerValue(payLoadsize));
-	producerHelper.Install (serverNodes);
+	if (iccProducer)
+	{
+		producerHelper.SetAttribute ("SharedPayload", BooleanValue (cfg.sharedPayload));
+		producerHelper.SetAttribute ("Pool", BooleanValue (cfg.pool));
+	}
+	producerHelper.Install (localServers);
 
 	NS_LOG_INFO ("------Installing Consumer Application------");
 
 	sprintf(buffer, "Consumer Interest/s frequency: %f", intFreq);
 	NS_LOG_INFO (buffer);
 
-	// Create the consumer on the randomly selected node
-	ndn::AppHelper consumerHelper ("ns3::ndn::ConsumerCbr");
+	// Create the consumer on the randomly selected node. With -pool,
+	// -retxWheel or -handoverPause it is our own
+	bool iccConsumer = cfg.pool || cfg.retxWheel || cfg.handoverPause;
+	ndn::AppHelper consumerHelper (iccConsumer ? IccConsumerCbr::GetTypeId ().GetName () : "ns3::ndn::ConsumerCbr");
 	consumerHelper.SetPrefix ("/waseda/sato");
 	consumerHelper.SetAttribute ("Frequency", DoubleValue (intFreq));
 	consumerHelper.SetAttribute ("StartTime", TimeValue (Seconds(1)));
-	consumerHelper.SetAttribute ("StopTime", TimeValue (Seconds(endTime-1)));
-	consumerHelper.SetAttribute ("RetxTimer", TimeValue (Seconds(retxtime)));
+	consumerHelper.SetAttribute ("StopTime", TimeValue (Seconds(cfg.endTime-1)));
+	consumerHelper.SetAttribute ("RetxTimer", TimeValue (Seconds(cfg.retxtime)));
+	if (iccConsumer)
+	{
+		consumerHelper.SetAttribute ("Pool", BooleanValue (cfg.pool));
+		consumerHelper.SetAttribute ("RetxWheel", BooleanValue (cfg.retxWheel));
+		// Only the mobiles have a station to follow, the fake consumers never pause
+		consumerHelper.SetAttribute ("HandoverPause", BooleanValue (cfg.handoverPause));
+		consumerHelper.SetAttribute ("BurstRate", DoubleValue (cfg.burstRate));
+	}
 	if (maxSeq > 0)
 		consumerHelper.SetAttribute ("MaxSeq", IntegerValue(maxSeq));
 
-	consumerHelper.Install (mobileTerminalContainer);
-	if(fake)	consumerHelper.Install (centralContainer);			//change here (normal / fake interest)
+	if (cfg.prefixPerMobile)
+	{
+		// Every mobile asks for its own content, /waseda/sato/mt<i>
+		for (uint32_t i = 0; i < cfg.mobile; i++)
+		{
+			if (!rankPlan.IsLocal (mobileTerminalContainer.Get (i)))
+				continue;
+			sprintf(buffer, "/waseda/sato/mt%u", i);
+			consumerHelper.SetPrefix (buffer);
+			consumerHelper.Install (mobileTerminalContainer.Get (i));
+		}
+		consumerHelper.SetPrefix ("/waseda/sato");
+	}
+	else
+		consumerHelper.Install (localMobiles);
+	if(cfg.fake && !cfg.prefetch)	consumerHelper.Install (localCentrals);			//change here (normal / fake interest)
+
+	// Prefetching replaces the blanket fake interests: the central node of the
+	// sector a mobile is about to enter fetches what the mobile will ask for there
+	std::vector<uint32_t> apSector (localAps.size ());
+	for (uint32_t k = 0; k < localAps.size (); k++)
+		apSector[k] = topo.GetSector (localAps[k]);
+
+	// What the mobiles are at, in the handover engine's order
+	ConsumerProgress progress;
+	for (uint32_t i = 0; i < localMobiles.GetN (); i++)
+		progress.AddMobile (localMobiles.Get (i));
+
+	PrefetchPlanner prefetch (handover, progress, apSector, intFreq);
+	if (cfg.prefetch)
+	{
+		NS_LOG_INFO ("------Installing Prefetch Applications------");
 
-	sprintf(buffer, "Ending time! %f", endTime);
-	NS_LOG_INFO(buffer);
+		ndn::AppHelper prefetchHelper (PrefetchApp::GetTypeId ().GetName ());
+		prefetchHelper.SetAttribute ("Frequency", DoubleValue (intFreq * cfg.prefetchRate));
+		prefetchHelper.SetAttribute ("StartTime", TimeValue (Seconds(1)));
+		prefetchHelper.SetAttribute ("StopTime", TimeValue (Seconds(cfg.endTime-1)));
 
-	// If the variable is set, print the trace files
-	if (traceFiles) {
-		ifstream inpurFile;
-		ofstream plotdata;
-		// Filename
-		char filename[250];
+		for (uint32_t s = 0; s < sectors; s++)
+		{
+			if (rankPlan.IsLocal (centralContainer.Get (s)))
+				prefetch.AddSector (s, DynamicCast<PrefetchApp> (prefetchHelper.Install (centralContainer.Get (s)).Get (0)));
+		}
+
+		prefetch.SetLookahead (cfg.prefetchLookahead, cfg.prefetchWindow);
+		if (maxSeq > 0)
+			prefetch.SetMaxSeq (maxSeq - 1);
+		prefetch.Start (Seconds (0.5));
+	}
 
-		// File ID
-		char fileId[250];
+	// Warming puts the next segments a mobile wants straight into the store of
+	// the AP it is about to be handed to
+	CacheWarmer warmer (handover, progress, intFreq, payLoadsize);
+	if (cfg.warm > 0)
+	{
+		sprintf(buffer, "Warming the next AP with %u segments, %f seconds ahead", cfg.warm, cfg.warmLookahead);
+		NS_LOG_INFO(buffer);
 
+		for (uint32_t k = 0; k < localAps.size (); k++)
+			warmer.AddAp (wirelessContainer.Get (localAps[k]));
 
-		// Create the file identifier
-		sprintf(fileId, "%s-%02d-%03d-%03d.txt", routeType, mobile, servers, wnodes);
+		warmer.SetSegments (cfg.warm, cfg.warmLookahead);
+		if (maxSeq > 0)
+			warmer.SetMaxSeq (maxSeq - 1);
+		warmer.Start (Seconds (0.5));
+	}
+
+	if (cfg.prefetch || cfg.warm > 0)
+		progress.Start ();
+
+	// The interests the consumers send, where they enter the routers
+	InterestCapture capture (handover);
+	if (cfg.capture)
+	{
+		SystemPath::MakeDirectories (resultDir);
+		capture.Open (resultDir + "/interests.tsv", topo);
+		capture.AddMobiles (localMobiles);
+		capture.AddCentrals (centralContainer);
+	}
+
+	// The mobile consumers always feed the run metrics, the rest only the summary
+	MetricsAggregator aggregator;
+	aggregator.InstallApps (localMobiles, CLASS_MOBILE);
+	aggregator.InstallHandoverWindow (localMobiles, Seconds (cfg.handoverWindow));
+	handover.ConnectHandover (MakeCallback (&MetricsAggregator::NoteHandover, &aggregator));
+	if (cfg.summary)
+	{
+		aggregator.InstallPerNode (localMobiles);
+
+		aggregator.InstallApps (localCentrals, CLASS_CENTRAL);
+		aggregator.InstallL3 (localMobiles, CLASS_MOBILE);
+		aggregator.InstallL3 (localCentrals, CLASS_CENTRAL);
+		aggregator.InstallL3 (localWireless, CLASS_WIRELESS);
+		aggregator.InstallL3 (localServers, CLASS_SERVER);
+	}
+
+	// Occupancy and hits of the router Content Stores over the run
+	CsMonitor csMonitor;
+	if (cfg.csStats > 0)
+	{
+		csMonitor.Add (localCentrals, CLASS_CENTRAL);
+		csMonitor.Add (localWireless, CLASS_WIRELESS);
+
+		SystemPath::MakeDirectories (resultDir);
+		csMonitor.Start (resultDir + "/cs.tsv", Seconds (cfg.csStats));
+	}
+
+	// Heap allocations over the run, the setup is left out
+	AllocStatsReporter allocStats;
+	if (cfg.allocStats > 0)
+	{
+		SystemPath::MakeDirectories (resultDir);
+		allocStats.Start (resultDir + "/allocs.tsv", Seconds (cfg.allocStats));
+	}
+
+	VariantSetup variantSetup;
+	if (warm != 0)
+	{
+		sprintf(buffer, "Forking %u variants at %f", (uint32_t) warm->variants.size (), cfg.forkAt);
+		NS_LOG_INFO(buffer);
+
+		variantSetup.cfg = &cfg;
+		variantSetup.resultDir = &resultDir;
+		variantSetup.variants = &warm->variants;
+		variantSetup.consumerHelper = &consumerHelper;
+		variantSetup.centrals = localCentrals;
+		variantSetup.aggregator = &aggregator;
+		warm->fork.Schedule (Seconds (cfg.forkAt), warm->variants.size (), cfg.jobs,
+				MakeCallback (&VariantSetup::Apply, &variantSetup));
+	}
+
+	profiler.Mark ("apps");
+
+	sprintf(buffer, "Ending time! %f", cfg.endTime);
+	NS_LOG_INFO(buffer);
+
+	// Binary tracers, when they are used, live until the end of the run
+	BinaryTracers binaryTracers;
+
+	// If the variable is set, print the trace files
+	if (cfg.traceFiles) {
+		// Filename
+		std::string filename;
 
 /*		sprintf(filename, "%s/%s/%s/%.0f/clients", results, scenario, speed);
 
@@ -596,31 +1321,46 @@ int main (int argc, char *argv[])
 
 		serverFile.close();
 */
-		char mode[7];
-		if(fake) sprintf(mode, "fake");
-		else sprintf(mode, "normal");
-
 		NS_LOG_INFO ("Installing tracers");
-		// NDN Aggregate tracer
-		printf ("now I'm writing the files at %s/%s/%s/%.0f/\n", results, scenario, mode, speed);
-		sprintf (filename, "%s/%s/%s/%.0f/aggregate-trace", results, scenario, mode, speed);
-		inputFile = filename;
-		plotdata = "graphs/%s/%s/%s/aggregate-trace", results, scenario, mode);
-		ndn::L3AggregateTracer::InstallAll(filename, Seconds (1.0));
-		sprintf (filename, "%s/%s/%s/%.0f/MN-aggregate-trace", results, scenario, mode, speed);
-		ndn::L3AggregateTracer::Install(mobileTerminalContainer.Get(0), filename, Seconds (1.0));
-
-		// NDN L3 tracer
-		sprintf (filename, "%s/%s/%s/%.0f/rate-trace", results, scenario, mode, speed);
-		ndn::L3RateTracer::InstallAll (filename, Seconds (1.0));
-		sprintf (filename, "%s/%s/%s/%.0f/MN-rate-trace", results, scenario, mode, speed);
-		ndn::L3RateTracer::Install (mobileTerminalContainer.Get(0), filename, Seconds (1.0));
-
-		// NDN App Tracer
-		sprintf (filename, "%s/%s/%s/%.0f/app-delays", results, scenario, mode, speed);
-		ndn::AppDelayTracer::InstallAll (filename);
-		sprintf (filename, "%s/%s/%s/%.0f/MN-app-delays", results, scenario, mode, speed);
-		ndn::AppDelayTracer::Install (mobileTerminalContainer.Get(0), filename);
+		// Make sure the result directory exists, sweeps hand every run its own
+		printf ("now I'm writing the files at %s/\n", resultDir.c_str ());
+		SystemPath::MakeDirectories (resultDir);
+
+		// The MN- traces cover every mobile terminal, the Node column tells them apart
+		if (cfg.traceFormat == "binary")
+		{
+			// Binary column traces, icc-trace-reader turns them back into the text layout.
+			// The rate trace is computed by the reader from the aggregate counts
+			filename = resultDir + "/aggregate-trace.bin";
+			binaryTracers.InstallL3 (localNodes, filename, Seconds (1.0), cfg.traceCompress);
+			filename = resultDir + "/MN-aggregate-trace.bin";
+			binaryTracers.InstallL3 (localMobiles, filename, Seconds (1.0), cfg.traceCompress);
+
+			filename = resultDir + "/app-delays.bin";
+			binaryTracers.InstallAppDelay (localNodes, filename, cfg.traceCompress);
+			filename = resultDir + "/MN-app-delays.bin";
+			binaryTracers.InstallAppDelay (localMobiles, filename, cfg.traceCompress);
+		}
+		else
+		{
+			// NDN Aggregate tracer
+			filename = resultDir + "/aggregate-trace";
+			ndn::L3AggregateTracer::Install (localNodes, filename, Seconds (1.0));
+			filename = resultDir + "/MN-aggregate-trace";
+			ndn::L3AggregateTracer::Install(localMobiles, filename, Seconds (1.0));
+
+			// NDN L3 tracer
+			filename = resultDir + "/rate-trace";
+			ndn::L3RateTracer::Install (localNodes, filename, Seconds (1.0));
+			filename = resultDir + "/MN-rate-trace";
+			ndn::L3RateTracer::Install (localMobiles, filename, Seconds (1.0));
+
+			// NDN App Tracer
+			filename = resultDir + "/app-delays";
+			ndn::AppDelayTracer::Install (localNodes, filename);
+			filename = resultDir + "/MN-app-delays";
+			ndn::AppDelayTracer::Install (localMobiles, filename);
+		}
 
 		// L2 Drop rate tracer
 //		sprintf (filename, "%s/%s/%s/%.0f/drop-trace", results, scenario, mode, speed);
@@ -631,30 +1371,712 @@ int main (int argc, char *argv[])
 //		ndn::CsTracer::InstallAll (filename, Seconds (1));
 	}
 
+	profiler.Mark ("tracers");
+
 	NS_LOG_INFO ("------Scheduling events - SSID changes------");
 
-	// Schedule AP Changes
-	double apsec = 0.0;
-	// How often should the AP check it's distance
-	double checkTime = 10.0 / speed;
-	double j = apsec;
+	if (cfg.handoverMode == "event")
+	{
+		// Schedule AP changes for the moments the mobiles cross into the area of the next AP
+		sprintf(buffer, "Handover on boundary crossings, horizon %f", cfg.handoverHorizon);
+		NS_LOG_INFO(buffer);
+
+		handover.StartEventDriven (Seconds (cfg.handoverHorizon));
+	}
+	else if (cfg.handoverMode == "poll")
+	{
+		// How often should the AP check it's distance
+		double checkTime = 10.0 / cfg.speed;
+
+		sprintf(buffer, "Handover check every %f", checkTime);
+		NS_LOG_INFO(buffer);
+
+		handover.StartPolling (Seconds (checkTime));
+	}
+	else
+		NS_FATAL_ERROR ("Unknown handover mode " << cfg.handoverMode << ", use poll or event");
+
+	profiler.Mark ("handover");
+
+	NS_LOG_INFO ("------Ready for execution!------");
+
+	Simulator::Stop (Seconds (cfg.endTime));
+	Simulator::Run ();
+
+	// The variants wrote their own results
+	if (warm != 0 && !warm->fork.IsChild ())
+	{
+		Simulator::Destroy ();
+		return ScenarioMetrics ();
+	}
+
+	profiler.Mark ("run");
+
+	if (cfg.simStats > 0)
+	{
+		simStats.Stop ();
+
+		const SchedulerCounters &counters = CountingScheduler::GetCounters ();
+		sprintf(buffer, "Events executed: %lu, cancelled: %lu, left in the queue: %lu", (unsigned long) counters.GetExecuted (),
+				(unsigned long) counters.GetCancelled (), (unsigned long) counters.GetQueueSize ());
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.allocStats > 0)
+	{
+		allocStats.Stop ();
+
+		snprintf(buffer, sizeof (buffer), "Heap allocations: %.0f per simulated second, written to %s/allocs.tsv",
+				allocStats.GetRate (), resultDir.c_str ());
+		NS_LOG_INFO(buffer);
+
+		const PoolCounters &interests = RefPool<ndn::Interest>::GetCounters ();
+		const PoolCounters &datas = RefPool<ndn::Data>::GetCounters ();
+		sprintf(buffer, "Pooled interests: %lu reused, %lu created; pooled Data: %lu reused, %lu created",
+				(unsigned long) interests.reused, (unsigned long) (interests.created + interests.unpooled),
+				(unsigned long) datas.reused, (unsigned long) (datas.created + datas.unpooled));
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.capture)
+	{
+		capture.Close ();
+
+		snprintf(buffer, sizeof (buffer), "Captured %lu interests to %s/interests.tsv, %lu sent before their mobile had an AP left out",
+				(unsigned long) capture.GetWritten (), resultDir.c_str (), (unsigned long) capture.GetUnplaced ());
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.handoverPause)
+	{
+		const HandoverPauseCounters &pause = IccConsumerCbr::GetPauseCounters ();
+		sprintf(buffer, "Handover pauses: %lu, %.2f s in all, %lu outstanding interests held, %lu made up in the bursts",
+				(unsigned long) pause.pauses, pause.paused, (unsigned long) pause.held, (unsigned long) pause.missed);
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.retxWheel)
+	{
+		const TimerWheelCounters &wheel = TimerWheel<RetxPending>::GetCounters ();
+		const RetxWheelCounters &retx = IccConsumerCbr::GetRetxCounters ();
+		sprintf(buffer, "Retransmission wheel: %lu events for %lu interests, %lu timed out, %lu answered, %lu rearmed",
+				(unsigned long) wheel.events, (unsigned long) wheel.inserted, (unsigned long) retx.timeouts,
+				(unsigned long) retx.answered, (unsigned long) retx.rearmed);
+		NS_LOG_INFO(buffer);
+	}
+
+	binaryTracers.Close ();
+
+	sprintf(buffer, "Handovers applied: %lu of %lu checks", (unsigned long) handover.GetApplied (), (unsigned long) handover.GetChecked ());
+	NS_LOG_INFO(buffer);
+
+	const ClassMetrics &handoverMetrics = aggregator.GetClass (CLASS_MOBILE);
+	sprintf(buffer, "Within %.1f s of a handover: %lu Data, mean delay %f s, %lu retransmissions", cfg.handoverWindow,
+			(unsigned long) handoverMetrics.handoverDelay.GetCount (), handoverMetrics.handoverDelay.GetMean (),
+			(unsigned long) handoverMetrics.handoverRetransmissions);
+	NS_LOG_INFO(buffer);
+
+	if (cfg.prefetch)
+	{
+		prefetch.Stop ();
+
+		std::string filename;
+		SystemPath::MakeDirectories (resultDir);
+		filename = resultDir + "/prefetch.tsv";
+		prefetch.Write (filename);
 
-	while ( j < endTime)
+		snprintf(buffer, sizeof (buffer), "Prefetch requests: %lu, written to %s", (unsigned long) prefetch.GetPlans (),
+				filename.c_str ());
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.warm > 0)
+	{
+		warmer.Stop ();
+
+		std::string filename;
+		SystemPath::MakeDirectories (resultDir);
+		filename = resultDir + "/warming.tsv";
+		warmer.Write (filename);
+
+		snprintf(buffer, sizeof (buffer), "Warming: %lu segments pushed, %lu served, written to %s",
+				(unsigned long) warmer.GetPushed (), (unsigned long) warmer.GetHits (), filename.c_str ());
+		NS_LOG_INFO(buffer);
+	}
+
+	if (cfg.csStats > 0)
 	{
-		sprintf(buffer, "Running event at %f", j);
+		csMonitor.Stop ();
+
+		std::string filename;
+		filename = resultDir + "/cs-summary.tsv";
+		snprintf (buffer, sizeof (buffer), "%s store %s csSize %d speed %.0f seed %u run %u end %.0f", routeType, cfg.csStore.c_str (), cfg.csSize,
+				cfg.speed, cfg.seed, cfg.run, cfg.endTime);
+		csMonitor.WriteSummary (filename, buffer);
+
+		snprintf(buffer, sizeof (buffer), "Content Store samples written to %s/cs.tsv, summary to %s", resultDir.c_str (),
+				filename.c_str ());
 		NS_LOG_INFO(buffer);
+	}
 
-		for (int i = 0; i < mobile; i++)
+	if (batched != 0)
+	{
+		const BatchCounters &counters = batched->GetCounters ();
+		sprintf(buffer, "Wifi loss evaluations: %lu in %lu frames, %lu receivers drawn, %lu culled, %lu not listed",
+				(unsigned long) counters.evaluated, (unsigned long) counters.batches, (unsigned long) counters.drawn,
+				(unsigned long) counters.culled, (unsigned long) counters.unlisted);
+		NS_LOG_INFO(buffer);
+	}
+
+	// The check creates models and draws after the run, so it does not change it
+	if (cfg.lossCheck > 0)
+	{
+		std::string filename;
+		SystemPath::MakeDirectories (resultDir);
+		filename = resultDir + "/loss-check.tsv";
+
+		std::vector<LossCheckRow> rows = CheckBatchedLoss (filename, cfg.lossCheck, 16.0206);
+		double minP = 1;
+		for (uint32_t i = 0; i < rows.size (); i++)
+			minP = std::min (minP, rows[i].p);
+
+		snprintf(buffer, sizeof (buffer), "Loss check: smallest KS p-value %.4f over %lu distances and kernels, written to %s",
+				minP, (unsigned long) rows.size (), filename.c_str ());
+		NS_LOG_INFO(buffer);
+	}
+
+	if (culling != 0)
+	{
+		const CullingCounters &counters = culling->GetCounters ();
+		sprintf(buffer, "Wifi loss evaluations: %lu, %lu beyond %.0f m culled", (unsigned long) counters.evaluated,
+				(unsigned long) counters.culled, cfg.cullRange);
+		NS_LOG_INFO(buffer);
+
+		// The validation outcome has to be seen without logging on
+		if (cfg.cullValidate)
 		{
-			Simulator::Schedule (Seconds(j), &SetSSIDviaDistance, mobileNodeIds[i], mobileTerminalsMobility[i], apTerminalMobility);
+			std::string filename;
+			SystemPath::MakeDirectories (resultDir);
+			filename = resultDir + "/culling.txt";
+
+			std::ofstream os (filename.c_str ());
+			os << "range\t" << cfg.cullRange << "\n";
+			os << "evaluated\t" << counters.evaluated << "\n";
+			os << "culled\t" << counters.culled << "\n";
+			os << "missed\t" << counters.missed << "\n";
+			if (counters.missed)
+				os << "strongest_missed_dbm\t" << counters.strongestMissed << "\n";
+
+			snprintf(buffer, sizeof (buffer), "Culling validation: %lu culled receptions would have mattered, written to %s",
+					(unsigned long) counters.missed, filename.c_str ());
+			NS_LOG_INFO(buffer);
 		}
+	}
+
+	if (cfg.summary)
+	{
+		std::string filename;
+		SystemPath::MakeDirectories (resultDir);
+		filename = resultDir + "/summary.txt";
 
-		j += checkTime;
+		sprintf (buffer, "%s speed %.0f seed %u run %u end %.0f handovers %lu", routeType, cfg.speed, cfg.seed, cfg.run,
+				cfg.endTime, (unsigned long) handover.GetApplied ());
+		aggregator.Write (filename, buffer);
+
+		filename = resultDir + "/mobiles.tsv";
+		aggregator.WritePerNode (filename);
+
+		snprintf (buffer, sizeof (buffer), "Summary written to %s", filename.c_str ());
+		NS_LOG_INFO(buffer);
 	}
 
-	NS_LOG_INFO ("------Ready for execution!------");
+	const ClassMetrics &mobileMetrics = aggregator.GetClass (CLASS_MOBILE);
+	ScenarioMetrics metrics;
+	metrics.satisfied = mobileMetrics.fullDelay.GetCount ();
+	metrics.retransmissions = mobileMetrics.retransmissions;
+	metrics.delaySum = mobileMetrics.fullDelay.GetSum ();
+	metrics.hopSum = mobileMetrics.hopSum;
+	metrics.handovers = handover.GetApplied ();
+	metrics.handoverSatisfied = mobileMetrics.handoverDelay.GetCount ();
+	metrics.handoverRetransmissions = mobileMetrics.handoverRetransmissions;
+	metrics.handoverDelaySum = mobileMetrics.handoverDelay.GetSum ();
 
-	Simulator::Stop (Seconds (endTime));
-	Simulator::Run ();
 	Simulator::Destroy ();
+
+	profiler.Mark ("teardown");
+
+	if (cfg.profile)
+	{
+		std::string filename;
+		SystemPath::MakeDirectories (resultDir);
+		filename = resultDir + "/profile.tsv";
+
+		sprintf (buffer, "%s sectors %u aps %u mobile %u servers %u end %.0f", routeType, topo.GetNSectors (), topo.GetNAps (),
+				cfg.mobile, cfg.servers, cfg.endTime);
+		profiler.Write (filename, buffer);
+	}
+
+	return metrics;
+}
+
+// Runs cfg in a forked child process, which writes its metrics to the pipe
+// left in fd and exits. Returns the child's pid, or -1 if it did not start
+pid_t ForkScenario (const ScenarioConfig &cfg, const ScenarioCache &cache, int &fd)
+{
+	int fds[2];
+	if (pipe (fds) != 0)
+	{
+		perror ("pipe");
+		return -1;
+	}
+
+	pid_t pid = fork ();
+	if (pid == 0)
+	{
+		close (fds[0]);
+		ScenarioMetrics m = RunScenario (cfg, cache);
+		ssize_t n = write (fds[1], &m, sizeof (m));
+		_exit (n == sizeof (m) ? 0 : 1);
+	}
+
+	close (fds[1]);
+	if (pid < 0)
+	{
+		perror ("fork");
+		close (fds[0]);
+		return -1;
+	}
+
+	fd = fds[0];
+	return pid;
+}
+
+// Reads the metrics of a child that exited with status, and closes its pipe
+bool ReadScenario (int status, int fd, ScenarioMetrics &m)
+{
+	bool ok = WIFEXITED (status) && WEXITSTATUS (status) == 0 && read (fd, &m, sizeof (m)) == sizeof (m);
+	close (fd);
+	return ok;
+}
+
+// Runs cfg.runs replications of the scenario, cfg.jobs at a time, each in its own
+// forked process with consecutive run numbers. Mean delay, hop count and satisfied
+// Interests are aggregated as the replications come in. Once cfg.minRuns are in and
+// all three confidence intervals are narrower than cfg.ciWidth of their means, the
+// replications still running are stopped and no more are started
+int RunReplications (const ScenarioConfig &cfg)
+{
+	char buffer[250];
+
+	std::map<pid_t, std::pair<uint32_t, int> > children;     // pid -> (run, pipe)
+	RunningStat delay;
+	RunningStat hops;
+	RunningStat satisfied;
+	uint32_t started = 0;
+	bool done = false;
+
+	SystemPath::MakeDirectories (ResultDir (cfg));
+	std::string filename = ResultDir (cfg) + "/replications.txt";
+
+	std::ofstream table (filename.c_str ());
+	table << "Run\tSatisfied\tRetransmissions\tMeanDelay\tMeanHops\tHandovers\tHandoverDelay\tHandoverRetx" << std::endl;
+
+	// Replications read their own inputs, as a single run does
+	ScenarioCache cache;
+
+	while (!children.empty () || (!done && started < cfg.runs))
+	{
+		while (!done && started < cfg.runs && children.size () < cfg.jobs)
+		{
+			ScenarioConfig child = cfg;
+			child.run = cfg.run + started++;
+
+			// Trace files of different replications must not overwrite each other
+			if (cfg.runs > 1)
+			{
+				sprintf (buffer, "/run-%u", child.run);
+				child.results = cfg.results + buffer;
+			}
+
+			int fd;
+			pid_t pid = ForkScenario (child, cache, fd);
+			if (pid < 0)
+				return 1;
+
+			children[pid] = std::make_pair (child.run, fd);
+		}
+
+		int status;
+		pid_t pid = waitpid (-1, &status, 0);
+		if (pid < 0)
+			break;
+
+		std::map<pid_t, std::pair<uint32_t, int> >::iterator it = children.find (pid);
+		if (it == children.end ())
+			continue;
+
+		uint32_t run = it->second.first;
+		ScenarioMetrics m;
+		bool ok = ReadScenario (status, it->second.second, m);
+		children.erase (it);
+
+		// Replications stopped after the target was reached are not counted
+		if (!ok)
+		{
+			if (!done)
+			{
+				sprintf (buffer, "Replication with run %u failed", run);
+				NS_LOG_ERROR (buffer);
+			}
+			continue;
+		}
+
+		delay.Add (m.MeanDelay ());
+		hops.Add (m.MeanHops ());
+		satisfied.Add (m.satisfied);
+
+		table << run << "\t" << m.satisfied << "\t" << m.retransmissions << "\t" << m.MeanDelay ()
+				<< "\t" << m.MeanHops () << "\t" << m.handovers << "\t" << m.MeanHandoverDelay ()
+				<< "\t" << m.handoverRetransmissions << std::endl;
+
+		sprintf (buffer, "Run %u: delay %f +- %f, hops %f +- %f, satisfied %f +- %f", run,
+				delay.GetMean (), delay.GetHalfWidth (cfg.ciLevel),
+				hops.GetMean (), hops.GetHalfWidth (cfg.ciLevel),
+				satisfied.GetMean (), satisfied.GetHalfWidth (cfg.ciLevel));
+		NS_LOG_INFO (buffer);
+
+		if (!done && delay.GetN () >= cfg.minRuns && delay.IsNarrow (cfg.ciLevel, cfg.ciWidth) &&
+				hops.IsNarrow (cfg.ciLevel, cfg.ciWidth) && satisfied.IsNarrow (cfg.ciLevel, cfg.ciWidth))
+		{
+			done = true;
+			for (it = children.begin (); it != children.end (); ++it)
+				kill (it->first, SIGTERM);
+		}
+	}
+
+	table << "# " << delay.GetN () << " replications, " << cfg.ciLevel * 100 << "% confidence"
+			<< (done ? ", target width reached" : "") << std::endl;
+	table << "# MeanDelay\t" << delay.GetMean () << "\t+-\t" << delay.GetHalfWidth (cfg.ciLevel) << std::endl;
+	table << "# MeanHops\t" << hops.GetMean () << "\t+-\t" << hops.GetHalfWidth (cfg.ciLevel) << std::endl;
+	table << "# Satisfied\t" << satisfied.GetMean () << "\t+-\t" << satisfied.GetHalfWidth (cfg.ciLevel) << std::endl;
+
+	return delay.GetN () ? 0 : 1;
+}
+
+// The command line options, shared by main and the lines of a batch file
+void AddOptions (CommandLine &cmd, ScenarioConfig &cfg)
+{
+	cmd.AddValue ("sectors", "Number of wireless sectors", cfg.sectors);
+	cmd.AddValue ("aps", "Number of wireless access nodes in a sector", cfg.aps);
+	cmd.AddValue ("layout", "Layout of the generated access nodes: road (a line) or hex (a hexagonal grid)", cfg.layout);
+	cmd.AddValue ("spacing", "Distance between neighbouring generated access nodes (meters)", cfg.spacing);
+	cmd.AddValue ("topology", "Topology description file (see icc-topology.h), replaces sectors/aps/layout", cfg.topologyFile);
+	cmd.AddValue ("channels", "Number of Wifi channels the APs are spread over, stations follow their AP", cfg.channels);
+	cmd.AddValue ("channelPlan", "Channel assignment: sector (all APs of a sector share one) or ap (neighbouring APs differ)", cfg.channelPlan);
+	cmd.AddValue ("cullRange", "Skip the Wifi loss models for receivers further than this from the sender (meters, 0 is off)", cfg.cullRange);
+	cmd.AddValue ("cullValidate", "Evaluate culled receivers anyway and write culling.txt with the ones within reach", cfg.cullValidate);
+	cmd.AddValue ("lossBatch", "Evaluate the Wifi loss models for all receivers of a frame at once, with AVX2 where the CPU has it", cfg.lossBatch);
+	cmd.AddValue ("lossCheck", "Compare n samples per distance of the batched and the ns-3 loss models and write loss-check.tsv", cfg.lossCheck);
+	cmd.AddValue ("distributed", "Split the sectors over the MPI ranks, start with mpirun (needs ns-3 with MPI)", cfg.distributed);
+	cmd.AddValue ("prefetch", "Prefetch into the sector each mobile is about to enter instead of fake interests on every central node", cfg.prefetch);
+	cmd.AddValue ("prefetchLookahead", "Seconds ahead a mobile's next sector change is looked for", cfg.prefetchLookahead);
+	cmd.AddValue ("prefetchWindow", "Seconds of a mobile's Data prefetched for a sector change", cfg.prefetchWindow);
+	cmd.AddValue ("prefetchRate", "Prefetch interest rate relative to the mobile's", cfg.prefetchRate);
+	cmd.AddValue ("warm", "Segments pushed into the Content Store of a mobile's next AP ahead of the handover (0 is off)", cfg.warm);
+	cmd.AddValue ("warmLookahead", "Seconds ahead a mobile's next handover is looked for when warming", cfg.warmLookahead);
+	cmd.AddValue ("prefixPerMobile", "Every mobile terminal requests its own prefix /waseda/sato/mt<i>", cfg.prefixPerMobile);
+	cmd.AddValue ("mobile", "Number of mobile terminals in simulation", cfg.mobile);
+	cmd.AddValue ("servers", "Number of servers in the simulation", cfg.servers);
+	cmd.AddValue ("results", "Directory to place results", cfg.results);
+	cmd.AddValue ("start", "Starting second", cfg.sec);
+	cmd.AddValue ("fake", "Enable fake interest", cfg.fake);
+	cmd.AddValue ("trace", "Enable trace files", cfg.traceFiles);
+	cmd.AddValue ("smart", "Enable SmartFlooding forwarding", cfg.smart);
+	cmd.AddValue ("bestr", "Enable BestRoute forwarding", cfg.bestr);
+	cmd.AddValue ("csSize", "Number of Interests a Content Store can maintain", cfg.csSize);
+	cmd.AddValue ("csStore", "Content Store of the routers: lru (ndnSIM) or arena (compact, exact name lookups)", cfg.csStore);
+	cmd.AddValue ("csStats", "Simulated seconds between Content Store samples written to cs.tsv (0 is off)", cfg.csStats);
+	cmd.AddValue ("sharedPayload", "Have the producer answer with one shared payload buffer", cfg.sharedPayload);
+	cmd.AddValue ("pool", "Have the producer and the consumers reuse released Interest and Data packets", cfg.pool);
+	cmd.AddValue ("allocStats", "Simulated seconds between heap allocation counts written to allocs.tsv (0 is off)", cfg.allocStats);
+	cmd.AddValue ("walk", "Enable random walk at walking speed", cfg.walk);
+	cmd.AddValue ("speed", "Number of speed/hour of mobile terminals in the simulation", cfg.speed);
+	cmd.AddValue ("endTime", "How long the simulation will last (Seconds)", cfg.endTime);
+	cmd.AddValue ("mbps", "Data transmission rate for NDN App in MBps", cfg.MBps);
+	cmd.AddValue ("size", "Content size in MB (-1 is for no limit)", cfg.contentSize);
+	cmd.AddValue ("retx", "How frequent Interest retransmission timeouts should be checked in seconds", cfg.retxtime);
+	cmd.AddValue ("retxWheel", "Have the consumers keep retransmission timeouts in a timer wheel instead of checking every -retx seconds", cfg.retxWheel);
+	cmd.AddValue ("handoverPause", "Have the mobile consumers hold interests while their station is not associated, and send them in a burst once it is", cfg.handoverPause);
+	cmd.AddValue ("burstRate", "Rate of the burst after a reassociation, relative to the interest rate", cfg.burstRate);
+	cmd.AddValue ("handoverWindow", "Seconds after an AP change the Data of a mobile counts as post-handover", cfg.handoverWindow);
+	cmd.AddValue ("capture", "Write the interests the consumers send to interests.tsv, for icc-fw-bench", cfg.capture);
+	cmd.AddValue ("handover", "How AP changes are scheduled: poll (every 10/speed seconds) or event (on boundary crossings)", cfg.handoverMode);
+	cmd.AddValue ("horizon", "Longest time between AP checks of a moving node in event handover mode (Seconds)", cfg.handoverHorizon);
+	cmd.AddValue ("traceFile", "Directory containing Ns2 movement trace files (Usually created by Bonnmotion)", cfg.nsTDir);
+	cmd.AddValue ("waypoints", "Binary waypoint file made by icc-waypoint-convert, replaces the ns-2 trace", cfg.waypoints);
+	cmd.AddValue ("waypointWindow", "Seconds of binary waypoints scheduled at a time", cfg.waypointWindow);
+	cmd.AddValue ("trajectory", "Move mobile terminals along precomputed trajectories, without an event per waypoint", cfg.trajectory);
+	cmd.AddValue ("traceFormat", "Trace file format: text (ndnSIM tracers) or binary (see icc-trace-reader)", cfg.traceFormat);
+	cmd.AddValue ("traceCompress", "Compress binary trace files (needs ICC_TRACE_ZLIB)", cfg.traceCompress);
+	cmd.AddValue ("summary", "Write summary.txt with delay percentiles, counters and throughput per node class", cfg.summary);
+	cmd.AddValue ("profile", "Write profile.tsv with the wall time and memory of the setup phases and the run", cfg.profile);
+	cmd.AddValue ("simStats", "Simulated seconds between event rate reports written to simstats.tsv (0 is off)", cfg.simStats);
+	cmd.AddValue ("seed", "Seed for the ns-3 and scenario random number generators (default: RngSeed)", cfg.seed);
+	cmd.AddValue ("run", "Run number of the first replication (default: RngRun)", cfg.run);
+	cmd.AddValue ("runs", "Number of replications, each with the next run number", cfg.runs);
+	cmd.AddValue ("jobs", "Number of replications to run in parallel", cfg.jobs);
+	cmd.AddValue ("minRuns", "Replications to run before checking the confidence intervals", cfg.minRuns);
+	cmd.AddValue ("ciWidth", "Stop once all confidence interval half widths are within this fraction of the mean (0 runs them all)", cfg.ciWidth);
+	cmd.AddValue ("ciLevel", "Confidence level of the replication intervals", cfg.ciLevel);
+	cmd.AddValue ("batch", "File of configurations, one line of options each, run one after another in this process", cfg.batch);
+	cmd.AddValue ("variants", "File of variants, one line of -fake and -results options each, forked from one shared run", cfg.variants);
+	cmd.AddValue ("forkAt", "Simulated second the -variants are forked at, before the consumers start at 1", cfg.forkAt);
+}
+
+// Writes the mobile metrics of runs listed in a configuration file, with their
+// wall time when there is one. Returns how many of them failed
+uint32_t WriteRunTable (const std::string &path, const std::vector<uint32_t> &lineNumbers, const std::vector<std::string> &lineArgs,
+		const std::vector<ScenarioMetrics> &metrics, const std::vector<bool> &ok, const std::vector<double> &wall)
+{
+	std::ofstream table (path.c_str ());
+	table << "Line\tStatus\tSatisfied\tRetransmissions\tMeanDelay\tMeanHops\tHandovers\tHandoverDelay\tHandoverRetx" << (wall.empty () ? "" : "\tWall")
+			<< "\tOptions" << std::endl;
+
+	uint32_t failed = 0;
+	for (uint32_t k = 0; k < metrics.size (); k++)
+	{
+		const ScenarioMetrics &m = metrics[k];
+		table << lineNumbers[k] << "\t" << (ok[k] ? "ok" : "failed");
+		if (ok[k])
+			table << "\t" << m.satisfied << "\t" << m.retransmissions << "\t" << m.MeanDelay () << "\t" << m.MeanHops ()
+					<< "\t" << m.handovers << "\t" << m.MeanHandoverDelay () << "\t" << m.handoverRetransmissions;
+		else
+			table << "\t\t\t\t\t\t\t";
+		if (!wall.empty ())
+			table << "\t" << wall[k];
+		table << "\t" << lineArgs[k] << std::endl;
+		failed += !ok[k];
+	}
+	return failed;
+}
+
+// Reads a file of configurations, one line of scenario options each over
+// those of cfg. Empty lines and lines starting with # are skipped. A line
+// without -results of its own writes under results/<name>-<line>
+void ReadConfigFile (const ScenarioConfig &cfg, const std::string &path, const char *name,
+		std::vector<ScenarioConfig> &configs, std::vector<uint32_t> &lineNumbers, std::vector<std::string> &lineArgs)
+{
+	char buffer[250];
+
+	std::ifstream in (path.c_str ());
+	if (!in)
+		NS_FATAL_ERROR ("Cannot read " << path);
+
+	std::string line;
+	for (uint32_t number = 1; std::getline (in, line); number++)
+	{
+		std::istringstream tokens (line);
+		std::vector<std::string> args (1, "icc-scenario");
+		std::string token;
+		while (tokens >> token)
+			args.push_back (token);
+		if (args.size () == 1 || args[1][0] == '#')
+			continue;
+
+		ScenarioConfig run = cfg;
+		run.batch.clear ();
+		run.variants.clear ();
+
+		CommandLine cmd;
+		AddOptions (cmd, run);
+		std::vector<char *> argv;
+		for (uint32_t i = 0; i < args.size (); i++)
+			argv.push_back (&args[i][0]);
+		cmd.Parse (argv.size (), &argv[0]);
+
+		if (run.runs > 1 || run.distributed || !run.batch.empty () || !run.variants.empty ())
+			NS_FATAL_ERROR ("Line " << number << " of " << path << ": only single, local runs can be listed");
+
+		if (run.results == cfg.results)
+		{
+			snprintf (buffer, sizeof (buffer), "/%s-%u", name, number);
+			run.results = cfg.results + buffer;
+		}
+
+		configs.push_back (run);
+		lineNumbers.push_back (number);
+		lineArgs.push_back (line);
+	}
+}
+
+// Runs the configurations of cfg.batch, cfg.jobs at a time. Every line holds
+// scenario options over those of cfg, e.g. "-speed=20 -fake=1 -smart=1 -run=3".
+// The topology files and the ns-2 traces of -trajectory lines are read once,
+// up front, and every run is forked from this process: it finds them parsed, and starts
+// from a fresh simulator, node list and random stream numbering as a process
+// of its own would. Lines without -results of their own write under
+// results/batch-<line>, and batch.tsv in results gets a row per line
+int RunBatch (const ScenarioConfig &cfg)
+{
+	char buffer[250];
+
+	// The configurations, with the line they came from
+	std::vector<ScenarioConfig> configs;
+	std::vector<uint32_t> lineNumbers;
+	std::vector<std::string> lineArgs;
+	ReadConfigFile (cfg, cfg.batch, "batch", configs, lineNumbers, lineArgs);
+
+	ScenarioCache cache;
+	for (uint32_t i = 0; i < configs.size (); i++)
+		cache.Load (configs[i]);
+
+	sprintf (buffer, "Batch of %u runs, %u traces and %u topology files read", (uint32_t) configs.size (),
+			(uint32_t) cache.traces.size (), (uint32_t) cache.topologies.size ());
+	NS_LOG_INFO (buffer);
+
+	std::map<pid_t, std::pair<uint32_t, int> > children;     // pid -> (configuration, pipe)
+	std::vector<ScenarioMetrics> metrics (configs.size ());
+	std::vector<bool> ok (configs.size (), false);
+	std::vector<double> wall (configs.size (), 0);
+	uint32_t started = 0;
+
+	while (!children.empty () || started < configs.size ())
+	{
+		while (started < configs.size () && children.size () < cfg.jobs)
+		{
+			uint32_t k = started++;
+			TIMER_TYPE start;
+			TIMER_NOW (start);
+			wall[k] = TIMER_SECONDS (start);
+
+			int fd;
+			pid_t pid = ForkScenario (configs[k], cache, fd);
+			if (pid < 0)
+			{
+				wall[k] = 0;
+				continue;
+			}
+
+			children[pid] = std::make_pair (k, fd);
+		}
+
+		if (children.empty ())
+			break;
+
+		int status;
+		pid_t pid = waitpid (-1, &status, 0);
+		if (pid < 0)
+			break;
+
+		std::map<pid_t, std::pair<uint32_t, int> >::iterator it = children.find (pid);
+		if (it == children.end ())
+			continue;
+
+		uint32_t k = it->second.first;
+		ok[k] = ReadScenario (status, it->second.second, metrics[k]);
+		children.erase (it);
+
+		TIMER_TYPE end;
+		TIMER_NOW (end);
+		wall[k] = TIMER_SECONDS (end) - wall[k];
+
+		sprintf (buffer, "Batch line %u %s in %.1f s", lineNumbers[k], ok[k] ? "done" : "failed", wall[k]);
+		NS_LOG_INFO (buffer);
+	}
+
+	SystemPath::MakeDirectories (cfg.results);
+	return WriteRunTable (cfg.results + "/batch.tsv", lineNumbers, lineArgs, metrics, ok, wall) ? 1 : 0;
+}
+
+// Reads cfg.variants and runs them from one shared run, forked at cfg.forkAt.
+// Variants may only set -fake and -results, the shared run is the one without
+// fake interests. warmstart.tsv in results gets a row per variant
+int RunWarmStart (const ScenarioConfig &cfg)
+{
+	// The fake consumers start at 1 s, and files the shared run writes to would be
+	// shared by the variants
+	if (cfg.forkAt <= 0 || cfg.forkAt >= 1)
+		NS_FATAL_ERROR ("-forkAt must be within the first second, before the consumers start");
+	if (cfg.traceFiles || cfg.simStats > 0 || cfg.csStats > 0 || cfg.allocStats > 0 || cfg.capture || cfg.distributed || cfg.runs > 1)
+		NS_FATAL_ERROR ("-variants does not combine with -trace, -simStats, -csStats, -allocStats, -capture, -distributed or -runs");
+
+	WarmStartPlan warm;
+	std::vector<uint32_t> lineNumbers;
+	std::vector<std::string> lineArgs;
+	ReadConfigFile (cfg, cfg.variants, "variant", warm.variants, lineNumbers, lineArgs);
+
+	for (uint32_t k = 0; k < lineArgs.size (); k++)
+	{
+		std::istringstream tokens (lineArgs[k]);
+		std::string token;
+		while (tokens >> token)
+		{
+			std::string::size_type start = token.find_first_not_of ('-');
+			std::string option = start == std::string::npos ? token : token.substr (start);
+			if (option.compare (0, 5, "fake=") != 0 && option.compare (0, 8, "results=") != 0)
+				NS_FATAL_ERROR ("Line " << lineNumbers[k] << " of " << cfg.variants << ": variants only set -fake and -results");
+		}
+	}
+
+	ScenarioConfig shared = cfg;
+	shared.fake = false;
+	ScenarioMetrics m = RunScenario (shared, ScenarioCache (), &warm);
+
+	// A variant's child is done here
+	if (warm.fork.IsChild ())
+		_exit (warm.fork.Report (m) ? 0 : 1);
+
+	std::vector<ScenarioMetrics> metrics (warm.variants.size ());
+	std::vector<bool> ok (warm.variants.size ());
+	for (uint32_t k = 0; k < warm.variants.size (); k++)
+		ok[k] = warm.fork.GetResult (k, metrics[k]);
+
+	SystemPath::MakeDirectories (cfg.results);
+	return WriteRunTable (cfg.results + "/warmstart.tsv", lineNumbers, lineArgs, metrics, ok, std::vector<double> ()) ? 1 : 0;
+}
+
+int main (int argc, char *argv[])
+{
+	ScenarioConfig cfg;
+
+	CommandLine cmd;
+	AddOptions (cmd, cfg);
+	cmd.Parse (argc,argv);
+
+	// Anything not given on our command line comes from --RngSeed and --RngRun
+	if (cfg.seed == 0)
+		cfg.seed = RngSeedManager::GetSeed ();
+	if (cfg.run == 0)
+		cfg.run = RngSeedManager::GetRun ();
+	if (cfg.jobs == 0)
+		cfg.jobs = 1;
+
+	if (cfg.distributed)
+	{
+#ifdef NS3_MPI
+		// Start with mpirun, one process per rank
+		if (cfg.runs > 1)
+			NS_FATAL_ERROR ("-distributed runs a single replication");
+
+		GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+		MpiInterface::Enable (&argc, &argv);
+		RunScenario (cfg, ScenarioCache ());
+		MpiInterface::Disable ();
+		return 0;
+#else
+		NS_FATAL_ERROR ("-distributed needs ns-3 configured with --enable-mpi");
+#endif
+	}
+
+	if (!cfg.batch.empty ())
+		return RunBatch (cfg);
+
+	if (!cfg.variants.empty ())
+		return RunWarmStart (cfg);
+
+	if (cfg.runs > 1)
+		return RunReplications (cfg);
+
+	RunScenario (cfg, ScenarioCache ());
+	return 0;
 }
@@ -0,0 +1,277 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-simstats.h
+ *  Event rate and scheduler instrumentation for the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-simstats is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-simstats is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-simstats.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_SIMSTATS_H
+#define ICC_SIMSTATS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <sys/time.h>
+#include <typeinfo>
+
+#include <ns3-dev/ns3/core-module.h>
+
+namespace ns3 {
+
+// Where the events executed by the simulator come from, told apart by the
+// type of the event implementation, which names the object or function
+// the event calls
+enum EventSource
+{
+	SOURCE_WIFI,
+	SOURCE_NDN,
+	SOURCE_APP,
+	SOURCE_HANDOVER,
+	SOURCE_OTHER,
+	EVENT_SOURCES
+};
+
+static const char *const EVENT_SOURCE_NAMES[EVENT_SOURCES] = { "wifi", "ndn", "app", "handover", "other" };
+
+// What the counting scheduler has seen since the start of the process
+struct SchedulerCounters
+{
+	SchedulerCounters ()
+		: inserted (0), removed (0), skipped (0), cancelled (0)
+	{
+		memset (bySource, 0, sizeof (bySource));
+	}
+
+	uint64_t inserted;                            // Events scheduled
+	uint64_t removed;                             // Events taken off the queue to run
+	uint64_t skipped;                             // Of those, cancelled ones the simulator does not run
+	uint64_t cancelled;                           // Events taken out of the queue by Simulator::Remove
+	uint64_t bySource[EVENT_SOURCES];             // Events executed, by source
+
+	uint64_t GetExecuted () const
+	{
+		return removed - skipped;
+	}
+
+	// Events that never ran, Simulator::Cancel only flags them
+	uint64_t GetCancelled () const
+	{
+		return skipped + cancelled;
+	}
+
+	uint64_t GetQueueSize () const
+	{
+		return inserted - removed - cancelled;
+	}
+};
+
+// The default map scheduler with counters. The source of an event type is
+// worked out by name the first time it is seen, later events of the same
+// type cost a lookup by type_info address
+class CountingScheduler : public MapScheduler
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccCountingScheduler")
+			.SetParent<MapScheduler> ()
+			.AddConstructor<CountingScheduler> ();
+		return tid;
+	}
+
+	// Shared by the scheduler and whoever reads it, there is one simulator per process
+	static SchedulerCounters &GetCounters ()
+	{
+		static SchedulerCounters counters;
+		return counters;
+	}
+
+	// Have the simulator use a counting scheduler, events already scheduled move over
+	static void Install ()
+	{
+		ObjectFactory factory;
+		factory.SetTypeId (GetTypeId ());
+		Simulator::SetScheduler (factory);
+	}
+
+	CountingScheduler ()
+		: m_lastType (0), m_lastSource (SOURCE_OTHER)
+	{
+	}
+
+	virtual void Insert (const Event &ev)
+	{
+		GetCounters ().inserted++;
+		MapScheduler::Insert (ev);
+	}
+
+	virtual Event RemoveNext (void)
+	{
+		Event ev = MapScheduler::RemoveNext ();
+		SchedulerCounters &counters = GetCounters ();
+		counters.removed++;
+		if (ev.impl->IsCancelled ())
+			counters.skipped++;
+		else
+			counters.bySource[Classify (typeid (*ev.impl))]++;
+		return ev;
+	}
+
+	virtual void Remove (const Event &ev)
+	{
+		GetCounters ().cancelled++;
+		MapScheduler::Remove (ev);
+	}
+
+private:
+	EventSource Classify (const std::type_info &type)
+	{
+		if (&type == m_lastType)
+			return m_lastSource;
+
+		std::map<const std::type_info *, EventSource>::iterator it = m_sources.find (&type);
+		if (it == m_sources.end ())
+			it = m_sources.insert (std::make_pair (&type, ClassifyName (type.name ()))).first;
+
+		m_lastType = it->first;
+		m_lastSource = it->second;
+		return m_lastSource;
+	}
+
+	// Applications first, as they live in the ndn namespace as well
+	static EventSource ClassifyName (const char *mangled)
+	{
+		int status = 0;
+		char *demangled = abi::__cxa_demangle (mangled, 0, 0, &status);
+		std::string name (status == 0 && demangled ? demangled : mangled);
+		free (demangled);
+
+		if (name.find ("HandoverEngine") != std::string::npos || name.find ("MobileHandoverState") != std::string::npos)
+			return SOURCE_HANDOVER;
+		if (name.find ("Consumer") != std::string::npos || name.find ("Producer") != std::string::npos
+				|| name.find ("Prefetch") != std::string::npos || name.find ("ndn::App") != std::string::npos)
+			return SOURCE_APP;
+		if (name.find ("ndn::") != std::string::npos)
+			return SOURCE_NDN;
+		if (name.find ("Wifi") != std::string::npos || name.find ("Dca") != std::string::npos
+				|| name.find ("Dcf") != std::string::npos || name.find ("MacLow") != std::string::npos
+				|| name.find ("Interference") != std::string::npos)
+			return SOURCE_WIFI;
+		return SOURCE_OTHER;
+	}
+
+	std::map<const std::type_info *, EventSource> m_sources;
+	const std::type_info *m_lastType;
+	EventSource m_lastSource;
+};
+
+// Reports every interval of simulated time how fast the simulator runs:
+// events per wall second, simulated seconds per wall second, scheduler
+// queue size, cancelled events and events by source over the interval, as
+// tab separated rows. Cancelled events are not counted as executed
+class SimStatsReporter
+{
+public:
+	SimStatsReporter ()
+		: m_lastWall (0), m_startWall (0), m_lastSim (0)
+	{
+	}
+
+	// Call before anything is scheduled, the counting scheduler has to be in place first
+	void Start (const std::string &path, Time interval)
+	{
+		CountingScheduler::Install ();
+
+		m_interval = interval;
+		m_os.open (path.c_str ());
+		m_os << "sim_s\twall_s\tevents\tevents_per_s\tsim_per_wall\tqueue\tcancelled";
+		for (uint32_t i = 0; i < EVENT_SOURCES; i++)
+			m_os << "\t" << EVENT_SOURCE_NAMES[i];
+		m_os << "\n";
+
+		m_startWall = m_lastWall = WallNow ();
+		m_last = CountingScheduler::GetCounters ();
+		m_lastSim = Simulator::Now ().GetSeconds ();
+
+		Simulator::Schedule (m_interval, &SimStatsReporter::Report, this);
+	}
+
+	// Write the row of the last partial interval and a total row
+	void Stop ()
+	{
+		if (!m_os.is_open ())
+			return;
+
+		Report ();
+
+		const SchedulerCounters &now = CountingScheduler::GetCounters ();
+		double wall = WallNow () - m_startWall;
+		m_os << "# total\t" << wall << "\t" << now.GetExecuted () << "\t" << (wall > 0 ? now.GetExecuted () / wall : 0) << "\t"
+				<< (wall > 0 ? Simulator::Now ().GetSeconds () / wall : 0) << "\t" << now.GetQueueSize () << "\t"
+				<< now.GetCancelled ();
+		for (uint32_t i = 0; i < EVENT_SOURCES; i++)
+			m_os << "\t" << now.bySource[i];
+		m_os << "\n";
+
+		m_os.close ();
+	}
+
+private:
+	static double WallNow ()
+	{
+		struct timeval tv;
+		gettimeofday (&tv, NULL);
+		return tv.tv_sec + tv.tv_usec * 1e-6;
+	}
+
+	void Report ()
+	{
+		const SchedulerCounters &now = CountingScheduler::GetCounters ();
+		double wall = WallNow ();
+		double sim = Simulator::Now ().GetSeconds ();
+		double dWall = wall - m_lastWall;
+		uint64_t events = now.GetExecuted () - m_last.GetExecuted ();
+
+		m_os << sim << "\t" << wall - m_startWall << "\t" << events << "\t" << (dWall > 0 ? events / dWall : 0) << "\t"
+				<< (dWall > 0 ? (sim - m_lastSim) / dWall : 0) << "\t" << now.GetQueueSize () << "\t"
+				<< now.GetCancelled () - m_last.GetCancelled ();
+		for (uint32_t i = 0; i < EVENT_SOURCES; i++)
+			m_os << "\t" << now.bySource[i] - m_last.bySource[i];
+		m_os << "\n";
+
+		m_last = now;
+		m_lastWall = wall;
+		m_lastSim = sim;
+
+		if (!Simulator::IsFinished ())
+			m_next = Simulator::Schedule (m_interval, &SimStatsReporter::Report, this);
+	}
+
+	std::ofstream m_os;
+	Time m_interval;
+	EventId m_next;
+	SchedulerCounters m_last;                     // Counters at the last report
+	double m_lastWall;
+	double m_startWall;
+	double m_lastSim;
+};
+
+} // namespace ns3
+
+#endif // ICC_SIMSTATS_H
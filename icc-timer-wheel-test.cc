@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-timer-wheel-test.cc
+ *  Checks of the timer wheel against the ns-3 simulator
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-timer-wheel-test is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-timer-wheel-test is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-timer-wheel-test.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Every item has to come out exactly at the first tick at or after its
+// time, once, and the wheel must never schedule its event in the past.
+// Two runs:
+//  - idle: a consumer whose RTO jumps to 2560 ticks during a disconnection
+//    and drops back to 40 ticks after it, so short items go in long after
+//    the wheel last handled a slot
+//  - random: many items at random times from 0 to 400000 ticks, some
+//    inserted again from the callback
+// Built as a scratch program, exits with 1 when a run fails
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+
+#include "icc-timer-wheel.h"
+
+using namespace ns3;
+
+static const int64_t TICK_MS = 5;
+
+struct CheckItem
+{
+	int64_t due;                                  // Time steps
+	uint32_t id;
+};
+
+class WheelCheck
+{
+public:
+	WheelCheck ()
+		: m_step (MilliSeconds (TICK_MS).GetTimeStep ()), m_last (0), m_bad (0), m_next (0), m_reinsert (false)
+	{
+		m_wheel.SetTick (MilliSeconds (TICK_MS));
+		m_wheel.SetCallback (MakeCallback (&WheelCheck::Expire, this));
+	}
+
+	// Inserts an item rto ticks after each of ticks
+	void Plan (const std::vector<int64_t> &ticks, const std::vector<int64_t> &rtos)
+	{
+		m_ticks = ticks;
+		m_rtos = rtos;
+		Simulator::Schedule (TimeStep (m_ticks[0] * m_step), &WheelCheck::InsertPlanned, this);
+	}
+
+	// Inserts three random items every 37 to 86 ms until limit
+	void Random (Time limit)
+	{
+		m_limit = limit;
+		m_reinsert = true;
+		Simulator::Schedule (MilliSeconds (3), &WheelCheck::InsertRandom, this);
+	}
+
+	// Returns true when every item came out once at its tick
+	bool Report (const char *name) const
+	{
+		uint32_t missed = 0;
+		for (uint32_t i = 0; i < m_seen.size (); i++)
+			if (m_seen[i] != 1)
+				missed++;
+
+		bool ok = m_bad == 0 && missed == 0 && m_wheel.GetSize () == 0;
+		printf ("%s: %lu items, %lu at the wrong time or in the past, %u not expired once: %s\n", name, (unsigned long) m_seen.size (),
+				(unsigned long) m_bad, missed, ok ? "ok" : "FAILED");
+		return ok;
+	}
+
+private:
+	void Insert (int64_t due)
+	{
+		CheckItem item;
+		item.due = due;
+		item.id = m_seen.size ();
+		m_seen.push_back (0);
+		m_wheel.Insert (TimeStep (due), item);
+
+		// An event in the past trips the simulator's assert in debug builds,
+		// and runs out of order in optimized ones
+		if (m_wheel.GetNextEvent () < Simulator::Now ())
+		{
+			if (m_bad < 5)
+				printf ("  item %u inserted at %lld, wheel event at %lld\n", item.id, (long long) Simulator::Now ().GetTimeStep (),
+						(long long) m_wheel.GetNextEvent ().GetTimeStep ());
+			m_bad++;
+		}
+	}
+
+	void InsertPlanned ()
+	{
+		Insert (Simulator::Now ().GetTimeStep () + m_rtos[m_next] * m_step);
+		if (++m_next < m_ticks.size ())
+			Simulator::Schedule (TimeStep (m_ticks[m_next] * m_step) - Simulator::Now (), &WheelCheck::InsertPlanned, this);
+	}
+
+	void InsertRandom ()
+	{
+		int64_t now = Simulator::Now ().GetTimeStep ();
+		Insert (now + (int64_t) (rand () % 400000) * m_step + rand () % m_step);
+		Insert (now + (int64_t) (rand () % 3000) * m_step + rand () % m_step);
+		Insert (now + (int64_t) (rand () % 3000) * m_step + rand () % m_step);
+		if (Simulator::Now () < m_limit)
+			Simulator::Schedule (MilliSeconds (37 + rand () % 50), &WheelCheck::InsertRandom, this);
+	}
+
+	void Expire (CheckItem item)
+	{
+		int64_t now = Simulator::Now ().GetTimeStep ();
+		int64_t expected = (item.due + m_step - 1) / m_step * m_step;
+		if (now != expected || now < m_last)
+		{
+			if (m_bad < 5)
+				printf ("  item %u due %lld expired at %lld, expected %lld\n", item.id, (long long) item.due, (long long) now,
+						(long long) expected);
+			m_bad++;
+		}
+		m_last = now;
+		m_seen[item.id]++;
+
+		if (m_reinsert && rand () % 4 == 0)
+			Insert (now + (int64_t) (rand () % 2000) * m_step + rand () % m_step);
+	}
+
+	TimerWheel<CheckItem> m_wheel;
+	int64_t m_step;                               // Time steps per tick
+	int64_t m_last;                               // Last expiry
+	uint64_t m_bad;
+	std::vector<uint8_t> m_seen;                  // Expiries by item
+	std::vector<int64_t> m_ticks;
+	std::vector<int64_t> m_rtos;
+	uint32_t m_next;
+	Time m_limit;
+	bool m_reinsert;
+};
+
+int main (int argc, char *argv[])
+{
+	bool ok = true;
+
+	{
+		static const int64_t ticks[] = { 0, 10, 1218, 1230, 1250, 1300 };
+		static const int64_t rtos[] = { 40, 2560, 40, 40, 40, 40 };
+		WheelCheck check;
+		check.Plan (std::vector<int64_t> (ticks, ticks + 6), std::vector<int64_t> (rtos, rtos + 6));
+		Simulator::Run ();
+		ok = check.Report ("idle") && ok;
+		Simulator::Destroy ();
+	}
+
+	{
+		srand (1);
+		WheelCheck check;
+		check.Random (Seconds (3000));
+		Simulator::Run ();
+		ok = check.Report ("random") && ok;
+		Simulator::Destroy ();
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-timer-wheel.h
+ *  Hierarchical timer wheel driven by the ns-3 simulator
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-timer-wheel is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-timer-wheel is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-timer-wheel.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_TIMER_WHEEL_H
+#define ICC_TIMER_WHEEL_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+
+namespace ns3 {
+
+// Levels of the wheel, each of 2^ICC_WHEEL_BITS slots. A slot of level l
+// covers 2^(l ICC_WHEEL_BITS) ticks
+static const uint32_t ICC_WHEEL_BITS = 6;
+static const uint32_t ICC_WHEEL_SLOTS = 1 << ICC_WHEEL_BITS;
+static const uint32_t ICC_WHEEL_LEVELS = 3;
+
+// What the timer wheels of one item type have done since the start of the
+// process
+struct TimerWheelCounters
+{
+	TimerWheelCounters ()
+		: inserted (0), events (0), expired (0), cascaded (0)
+	{
+	}
+
+	uint64_t inserted;
+	uint64_t events;                              // Simulator events the wheel ran
+	uint64_t expired;                             // Items handed to the callback
+	uint64_t cascaded;                            // Items moved down a level
+};
+
+// Items to be handed to a callback at a given time, rounded up to whole
+// ticks. Items due within ICC_WHEEL_SLOTS ticks go into a slot per tick of
+// the first level; later ones go into the coarser slots of the higher levels
+// and move down as their slot comes up. Only one simulator event is
+// pending, for the next slot that expires or moves down, so nothing runs
+// while nothing is due and an event costs what it expires. Items cannot be
+// removed: an item that no longer matters is dropped by the callback
+template <typename Item>
+class TimerWheel
+{
+public:
+	TimerWheel ()
+		: m_tick (MilliSeconds (5)), m_current (0), m_size (0), m_eventTick (0)
+	{
+		std::fill (m_count, m_count + ICC_WHEEL_LEVELS, 0);
+	}
+
+	// Only while the wheel is empty
+	void SetTick (Time tick)
+	{
+		NS_ASSERT (m_size == 0);
+		m_tick = tick;
+	}
+
+	Time GetTick () const
+	{
+		return m_tick;
+	}
+
+	void SetCallback (Callback<void, Item> expire)
+	{
+		m_expire = expire;
+	}
+
+	// Hands item to the callback at the first tick at or after at
+	void Insert (Time at, const Item &item)
+	{
+		int64_t step = m_tick.GetTimeStep ();
+		uint64_t now = Simulator::Now ().GetTimeStep () / step;
+		// m_current only moves when an event runs. No slot is handled before
+		// the pending event, so after an idle stretch the wheel catches up to
+		// now without touching any slot, and the entry is placed after now
+		if (m_size == 0)
+			m_current = std::max (m_current, now);
+		else
+			m_current = std::max (m_current, std::min (now, m_eventTick - 1));
+
+		Entry entry;
+		entry.tick = std::max<uint64_t> ((at.GetTimeStep () + step - 1) / step, m_current + 1);
+		entry.item = item;
+		uint64_t due = Place (entry);
+		m_size++;
+		GetCounters ().inserted++;
+
+		if (!m_event.IsRunning () || due < m_eventTick)
+			Schedule (due);
+	}
+
+	uint32_t GetSize () const
+	{
+		return m_size;
+	}
+
+	// When the wheel next handles a slot, while it holds items
+	Time GetNextEvent () const
+	{
+		return TimeStep (m_eventTick * m_tick.GetTimeStep ());
+	}
+
+	static TimerWheelCounters &GetCounters ()
+	{
+		static TimerWheelCounters counters;
+		return counters;
+	}
+
+	// Drops every item
+	void Clear ()
+	{
+		Simulator::Cancel (m_event);
+		for (uint32_t l = 0; l < ICC_WHEEL_LEVELS; l++)
+		{
+			for (uint32_t s = 0; s < ICC_WHEEL_SLOTS; s++)
+				m_slots[l][s].clear ();
+			m_count[l] = 0;
+		}
+		m_size = 0;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t tick;                                // Due at
+		Item item;
+	};
+
+	// Puts entry into its slot, returns the tick that slot is handled at
+	uint64_t Place (const Entry &entry)
+	{
+		uint64_t delta = entry.tick - m_current;
+		uint32_t level = 0;
+		while (level + 1 < ICC_WHEEL_LEVELS && delta >= ((uint64_t) 1 << (ICC_WHEEL_BITS * (level + 1))))
+			level++;
+
+		uint32_t shift = ICC_WHEEL_BITS * level;
+		uint64_t block = entry.tick >> shift;
+		// Beyond the top level, wait for the furthest slot and move down from there
+		if (block > (m_current >> shift) + ICC_WHEEL_SLOTS)
+			block = (m_current >> shift) + ICC_WHEEL_SLOTS;
+
+		m_slots[level][block & (ICC_WHEEL_SLOTS - 1)].push_back (entry);
+		m_count[level]++;
+		return block << shift;
+	}
+
+	// Next tick a slot has to be handled at, expired or moved down
+	uint64_t NextTick () const
+	{
+		uint64_t next = std::numeric_limits<uint64_t>::max ();
+		for (uint32_t l = 0; l < ICC_WHEEL_LEVELS; l++)
+		{
+			if (m_count[l] == 0)
+				continue;
+
+			uint32_t shift = ICC_WHEEL_BITS * l;
+			uint64_t block = m_current >> shift;
+			for (uint32_t i = 1; i <= ICC_WHEEL_SLOTS; i++)
+			{
+				if (!m_slots[l][(block + i) & (ICC_WHEEL_SLOTS - 1)].empty ())
+				{
+					next = std::min (next, (block + i) << shift);
+					break;
+				}
+			}
+		}
+		return next;
+	}
+
+	void Schedule (uint64_t tick)
+	{
+		Simulator::Cancel (m_event);
+		m_eventTick = tick;
+		m_event = Simulator::Schedule (TimeStep (tick * m_tick.GetTimeStep ()) - Simulator::Now (), &TimerWheel::Fire, this);
+	}
+
+	void Fire ()
+	{
+		TimerWheelCounters &counters = GetCounters ();
+		counters.events++;
+		m_current = m_eventTick;
+
+		// Higher levels first, what comes down may be due right now
+		for (uint32_t l = ICC_WHEEL_LEVELS - 1; l > 0; l--)
+		{
+			uint32_t shift = ICC_WHEEL_BITS * l;
+			if (m_current & (((uint64_t) 1 << shift) - 1))
+				continue;
+
+			std::vector<Entry> moving;
+			moving.swap (m_slots[l][(m_current >> shift) & (ICC_WHEEL_SLOTS - 1)]);
+			m_count[l] -= moving.size ();
+			for (uint32_t i = 0; i < moving.size (); i++)
+				Place (moving[i]);
+			counters.cascaded += moving.size ();
+		}
+
+		std::vector<Entry> due;
+		due.swap (m_slots[0][m_current & (ICC_WHEEL_SLOTS - 1)]);
+		m_count[0] -= due.size ();
+		m_size -= due.size ();
+		counters.expired += due.size ();
+
+		// The callback may insert again, always after this tick
+		for (uint32_t i = 0; i < due.size (); i++)
+			m_expire (due[i].item);
+
+		if (m_size > 0)
+		{
+			uint64_t next = NextTick ();
+			if (!m_event.IsRunning () || next < m_eventTick)
+				Schedule (next);
+		}
+	}
+
+	Time m_tick;
+	Callback<void, Item> m_expire;
+	std::vector<Entry> m_slots[ICC_WHEEL_LEVELS][ICC_WHEEL_SLOTS];
+	uint32_t m_count[ICC_WHEEL_LEVELS];           // Entries on each level
+	uint64_t m_current;                           // Last tick handled
+	uint32_t m_size;
+	EventId m_event;                              // For the slot handled at m_eventTick
+	uint64_t m_eventTick;
+};
+
+} // namespace ns3
+
+#endif // ICC_TIMER_WHEEL_H
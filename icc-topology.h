@@ -0,0 +1,365 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-topology.h
+ *  Generated and file based layouts of the ICC scenario topology
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-topology is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-topology is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-topology.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_TOPOLOGY_H
+#define ICC_TOPOLOGY_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/mobility-module.h>
+#include <ns3-dev/ns3/network-module.h>
+#include <ns3-dev/ns3/point-to-point-module.h>
+
+namespace ns3 {
+
+// Distance of the central nodes and servers from the AP line in the
+// generated layouts, as in the original hand placed topology
+static const double ICC_CENTRAL_OFFSET = 50.0;
+static const double ICC_SERVER_OFFSET = 100.0;
+
+// Where the nodes of the ICC topology go. Every sector has one central
+// node wired to each of its APs, and the first server is wired to every
+// central node. APs are kept in sector order, so the APs of sector s are
+// [GetFirstAp (s), GetFirstAp (s+1))
+class IccTopology
+{
+public:
+	IccTopology ()
+	{
+	}
+
+	// APs every spacing meters along the x axis, sector after sector. With 2
+	// sectors of 2 APs 100m apart this is the original ICC topology
+	static IccTopology Road (uint32_t sectors, uint32_t aps, double spacing)
+	{
+		IccTopology topo;
+		topo.Reserve (sectors, aps);
+
+		for (uint32_t s = 0; s < sectors; s++)
+			for (uint32_t j = 0; j < aps; j++)
+				topo.AddAp (s, Vector ((s * aps + j) * spacing, 0.0, 0.0));
+
+		topo.PlaceMissing (ICC_CENTRAL_OFFSET, ICC_SERVER_OFFSET, 1);
+		return topo;
+	}
+
+	// APs on a hexagonal grid spacing meters apart, filled row by row into a
+	// roughly square area. Sectors take consecutive blocks of APs in row order
+	static IccTopology Hex (uint32_t sectors, uint32_t aps, double spacing)
+	{
+		IccTopology topo;
+		topo.Reserve (sectors, aps);
+
+		uint32_t n = sectors * aps;
+		uint32_t cols = std::max (1u, static_cast<uint32_t> (std::ceil (std::sqrt (static_cast<double> (n)))));
+		double rowHeight = spacing * std::sqrt (3.0) / 2;
+
+		for (uint32_t k = 0; k < n; k++)
+		{
+			uint32_t row = k / cols;
+			uint32_t col = k % cols;
+			topo.AddAp (k / aps, Vector ((col + 0.5 * (row & 1)) * spacing, row * rowHeight, 0.0));
+		}
+
+		topo.PlaceMissing (ICC_CENTRAL_OFFSET, ICC_SERVER_OFFSET, 1);
+		return topo;
+	}
+
+	// Reads a description file, one node per line, # starts a comment:
+	//   road <sectors> <aps> <spacing>     generated layouts, as above
+	//   hex <sectors> <aps> <spacing>
+	//   ap <sector> <x> <y>                single nodes, sectors counted from 0
+	//   central <sector> <x> <y>
+	//   server <x> <y>
+	// Layouts and single nodes can be mixed. Central nodes and servers that
+	// are not given are placed like in the generated layouts
+	static bool Read (const std::string &path, IccTopology &topo, std::string &error)
+	{
+		std::ifstream is (path.c_str ());
+		if (!is)
+		{
+			error = "cannot open " + path;
+			return false;
+		}
+
+		topo = IccTopology ();
+
+		std::string line;
+		uint32_t lineNo = 0;
+		while (std::getline (is, line))
+		{
+			lineNo++;
+			line = line.substr (0, line.find ('#'));
+
+			std::istringstream ls (line);
+			std::string kind;
+			if (!(ls >> kind))
+				continue;
+
+			bool ok = false;
+			if (kind == "road" || kind == "hex")
+			{
+				uint32_t sectors, aps;
+				double spacing;
+				if ((ok = static_cast<bool> (ls >> sectors >> aps >> spacing)))
+				{
+					IccTopology part = kind == "road" ? Road (sectors, aps, spacing) : Hex (sectors, aps, spacing);
+					topo.Append (part);
+				}
+			}
+			else if (kind == "ap" || kind == "central")
+			{
+				uint32_t sector;
+				double x, y;
+				if ((ok = static_cast<bool> (ls >> sector >> x >> y)))
+				{
+					if (kind == "ap")
+						topo.AddAp (sector, Vector (x, y, 0.0));
+					else
+						topo.SetCentral (sector, Vector (x, y, 0.0));
+				}
+			}
+			else if (kind == "server")
+			{
+				double x, y;
+				if ((ok = static_cast<bool> (ls >> x >> y)))
+					topo.m_servers.push_back (Vector (x, y, 0.0));
+			}
+
+			if (!ok)
+			{
+				std::ostringstream os;
+				os << path << ":" << lineNo << ": cannot parse '" << line << "'";
+				error = os.str ();
+				return false;
+			}
+		}
+
+		topo.Sort ();
+		topo.PlaceMissing (ICC_CENTRAL_OFFSET, ICC_SERVER_OFFSET, 1);
+
+		for (uint32_t s = 0; s < topo.GetNSectors (); s++)
+		{
+			if (topo.GetNAps (s) == 0)
+			{
+				std::ostringstream os;
+				os << path << ": sector " << s << " has no APs";
+				error = os.str ();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	uint32_t GetNSectors () const
+	{
+		return m_centrals.size ();
+	}
+
+	uint32_t GetNAps () const
+	{
+		return m_aps.size ();
+	}
+
+	uint32_t GetNAps (uint32_t sector) const
+	{
+		return GetFirstAp (sector + 1) - GetFirstAp (sector);
+	}
+
+	uint32_t GetFirstAp (uint32_t sector) const
+	{
+		return std::lower_bound (m_apSector.begin (), m_apSector.end (), sector) - m_apSector.begin ();
+	}
+
+	uint32_t GetSector (uint32_t ap) const
+	{
+		return m_apSector[ap];
+	}
+
+	const Vector &GetAp (uint32_t ap) const
+	{
+		return m_aps[ap];
+	}
+
+	const Vector &GetCentral (uint32_t sector) const
+	{
+		return m_centrals[sector];
+	}
+
+	// Servers beyond the ones placed share the position of the last one
+	Vector GetServer (uint32_t server) const
+	{
+		NS_ASSERT (!m_servers.empty ());
+		return m_servers[std::min<uint32_t> (server, m_servers.size () - 1)];
+	}
+
+	// Give the node positions to the containers. Sizes must match the topology
+	void InstallMobility (NodeContainer centrals, NodeContainer aps, NodeContainer servers) const
+	{
+		Ptr<ListPositionAllocator> centralPos = CreateObject<ListPositionAllocator> ();
+		for (uint32_t i = 0; i < m_centrals.size (); i++)
+			centralPos->Add (m_centrals[i]);
+
+		Ptr<ListPositionAllocator> apPos = CreateObject<ListPositionAllocator> ();
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+			apPos->Add (m_aps[i]);
+
+		Ptr<ListPositionAllocator> serverPos = CreateObject<ListPositionAllocator> ();
+		for (uint32_t i = 0; i < servers.GetN (); i++)
+			serverPos->Add (GetServer (i));
+
+		MobilityHelper fixed;
+		fixed.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+		fixed.SetPositionAllocator (centralPos);
+		fixed.Install (centrals);
+		fixed.SetPositionAllocator (apPos);
+		fixed.Install (aps);
+		fixed.SetPositionAllocator (serverPos);
+		fixed.Install (servers);
+	}
+
+	// Wire every AP to the central node of its sector and the server to every
+	// central node. Returns the AP links of each sector and the server links
+	void InstallLinks (PointToPointHelper &p2p, NodeContainer centrals, NodeContainer aps, Ptr<Node> server,
+			std::vector<NetDeviceContainer> &sectorLinks, NetDeviceContainer &serverLinks) const
+	{
+		sectorLinks.clear ();
+		sectorLinks.resize (GetNSectors ());
+
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+			sectorLinks[m_apSector[i]].Add (p2p.Install (centrals.Get (m_apSector[i]), aps.Get (i)));
+
+		for (uint32_t s = 0; s < GetNSectors (); s++)
+			serverLinks.Add (p2p.Install (server, centrals.Get (s)));
+	}
+
+private:
+	void Reserve (uint32_t sectors, uint32_t aps)
+	{
+		m_aps.reserve (m_aps.size () + sectors * aps);
+		m_apSector.reserve (m_apSector.size () + sectors * aps);
+		m_centrals.reserve (m_centrals.size () + sectors);
+		m_centralSet.reserve (m_centralSet.size () + sectors);
+	}
+
+	void AddAp (uint32_t sector, const Vector &pos)
+	{
+		m_aps.push_back (pos);
+		m_apSector.push_back (sector);
+		if (sector >= m_centrals.size ())
+		{
+			m_centrals.resize (sector + 1);
+			m_centralSet.resize (sector + 1, false);
+		}
+	}
+
+	void SetCentral (uint32_t sector, const Vector &pos)
+	{
+		if (sector >= m_centrals.size ())
+		{
+			m_centrals.resize (sector + 1);
+			m_centralSet.resize (sector + 1, false);
+		}
+		m_centrals[sector] = pos;
+		m_centralSet[sector] = true;
+	}
+
+	// A generated layout from a file goes into the sectors after the ones already known
+	void Append (const IccTopology &other)
+	{
+		uint32_t base = GetNSectors ();
+
+		for (uint32_t i = 0; i < other.m_aps.size (); i++)
+			AddAp (base + other.m_apSector[i], other.m_aps[i]);
+		for (uint32_t s = 0; s < other.GetNSectors (); s++)
+			SetCentral (base + s, other.m_centrals[s]);
+	}
+
+	// Stable sort of the APs into sector order, keeping the given order inside a sector
+	void Sort ()
+	{
+		std::vector<std::pair<uint32_t, uint32_t> > order;
+		order.reserve (m_aps.size ());
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+			order.push_back (std::make_pair (m_apSector[i], i));
+		std::sort (order.begin (), order.end ());
+
+		std::vector<Vector> aps;
+		aps.reserve (m_aps.size ());
+		for (uint32_t i = 0; i < order.size (); i++)
+		{
+			aps.push_back (m_aps[order[i].second]);
+			m_apSector[i] = order[i].first;
+		}
+		m_aps.swap (aps);
+	}
+
+	// Central nodes go below the middle of their APs, the server below the middle of all
+	void PlaceMissing (double centralOffset, double serverOffset, uint32_t servers)
+	{
+		std::vector<Vector> sum (GetNSectors ());
+		std::vector<uint32_t> count (GetNSectors (), 0);
+		Vector all;
+		double minY = 0;
+
+		for (uint32_t i = 0; i < m_aps.size (); i++)
+		{
+			Vector &s = sum[m_apSector[i]];
+			s.x += m_aps[i].x;
+			s.y += m_aps[i].y;
+			count[m_apSector[i]]++;
+			all.x += m_aps[i].x;
+			all.y += m_aps[i].y;
+			minY = i ? std::min (minY, m_aps[i].y) : m_aps[i].y;
+		}
+
+		for (uint32_t s = 0; s < GetNSectors (); s++)
+		{
+			if (!m_centralSet[s] && count[s] > 0)
+			{
+				m_centrals[s] = Vector (sum[s].x / count[s], minY - centralOffset, 0.0);
+				m_centralSet[s] = true;
+			}
+		}
+
+		if (m_servers.empty () && !m_aps.empty ())
+		{
+			for (uint32_t i = 0; i < servers; i++)
+				m_servers.push_back (Vector (all.x / m_aps.size (), minY - serverOffset, 0.0));
+		}
+	}
+
+	std::vector<Vector> m_aps;                    // AP positions, in sector order once built
+	std::vector<uint32_t> m_apSector;             // Sector of every AP
+	std::vector<Vector> m_centrals;               // Central node of every sector
+	std::vector<bool> m_centralSet;               // Central positions already decided
+	std::vector<Vector> m_servers;
+};
+
+} // namespace ns3
+
+#endif // ICC_TOPOLOGY_H
@@ -0,0 +1,611 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-trace-format.h
+ *  Binary, column oriented trace files for the ICC scenario
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-trace-format is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-trace-format is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-trace-format.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A trace file is a FileHeader followed by blocks. Every block is a
+// BlockHeader and rows stored column after column, each column fixed
+// width. Strings (node names, face descriptions) are dictionary encoded:
+// a DICT block introduces them before any block referring to them. With
+// ICC_TRACE_ZLIB defined, block payloads may be zlib compressed.
+//
+// L3 files hold the per period packet counts the L3 tracers print. Only
+// non zero counts are stored; FACES blocks record when a face was first
+// seen so the reader can put the zero rows back. APP files hold one row per
+// delay sample, as AppDelayTracer prints them.
+//
+// This header does not depend on ns-3 so the reader can be built on its own.
+
+#ifndef ICC_TRACE_FORMAT_H
+#define ICC_TRACE_FORMAT_H
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#ifdef ICC_TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace icctrace {
+
+static const char MAGIC[8] = { 'I', 'C', 'C', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t VERSION = 1;
+
+// FileHeader::flags
+static const uint32_t FLAG_COMPRESSED = 1;
+
+enum Content
+{
+	CONTENT_L3 = 1,
+	CONTENT_APP = 2
+};
+
+enum BlockKind
+{
+	BLOCK_DICT = 1,     // id, length, bytes
+	BLOCK_FACES = 2,    // time, node, faceId, descr
+	BLOCK_L3 = 3,       // time, node, faceId, type, packets, bytes
+	BLOCK_APP = 4,      // time, node, appId, seq, type, delay, retx, hops
+	BLOCK_END = 5       // time of the last period
+};
+
+// L3 counter types, in the order the L3 tracers print them
+enum L3Type
+{
+	IN_INTERESTS, OUT_INTERESTS, DROP_INTERESTS,
+	IN_NACKS, OUT_NACKS, DROP_NACKS,
+	IN_DATA, OUT_DATA, DROP_DATA,
+	SATISFIED_INTERESTS, TIMED_OUT_INTERESTS,
+	L3_TYPES
+};
+
+static const char *const L3_TYPE_NAMES[L3_TYPES] = {
+	"InInterests", "OutInterests", "DropInterests",
+	"InNacks", "OutNacks", "DropNacks",
+	"InData", "OutData", "DropData",
+	"SatisfiedInterests", "TimedOutInterests"
+};
+
+enum AppType
+{
+	LAST_DELAY, FULL_DELAY,
+	APP_TYPES
+};
+
+static const char *const APP_TYPE_NAMES[APP_TYPES] = { "LastDelay", "FullDelay" };
+
+// Face id of the per node row holding the totals
+static const int32_t FACE_ALL = -1;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t content;
+	uint32_t flags;
+	uint32_t reserved;
+	double period;      // Seconds between L3 rows
+};
+
+struct BlockHeader
+{
+	uint32_t kind;
+	uint32_t rows;
+	uint32_t rawSize;       // Payload size before compression
+	uint32_t storedSize;    // Payload size in the file
+};
+
+// Appends fixed width values to a byte buffer
+class ByteSink
+{
+public:
+	template <class T>
+	void PutColumn (const std::vector<T> &column)
+	{
+		if (!column.empty ())
+			Put (&column[0], column.size () * sizeof (T));
+	}
+
+	void Put (const void *data, size_t size)
+	{
+		const char *p = static_cast<const char *> (data);
+		m_bytes.insert (m_bytes.end (), p, p + size);
+	}
+
+	std::vector<char> m_bytes;
+};
+
+// Buffers rows in memory and writes them out in large column blocks
+class TraceWriter
+{
+public:
+	TraceWriter ()
+		: m_file (0), m_compress (false), m_blockRows (65536), m_faceRows (0)
+	{
+	}
+
+	~TraceWriter ()
+	{
+		Close (0);
+	}
+
+	bool Open (const std::string &path, Content content, double period, bool compress = false)
+	{
+#ifndef ICC_TRACE_ZLIB
+		compress = false;
+#endif
+		m_file = fopen (path.c_str (), "wb");
+		if (!m_file)
+			return false;
+
+		// Large stdio buffer, the blocks go out in few big writes
+		setvbuf (m_file, 0, _IOFBF, 1 << 20);
+
+		FileHeader header;
+		memset (&header, 0, sizeof (header));
+		memcpy (header.magic, MAGIC, sizeof (MAGIC));
+		header.version = VERSION;
+		header.content = content;
+		header.flags = compress ? FLAG_COMPRESSED : 0;
+		header.period = period;
+		fwrite (&header, sizeof (header), 1, m_file);
+
+		m_compress = compress;
+		return true;
+	}
+
+	bool IsOpen () const
+	{
+		return m_file != 0;
+	}
+
+	// Rows kept in memory before a block is written
+	void SetBlockRows (uint32_t rows)
+	{
+		m_blockRows = rows;
+	}
+
+	// Dictionary id of s
+	uint32_t Intern (const std::string &s)
+	{
+		std::map<std::string, uint32_t>::iterator it = m_dict.find (s);
+		if (it != m_dict.end ())
+			return it->second;
+
+		uint32_t id = m_dict.size ();
+		m_dict[s] = id;
+		m_newStrings.push_back (s);
+		return id;
+	}
+
+	void AddFace (double time, uint32_t node, int32_t faceId, uint32_t descr)
+	{
+		m_faces.time.push_back (time);
+		m_faces.node.push_back (node);
+		m_faces.face.push_back (faceId);
+		m_faces.descr.push_back (descr);
+		m_faceRows++;
+		CheckFlush ();
+	}
+
+	void AddL3 (double time, uint32_t node, int32_t faceId, uint8_t type, uint64_t packets, uint64_t bytes)
+	{
+		m_l3.time.push_back (time);
+		m_l3.node.push_back (node);
+		m_l3.face.push_back (faceId);
+		m_l3.type.push_back (type);
+		m_l3.packets.push_back (packets);
+		m_l3.bytes.push_back (bytes);
+		CheckFlush ();
+	}
+
+	void AddApp (double time, uint32_t node, uint32_t appId, uint32_t seq, uint8_t type,
+			double delay, uint32_t retx, int32_t hops)
+	{
+		m_app.time.push_back (time);
+		m_app.node.push_back (node);
+		m_app.appId.push_back (appId);
+		m_app.seq.push_back (seq);
+		m_app.type.push_back (type);
+		m_app.delay.push_back (delay);
+		m_app.retx.push_back (retx);
+		m_app.hops.push_back (hops);
+		CheckFlush ();
+	}
+
+	// Write everything still buffered, then the end marker
+	void Close (double endTime)
+	{
+		if (!m_file)
+			return;
+
+		Flush ();
+
+		ByteSink end;
+		end.Put (&endTime, sizeof (endTime));
+		WriteBlock (BLOCK_END, 1, end);
+
+		fclose (m_file);
+		m_file = 0;
+	}
+
+	void Flush ()
+	{
+		if (!m_file)
+			return;
+
+		// Strings and faces first, the rows after them refer to both
+		if (!m_newStrings.empty ())
+		{
+			ByteSink dict;
+			uint32_t first = m_dict.size () - m_newStrings.size ();
+			for (uint32_t i = 0; i < m_newStrings.size (); i++)
+			{
+				uint32_t id = first + i;
+				uint32_t len = m_newStrings[i].size ();
+				dict.Put (&id, sizeof (id));
+				dict.Put (&len, sizeof (len));
+				dict.Put (m_newStrings[i].data (), len);
+			}
+			WriteBlock (BLOCK_DICT, m_newStrings.size (), dict);
+			m_newStrings.clear ();
+		}
+
+		if (!m_faces.time.empty ())
+		{
+			ByteSink faces;
+			faces.PutColumn (m_faces.time);
+			faces.PutColumn (m_faces.node);
+			faces.PutColumn (m_faces.face);
+			faces.PutColumn (m_faces.descr);
+			WriteBlock (BLOCK_FACES, m_faces.time.size (), faces);
+			m_faces = FaceColumns ();
+			m_faceRows = 0;
+		}
+
+		if (!m_l3.time.empty ())
+		{
+			ByteSink l3;
+			l3.PutColumn (m_l3.time);
+			l3.PutColumn (m_l3.node);
+			l3.PutColumn (m_l3.face);
+			l3.PutColumn (m_l3.type);
+			l3.PutColumn (m_l3.packets);
+			l3.PutColumn (m_l3.bytes);
+			WriteBlock (BLOCK_L3, m_l3.time.size (), l3);
+			m_l3.Clear ();
+		}
+
+		if (!m_app.time.empty ())
+		{
+			ByteSink app;
+			app.PutColumn (m_app.time);
+			app.PutColumn (m_app.node);
+			app.PutColumn (m_app.appId);
+			app.PutColumn (m_app.seq);
+			app.PutColumn (m_app.type);
+			app.PutColumn (m_app.delay);
+			app.PutColumn (m_app.retx);
+			app.PutColumn (m_app.hops);
+			WriteBlock (BLOCK_APP, m_app.time.size (), app);
+			m_app.Clear ();
+		}
+	}
+
+private:
+	struct FaceColumns
+	{
+		std::vector<double> time;
+		std::vector<uint32_t> node;
+		std::vector<int32_t> face;
+		std::vector<uint32_t> descr;
+	};
+
+	struct L3Columns
+	{
+		// Cleared without giving the memory back, the next block reuses it
+		void Clear ()
+		{
+			time.clear (); node.clear (); face.clear (); type.clear (); packets.clear (); bytes.clear ();
+		}
+
+		std::vector<double> time;
+		std::vector<uint32_t> node;
+		std::vector<int32_t> face;
+		std::vector<uint8_t> type;
+		std::vector<uint64_t> packets;
+		std::vector<uint64_t> bytes;
+	};
+
+	struct AppColumns
+	{
+		void Clear ()
+		{
+			time.clear (); node.clear (); appId.clear (); seq.clear (); type.clear (); delay.clear (); retx.clear (); hops.clear ();
+		}
+
+		std::vector<double> time;
+		std::vector<uint32_t> node;
+		std::vector<uint32_t> appId;
+		std::vector<uint32_t> seq;
+		std::vector<uint8_t> type;
+		std::vector<double> delay;
+		std::vector<uint32_t> retx;
+		std::vector<int32_t> hops;
+	};
+
+	void CheckFlush ()
+	{
+		if (m_l3.time.size () >= m_blockRows || m_app.time.size () >= m_blockRows || m_faceRows >= m_blockRows)
+			Flush ();
+	}
+
+	void WriteBlock (uint32_t kind, uint32_t rows, const ByteSink &payload)
+	{
+		BlockHeader header;
+		header.kind = kind;
+		header.rows = rows;
+		header.rawSize = payload.m_bytes.size ();
+		header.storedSize = header.rawSize;
+
+		const char *data = payload.m_bytes.empty () ? "" : &payload.m_bytes[0];
+
+#ifdef ICC_TRACE_ZLIB
+		if (m_compress && header.rawSize > 0)
+		{
+			uLongf size = compressBound (header.rawSize);
+			m_compressed.resize (size);
+			if (compress2 (reinterpret_cast<Bytef *> (&m_compressed[0]), &size,
+					reinterpret_cast<const Bytef *> (data), header.rawSize, Z_BEST_SPEED) == Z_OK)
+			{
+				header.storedSize = size;
+				data = &m_compressed[0];
+			}
+		}
+#endif
+
+		fwrite (&header, sizeof (header), 1, m_file);
+		fwrite (data, 1, header.storedSize, m_file);
+	}
+
+	FILE *m_file;
+	bool m_compress;
+	uint32_t m_blockRows;
+	uint32_t m_faceRows;
+	std::map<std::string, uint32_t> m_dict;
+	std::vector<std::string> m_newStrings;
+	FaceColumns m_faces;
+	L3Columns m_l3;
+	AppColumns m_app;
+	std::vector<char> m_compressed;
+};
+
+// Reads a trace file block by block
+class TraceReader
+{
+public:
+	TraceReader ()
+		: m_file (0), m_fileSize (0)
+	{
+		memset (&m_header, 0, sizeof (m_header));
+		memset (&m_block, 0, sizeof (m_block));
+	}
+
+	~TraceReader ()
+	{
+		if (m_file)
+			fclose (m_file);
+	}
+
+	// Opens the file and checks its header, the error is left in GetError
+	bool Open (const std::string &path)
+	{
+		m_file = fopen (path.c_str (), "rb");
+		if (!m_file)
+		{
+			m_error = "cannot open " + path;
+			return false;
+		}
+
+		if (fread (&m_header, sizeof (m_header), 1, m_file) != 1 ||
+				memcmp (m_header.magic, MAGIC, sizeof (MAGIC)) != 0)
+		{
+			m_error = path + " is not an ICC trace file";
+			return false;
+		}
+
+		if (m_header.version != VERSION)
+		{
+			m_error = path + " has an unknown trace file version";
+			return false;
+		}
+
+#ifndef ICC_TRACE_ZLIB
+		if (m_header.flags & FLAG_COMPRESSED)
+		{
+			m_error = path + " is compressed, rebuild with ICC_TRACE_ZLIB";
+			return false;
+		}
+#endif
+
+		// Block sizes are checked against what is left of the file
+		long start = ftell (m_file);
+		if (fseek (m_file, 0, SEEK_END) != 0 || (m_fileSize = ftell (m_file)) < start || fseek (m_file, start, SEEK_SET) != 0)
+		{
+			m_error = "cannot seek in " + path;
+			return false;
+		}
+
+		return true;
+	}
+
+	const FileHeader &GetHeader () const
+	{
+		return m_header;
+	}
+
+	const std::string &GetError () const
+	{
+		return m_error;
+	}
+
+	// Reads the next block, false at the end of the file or on errors
+	bool Next ()
+	{
+		if (!m_error.empty () || fread (&m_block, sizeof (m_block), 1, m_file) != 1)
+			return false;
+
+		// zlib does not compress by more than about 1032 to 1, anything
+		// larger comes from a corrupt header and must not be allocated
+		long left = m_fileSize - ftell (m_file);
+		if (left < 0 || m_block.storedSize > static_cast<unsigned long> (left))
+		{
+			m_error = "block larger than the rest of the file";
+			return false;
+		}
+		if (m_block.rawSize != m_block.storedSize && m_block.rawSize / 1032 > m_block.storedSize)
+		{
+			m_error = "corrupt block sizes";
+			return false;
+		}
+
+		m_stored.resize (m_block.storedSize);
+		if (m_block.storedSize > 0 && fread (&m_stored[0], 1, m_block.storedSize, m_file) != m_block.storedSize)
+		{
+			m_error = "truncated block";
+			return false;
+		}
+
+		if (m_block.storedSize == m_block.rawSize)
+		{
+			m_payload.swap (m_stored);
+		}
+		else
+		{
+#ifdef ICC_TRACE_ZLIB
+			m_payload.resize (m_block.rawSize);
+			uLongf size = m_block.rawSize;
+			if (uncompress (reinterpret_cast<Bytef *> (&m_payload[0]), &size,
+					reinterpret_cast<const Bytef *> (&m_stored[0]), m_block.storedSize) != Z_OK || size != m_block.rawSize)
+			{
+				m_error = "corrupt compressed block";
+				return false;
+			}
+#else
+			m_error = "compressed block";
+			return false;
+#endif
+		}
+
+		m_offset = 0;
+
+		if (m_block.kind == BLOCK_DICT)
+			return ReadDictionary ();
+
+		return true;
+	}
+
+	uint32_t GetKind () const
+	{
+		return m_block.kind;
+	}
+
+	uint32_t GetRows () const
+	{
+		return m_block.rows;
+	}
+
+	// Copy the next column of the current block, rows values of type T.
+	// False, with the error set, when the block is too short to hold it
+	template <class T>
+	bool Column (std::vector<T> &column)
+	{
+		column.clear ();
+		size_t size = static_cast<size_t> (m_block.rows) * sizeof (T);
+		if (!m_error.empty ())
+			return false;
+		if (size > m_payload.size () - m_offset)
+		{
+			m_error = "block shorter than its columns";
+			return false;
+		}
+
+		column.resize (m_block.rows);
+		if (size > 0)
+			memcpy (&column[0], &m_payload[m_offset], size);
+		m_offset += size;
+		return true;
+	}
+
+	const std::string &Lookup (uint32_t id) const
+	{
+		static const std::string unknown ("?");
+		return id < m_dict.size () ? m_dict[id] : unknown;
+	}
+
+private:
+	// Ids are handed out in order, a block only adds the next rows of them
+	bool ReadDictionary ()
+	{
+		size_t pos = 0;
+		for (uint32_t i = 0; i < m_block.rows; i++)
+		{
+			uint32_t id;
+			uint32_t len;
+			if (m_payload.size () - pos < sizeof (id) + sizeof (len))
+			{
+				m_error = "truncated dictionary block";
+				return false;
+			}
+			memcpy (&id, &m_payload[pos], sizeof (id));
+			memcpy (&len, &m_payload[pos + sizeof (id)], sizeof (len));
+			pos += sizeof (id) + sizeof (len);
+
+			if (len > m_payload.size () - pos || id > m_dict.size () + m_block.rows)
+			{
+				m_error = "corrupt dictionary block";
+				return false;
+			}
+
+			if (id >= m_dict.size ())
+				m_dict.resize (id + 1);
+			m_dict[id].assign (len > 0 ? &m_payload[pos] : "", len);
+			pos += len;
+		}
+		return true;
+	}
+
+	FILE *m_file;
+	long m_fileSize;
+	FileHeader m_header;
+	BlockHeader m_block;
+	std::vector<char> m_stored;
+	std::vector<char> m_payload;
+	size_t m_offset;
+	std::vector<std::string> m_dict;
+	std::string m_error;
+};
+
+} // namespace icctrace
+
+#endif // ICC_TRACE_FORMAT_H
@@ -0,0 +1,278 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-trace-print.h
+ *  Prints binary ICC scenario traces in the ndnSIM text layout
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-trace-print is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-trace-print is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-trace-print.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Shared by icc-trace-reader and its round trip test. Like the header
+// format, does not depend on ns-3
+
+#ifndef ICC_TRACE_PRINT_H
+#define ICC_TRACE_PRINT_H
+
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "icc-trace-format.h"
+
+namespace icctrace {
+
+// Smoothing L3RateTracer applies to its rates
+static const double RATE_ALPHA = 0.8;
+
+struct FaceInfo
+{
+	uint32_t node;
+	int32_t faceId;
+	uint32_t descr;
+	double firstSeen;
+};
+
+struct Counter
+{
+	Counter ()
+		: packets (0), bytes (0)
+	{
+	}
+
+	double packets;
+	double bytes;
+};
+
+// Rebuilds the per period rows the text L3 tracers print, zero rows included
+class L3Printer
+{
+public:
+	L3Printer (TraceReader &reader, bool rate, std::ostream &os)
+		: m_reader (reader), m_rate (rate), m_os (os), m_period (reader.GetHeader ().period), m_tick (1)
+	{
+		if (m_rate)
+			m_os << "Time\tNode\tFaceId\tFaceDescr\tType\tPackets\tKilobytes\tPacketRaw\tKilobytesRaw\n";
+		else
+			m_os << "Time\tNode\tFaceId\tFaceDescr\tType\tPackets\tKilobytes\n";
+	}
+
+	void Faces ()
+	{
+		std::vector<double> time;
+		std::vector<uint32_t> node;
+		std::vector<int32_t> face;
+		std::vector<uint32_t> descr;
+		if (!m_reader.Column (time) || !m_reader.Column (node) || !m_reader.Column (face) || !m_reader.Column (descr))
+			return;
+
+		for (uint32_t i = 0; i < time.size (); i++)
+		{
+			if (m_nodeFaces.find (node[i]) == m_nodeFaces.end ())
+				m_nodeOrder.push_back (node[i]);
+
+			FaceInfo info = { node[i], face[i], descr[i], time[i] };
+			m_nodeFaces[node[i]].push_back (m_faces.size ());
+			m_faces.push_back (info);
+		}
+	}
+
+	void Rows ()
+	{
+		std::vector<double> time;
+		std::vector<uint32_t> node;
+		std::vector<int32_t> face;
+		std::vector<uint8_t> type;
+		std::vector<uint64_t> packets;
+		std::vector<uint64_t> bytes;
+		if (!m_reader.Column (time) || !m_reader.Column (node) || !m_reader.Column (face) || !m_reader.Column (type)
+				|| !m_reader.Column (packets) || !m_reader.Column (bytes))
+			return;
+
+		for (uint32_t i = 0; i < time.size (); i++)
+		{
+			PrintUntil (Tick (time[i]));
+
+			Counter &c = m_counts[Key (node[i], face[i], type[i])];
+			c.packets += packets[i];
+			c.bytes += bytes[i];
+		}
+	}
+
+	void End (double endTime)
+	{
+		PrintUntil (Tick (endTime) + 1);
+	}
+
+private:
+	typedef std::pair<std::pair<uint32_t, int32_t>, uint8_t> Key_t;
+
+	static Key_t Key (uint32_t node, int32_t face, uint8_t type)
+	{
+		return std::make_pair (std::make_pair (node, face), type);
+	}
+
+	int64_t Tick (double time) const
+	{
+		return static_cast<int64_t> (std::floor (time / m_period + 0.5));
+	}
+
+	// Print every period before tick. Like the tracers, a face gets the
+	// In/Out/Drop rows only, the node totals the PIT outcomes only, and
+	// come after the faces
+	void PrintUntil (int64_t tick)
+	{
+		for (; m_tick < tick; m_tick++)
+		{
+			double now = m_tick * m_period;
+
+			for (uint32_t n = 0; n < m_nodeOrder.size (); n++)
+			{
+				const std::vector<uint32_t> &faces = m_nodeFaces[m_nodeOrder[n]];
+				int32_t all = -1;
+
+				for (uint32_t f = 0; f < faces.size (); f++)
+				{
+					const FaceInfo &info = m_faces[faces[f]];
+					if (info.firstSeen > now + m_period * 1e-6)
+						continue;
+
+					if (info.faceId == FACE_ALL)
+					{
+						all = faces[f];
+						continue;
+					}
+
+					for (uint8_t type = 0; type < SATISFIED_INTERESTS; type++)
+						Print (now, info, type);
+				}
+
+				if (all >= 0)
+				{
+					Print (now, m_faces[all], SATISFIED_INTERESTS);
+					Print (now, m_faces[all], TIMED_OUT_INTERESTS);
+				}
+			}
+
+			m_counts.clear ();
+		}
+	}
+
+	void Print (double now, const FaceInfo &info, uint8_t type)
+	{
+		Key_t key = Key (info.node, info.faceId, type);
+		Counter raw;
+		std::map<Key_t, Counter>::iterator it = m_counts.find (key);
+		if (it != m_counts.end ())
+			raw = it->second;
+
+		m_os << now << "\t" << m_reader.Lookup (info.node) << "\t" << info.faceId << "\t"
+				<< m_reader.Lookup (info.descr) << "\t" << L3_TYPE_NAMES[type] << "\t";
+
+		if (m_rate)
+		{
+			Counter &smooth = m_smooth[key];
+			smooth.packets = RATE_ALPHA * smooth.packets + (1 - RATE_ALPHA) * raw.packets / m_period;
+			smooth.bytes = RATE_ALPHA * smooth.bytes + (1 - RATE_ALPHA) * raw.bytes / m_period;
+
+			m_os << smooth.packets << "\t" << smooth.bytes / 1024.0 << "\t"
+					<< raw.packets << "\t" << raw.bytes / 1024.0 << "\n";
+		}
+		else
+		{
+			m_os << raw.packets << "\t" << raw.bytes / 1024.0 << "\n";
+		}
+	}
+
+	TraceReader &m_reader;
+	bool m_rate;
+	std::ostream &m_os;
+	double m_period;
+	int64_t m_tick;                                   // Next period to print
+	std::vector<FaceInfo> m_faces;
+	std::vector<uint32_t> m_nodeOrder;
+	std::map<uint32_t, std::vector<uint32_t> > m_nodeFaces;
+	std::map<Key_t, Counter> m_counts;                // Counts of the period being read
+	std::map<Key_t, Counter> m_smooth;                // Smoothed rates
+};
+
+inline void PrintApp (TraceReader &reader, std::ostream &os)
+{
+	std::vector<double> time;
+	std::vector<uint32_t> node;
+	std::vector<uint32_t> appId;
+	std::vector<uint32_t> seq;
+	std::vector<uint8_t> type;
+	std::vector<double> delay;
+	std::vector<uint32_t> retx;
+	std::vector<int32_t> hops;
+	if (!reader.Column (time) || !reader.Column (node) || !reader.Column (appId) || !reader.Column (seq)
+			|| !reader.Column (type) || !reader.Column (delay) || !reader.Column (retx) || !reader.Column (hops))
+		return;
+
+	for (uint32_t i = 0; i < time.size (); i++)
+	{
+		os << time[i] << "\t" << reader.Lookup (node[i]) << "\t" << appId[i] << "\t" << seq[i] << "\t"
+				<< APP_TYPE_NAMES[type[i] < APP_TYPES ? type[i] : 0] << "\t" << delay[i] << "\t"
+				<< delay[i] * 1e6 << "\t" << retx[i] << "\t" << hops[i] << "\n";
+	}
+}
+
+// Prints every block of an opened reader to os. Returns whether the end
+// marker was read; errors are left in the reader
+inline bool PrintTrace (TraceReader &reader, bool rate, std::ostream &os)
+{
+	L3Printer *l3 = 0;
+	if (reader.GetHeader ().content == CONTENT_L3)
+		l3 = new L3Printer (reader, rate, os);
+	else
+		os << "Time\tNode\tAppId\tSeqNo\tType\tDelayS\tDelayUS\tRetxCount\tHopCount\n";
+
+	bool ended = false;
+	while (reader.Next ())
+	{
+		switch (reader.GetKind ())
+		{
+		case BLOCK_FACES:
+			if (l3)
+				l3->Faces ();
+			break;
+		case BLOCK_L3:
+			if (l3)
+				l3->Rows ();
+			break;
+		case BLOCK_APP:
+			PrintApp (reader, os);
+			break;
+		case BLOCK_END:
+		{
+			std::vector<double> end;
+			if (!reader.Column (end) || end.empty ())
+				break;
+			if (l3)
+				l3->End (end[0]);
+			ended = true;
+			break;
+		}
+		}
+	}
+
+	delete l3;
+	return ended;
+}
+
+} // namespace icctrace
+
+#endif // ICC_TRACE_PRINT_H
@@ -0,0 +1,179 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-trace-reader-test.cc
+ *  Round trip checks of the binary traces against the ndnSIM text layout
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-trace-reader-test is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-trace-reader-test is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-trace-reader-test.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Three checks:
+//  - aggregate: the rows BinaryL3Tracer writes for a node with two faces
+//    print exactly as L3AggregateTracer prints the same counts, PIT
+//    outcomes only on the node totals
+//  - app: delay samples print as AppDelayTracer prints them
+//  - corrupt: a block claiming more bytes than the file holds is an error,
+//    not an allocation
+// Does not need ns-3, build with
+//   g++ -O2 -o icc-trace-reader-test icc-trace-reader-test.cc
+// exits with 1 when a check fails
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "icc-trace-print.h"
+
+using namespace icctrace;
+
+static const char *TRACE = "icc-trace-reader-test.bin";
+
+// L3AggregateTracer of ndnSIM with a 1 s period, for a node n0 whose
+// dev[0]=net(0,0-1) face takes 2 interests of 256 bytes each and sends back
+// 2 Data of 1024 bytes in the first second, both satisfying their PIT
+// entries; the local face comes up at 1.5 s and sends one 256 byte interest
+static const char *AGGREGATE =
+	"Time\tNode\tFaceId\tFaceDescr\tType\tPackets\tKilobytes\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tInInterests\t2\t0.5\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tOutInterests\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tDropInterests\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tInNacks\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tOutNacks\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tDropNacks\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tInData\t0\t0\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tOutData\t2\t2\n"
+	"1\tn0\t256\tdev[0]=net(0,0-1)\tDropData\t0\t0\n"
+	"1\tn0\t-1\tall\tSatisfiedInterests\t2\t0\n"
+	"1\tn0\t-1\tall\tTimedOutInterests\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tInInterests\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tOutInterests\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tDropInterests\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tInNacks\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tOutNacks\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tDropNacks\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tInData\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tOutData\t0\t0\n"
+	"2\tn0\t256\tdev[0]=net(0,0-1)\tDropData\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tInInterests\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tOutInterests\t1\t0.25\n"
+	"2\tn0\t257\tdev=local(1)\tDropInterests\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tInNacks\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tOutNacks\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tDropNacks\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tInData\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tOutData\t0\t0\n"
+	"2\tn0\t257\tdev=local(1)\tDropData\t0\t0\n"
+	"2\tn0\t-1\tall\tSatisfiedInterests\t0\t0\n"
+	"2\tn0\t-1\tall\tTimedOutInterests\t0\t0\n";
+
+// AppDelayTracer for two samples of the consumer on n3
+static const char *APP =
+	"Time\tNode\tAppId\tSeqNo\tType\tDelayS\tDelayUS\tRetxCount\tHopCount\n"
+	"0.5\tn3\t0\t7\tLastDelay\t0.25\t250000\t1\t2\n"
+	"0.5\tn3\t0\t7\tFullDelay\t0.5\t500000\t2\t2\n";
+
+// Prints TRACE and compares it with expected, the first differing line is shown
+static bool Check (const char *name, const std::string &expected)
+{
+	TraceReader reader;
+	std::ostringstream os;
+	bool ended = reader.Open (TRACE) && PrintTrace (reader, false, os);
+
+	bool ok = ended && reader.GetError ().empty () && os.str () == expected;
+	if (!ok)
+	{
+		std::istringstream got (os.str ()), want (expected);
+		std::string a, b;
+		uint32_t line = 1;
+		while (std::getline (got, a) && std::getline (want, b) && a == b)
+			line++;
+		printf ("  line %u: got \"%s\", expected \"%s\"%s%s\n", line, a.c_str (), b.c_str (),
+				ended ? "" : ", no end marker ", reader.GetError ().c_str ());
+	}
+	printf ("%s: %s\n", name, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static bool Aggregate ()
+{
+	TraceWriter writer;
+	writer.Open (TRACE, CONTENT_L3, 1.0);
+	uint32_t node = writer.Intern ("n0");
+
+	// What BinaryL3Tracer writes: faces when first counted, PIT outcomes for
+	// the node and for the face the interests came in on, only non zero counts
+	writer.AddFace (0.2, node, 256, writer.Intern ("dev[0]=net(0,0-1)"));
+	writer.AddFace (0.7, node, FACE_ALL, writer.Intern ("all"));
+	writer.AddL3 (1.0, node, 256, IN_INTERESTS, 2, 512);
+	writer.AddL3 (1.0, node, 256, OUT_DATA, 2, 2048);
+	writer.AddL3 (1.0, node, 256, SATISFIED_INTERESTS, 2, 0);
+	writer.AddL3 (1.0, node, FACE_ALL, SATISFIED_INTERESTS, 2, 0);
+
+	writer.AddFace (1.5, node, 257, writer.Intern ("dev=local(1)"));
+	writer.AddL3 (2.0, node, 257, OUT_INTERESTS, 1, 256);
+	writer.Close (2.0);
+
+	return Check ("aggregate", AGGREGATE);
+}
+
+static bool App ()
+{
+	TraceWriter writer;
+	writer.Open (TRACE, CONTENT_APP, 1.0);
+	uint32_t node = writer.Intern ("n3");
+	writer.AddApp (0.5, node, 0, 7, LAST_DELAY, 0.25, 1, 2);
+	writer.AddApp (0.5, node, 0, 7, FULL_DELAY, 0.5, 2, 2);
+	writer.Close (1.0);
+
+	return Check ("app", APP);
+}
+
+static bool Corrupt ()
+{
+	TraceWriter writer;
+	writer.Open (TRACE, CONTENT_L3, 1.0);
+	writer.Close (1.0);
+
+	// The end block claims 2^31 stored bytes
+	FILE *file = fopen (TRACE, "r+b");
+	uint32_t huge = 1u << 31;
+	bool ok = false;
+	if (file && fseek (file, sizeof (FileHeader) + 2 * sizeof (uint32_t), SEEK_SET) == 0)
+	{
+		fwrite (&huge, sizeof (huge), 1, file);
+		fwrite (&huge, sizeof (huge), 1, file);
+		fclose (file);
+
+		TraceReader reader;
+		std::ostringstream os;
+		ok = reader.Open (TRACE) && !PrintTrace (reader, false, os) && !reader.GetError ().empty ();
+	}
+	else if (file)
+	{
+		fclose (file);
+	}
+
+	printf ("corrupt: %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	bool ok = true;
+	ok = Aggregate () && ok;
+	ok = App () && ok;
+	ok = Corrupt () && ok;
+	remove (TRACE);
+	return ok ? 0 : 1;
+}
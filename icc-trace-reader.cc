@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-trace-reader.cc
+ *  Converts binary ICC scenario traces back to the ndnSIM text layout
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-trace-reader is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-trace-reader is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-trace-reader.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: icc-trace-reader [-rate] <trace.bin>
+//
+// L3 traces (aggregate-trace.bin) are printed like L3AggregateTracer, or
+// like L3RateTracer with -rate. App traces (app-delays.bin) are printed
+// like AppDelayTracer. Does not need ns-3, build with
+//   g++ -O2 -o icc-trace-reader icc-trace-reader.cc [-DICC_TRACE_ZLIB -lz]
+
+#include <iostream>
+#include <string>
+
+#include "icc-trace-print.h"
+
+using namespace icctrace;
+
+int main (int argc, char *argv[])
+{
+	bool rate = false;
+	const char *path = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg (argv[i]);
+		if (arg == "-rate" || arg == "--rate")
+			rate = true;
+		else
+			path = argv[i];
+	}
+
+	if (!path)
+	{
+		std::cerr << "Usage: " << argv[0] << " [-rate] <trace.bin>" << std::endl;
+		return 2;
+	}
+
+	TraceReader reader;
+	if (!reader.Open (path))
+	{
+		std::cerr << reader.GetError () << std::endl;
+		return 1;
+	}
+
+	bool ended = PrintTrace (reader, rate, std::cout);
+
+	if (!reader.GetError ().empty ())
+	{
+		std::cerr << path << ": " << reader.GetError () << std::endl;
+		return 1;
+	}
+
+	if (!ended)
+		std::cerr << path << ": no end marker, the run did not finish" << std::endl;
+
+	return 0;
+}
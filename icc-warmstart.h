@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-warmstart.h
+ *  Forking a running simulation into variants that share its start
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-warmstart is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-warmstart is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-warmstart.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_WARMSTART_H
+#define ICC_WARMSTART_H
+
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ns3-dev/ns3/core-module.h>
+
+namespace ns3 {
+
+// Runs of several variants that only differ from some simulated time on
+// can share everything before it. The shared part is simulated once, and
+// at that time the process forks a child per variant, at most jobs at a
+// time. The apply callback turns the child into its variant before the
+// simulation carries on there, with the simulator, the random streams and
+// every model exactly as they were at the fork. Each child reports a Result
+// back through a pipe and exits, the parent stops its own simulation once
+// all children are done.
+//
+// Nothing may hold files open for writing across the fork, as the children
+// would share them
+template <typename Result>
+class WarmStart
+{
+public:
+	WarmStart ()
+		: m_variants (0), m_jobs (1), m_variant (-1), m_fd (-1), m_forked (false)
+	{
+	}
+
+	void Schedule (Time at, uint32_t variants, uint32_t jobs, Callback<void, uint32_t> apply)
+	{
+		m_variants = variants;
+		m_jobs = jobs > 0 ? jobs : 1;
+		m_apply = apply;
+		m_results.assign (variants, Result ());
+		m_ok.assign (variants, false);
+		Simulator::Schedule (at, &WarmStart::Fork, this);
+	}
+
+	// In a child, the variant it runs
+	bool IsChild () const
+	{
+		return m_variant >= 0;
+	}
+
+	uint32_t GetVariant () const
+	{
+		return m_variant;
+	}
+
+	// In the parent, whether the children have run
+	bool HasForked () const
+	{
+		return m_forked;
+	}
+
+	// Sends the result of a child to the parent
+	bool Report (const Result &result)
+	{
+		return write (m_fd, &result, sizeof (result)) == sizeof (result);
+	}
+
+	// What a variant reported, false if its child failed
+	bool GetResult (uint32_t variant, Result &result) const
+	{
+		result = m_results[variant];
+		return m_ok[variant];
+	}
+
+private:
+	void Fork ()
+	{
+		// Whatever is buffered would be written by every child again
+		fflush (0);
+
+		std::map<pid_t, std::pair<uint32_t, int> > children;     // pid -> (variant, pipe)
+		uint32_t started = 0;
+
+		while (!children.empty () || started < m_variants)
+		{
+			while (started < m_variants && children.size () < m_jobs)
+			{
+				uint32_t variant = started++;
+
+				int fds[2];
+				if (pipe (fds) != 0)
+				{
+					perror ("pipe");
+					continue;
+				}
+
+				pid_t pid = fork ();
+				if (pid == 0)
+				{
+					close (fds[0]);
+					std::map<pid_t, std::pair<uint32_t, int> >::iterator it;
+					for (it = children.begin (); it != children.end (); ++it)
+						close (it->second.second);
+
+					m_variant = variant;
+					m_fd = fds[1];
+					m_apply (variant);
+					return;
+				}
+
+				close (fds[1]);
+				if (pid < 0)
+				{
+					perror ("fork");
+					close (fds[0]);
+					continue;
+				}
+
+				children[pid] = std::make_pair (variant, fds[0]);
+			}
+
+			if (children.empty ())
+				break;
+
+			int status;
+			pid_t pid = waitpid (-1, &status, 0);
+			if (pid < 0)
+				break;
+
+			std::map<pid_t, std::pair<uint32_t, int> >::iterator it = children.find (pid);
+			if (it == children.end ())
+				continue;
+
+			uint32_t variant = it->second.first;
+			m_ok[variant] = WIFEXITED (status) && WEXITSTATUS (status) == 0 &&
+					read (it->second.second, &m_results[variant], sizeof (Result)) == sizeof (Result);
+			close (it->second.second);
+			children.erase (it);
+		}
+
+		m_forked = true;
+		Simulator::Stop ();
+	}
+
+	uint32_t m_variants;
+	uint32_t m_jobs;
+	Callback<void, uint32_t> m_apply;
+	int32_t m_variant;                            // -1 in the parent
+	int m_fd;                                     // Pipe to the parent, in a child
+	bool m_forked;
+	std::vector<Result> m_results;                // By variant, in the parent
+	std::vector<bool> m_ok;
+};
+
+} // namespace ns3
+
+#endif // ICC_WARMSTART_H
@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-waypoint-convert.cc
+ *  Converts ns-2 movement traces to binary waypoint files and back
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-waypoint-convert is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-waypoint-convert is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-waypoint-convert.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: icc-waypoint-convert <in.ns_movements> <out.wpt>
+//        icc-waypoint-convert -dump <in.wpt>
+//
+// The first form converts a BonnMotion/ns-2 trace for the scenario's
+// -waypoints option, the second prints a waypoint file back as an ns-2
+// trace in time order. Does not need ns-3, build with
+//   g++ -O2 -o icc-waypoint-convert icc-waypoint-convert.cc
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "icc-waypoint-format.h"
+
+using namespace iccwaypoint;
+
+static int Dump (const char *path)
+{
+	WaypointFile file;
+	if (!file.Open (path))
+	{
+		std::cerr << file.GetError () << std::endl;
+		return 1;
+	}
+
+	for (uint64_t i = 0; i < file.GetNRecords (); i++)
+	{
+		const Record &r = file.GetRecord (i);
+
+		if (r.kind == SETDEST)
+		{
+			printf ("$ns_ at %.17g \"$node_(%u) setdest %.17g %.17g %.17g\"\n", r.time, r.node, r.x, r.y, r.speed);
+			continue;
+		}
+
+		const double axes[3] = { r.x, r.y, r.z };
+		for (int a = 0; a < 3; a++)
+		{
+			if (!IsSet (axes[a]))
+				continue;
+			if (r.time == 0)
+				printf ("$node_(%u) set %c_ %.17g\n", r.node, 'X' + a, axes[a]);
+			else
+				printf ("$ns_ at %.17g \"$node_(%u) set %c_ %.17g\"\n", r.time, r.node, 'X' + a, axes[a]);
+		}
+	}
+
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	if (argc == 3 && std::string (argv[1]) == "-dump")
+		return Dump (argv[2]);
+
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <in.ns_movements> <out.wpt>" << std::endl
+				<< "       " << argv[0] << " -dump <in.wpt>" << std::endl;
+		return 2;
+	}
+
+	std::vector<Record> records;
+	Ns2Parser parser;
+	if (!parser.Parse (argv[1], records))
+	{
+		std::cerr << parser.GetError () << std::endl;
+		return 1;
+	}
+
+	Normalize (records);
+
+	std::string error;
+	if (!WriteFile (argv[2], records, error))
+	{
+		std::cerr << error << std::endl;
+		return 1;
+	}
+
+	std::cerr << argv[2] << ": " << records.size () << " waypoints";
+	if (parser.GetSkipped ())
+		std::cerr << ", " << parser.GetSkipped () << " lines skipped";
+	std::cerr << std::endl;
+
+	return 0;
+}
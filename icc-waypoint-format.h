@@ -0,0 +1,449 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-waypoint-format.h
+ *  Binary waypoint files for the ICC scenario mobility traces
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-waypoint-format is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-waypoint-format is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-waypoint-format.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A waypoint file is a FileHeader, the records sorted by time (ties keep
+// the order of the ns-2 trace) and a node index: nodes+1 offsets into a
+// list holding the record numbers of every node, in time order. Everything
+// is fixed width and 8 byte aligned, so the file is used straight from
+// mmap and only the pages that are read are loaded.
+//
+// The ns-2 traces BonnMotion writes are understood: "set X_/Y_/Z_" lines,
+// at time 0 or under "$ns_ at", and "setdest". Position lines for the same
+// node and time are folded into one record, axes not given are NaN.
+//
+// This header does not depend on ns-3 so the converter can be built on its own.
+
+#ifndef ICC_WAYPOINT_FORMAT_H
+#define ICC_WAYPOINT_FORMAT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace iccwaypoint {
+
+static const char MAGIC[8] = { 'I', 'C', 'C', 'W', 'A', 'Y', 'P', 'T' };
+static const uint32_t VERSION = 1;
+
+enum RecordKind
+{
+	POSITION = 1,       // Jump to x, y, z, NaN axes stay where they are
+	SETDEST = 2         // Head for x, y at speed, z stays
+};
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t nodes;                               // Highest node number + 1
+	uint64_t records;
+	uint64_t indexOffset;                         // Offset of the node index
+	double endTime;                               // Time of the last record
+	uint64_t reserved;
+};
+
+struct Record
+{
+	double time;
+	double x;
+	double y;
+	double z;
+	double speed;
+	uint32_t node;
+	uint32_t kind;
+};
+
+// Parses ns-2 movement traces, keeping the records in file order
+class Ns2Parser
+{
+public:
+	Ns2Parser ()
+		: m_skipped (0)
+	{
+	}
+
+	bool Parse (const std::string &path, std::vector<Record> &records)
+	{
+		FILE *f = fopen (path.c_str (), "r");
+		if (!f)
+		{
+			m_error = "cannot open " + path;
+			return false;
+		}
+
+		char line[1024];
+		while (fgets (line, sizeof (line), f))
+		{
+			const char *p = line;
+			while (*p == ' ' || *p == '\t')
+				p++;
+			if (*p == '\0' || *p == '\n' || *p == '#')
+				continue;
+
+			Record r;
+			if (!ParseLine (p, r))
+			{
+				m_skipped++;
+				continue;
+			}
+			records.push_back (r);
+		}
+
+		fclose (f);
+		return true;
+	}
+
+	// Lines that were not waypoints
+	uint64_t GetSkipped () const
+	{
+		return m_skipped;
+	}
+
+	const std::string &GetError () const
+	{
+		return m_error;
+	}
+
+private:
+	static bool ParseLine (const char *p, Record &r)
+	{
+		double nan = std::numeric_limits<double>::quiet_NaN ();
+		unsigned node;
+		char axis;
+		double t, a, b, c;
+
+		r.x = r.y = r.z = nan;
+		r.speed = 0;
+
+		if (sscanf (p, "$ns_ at %lf \"$node_(%u) setdest %lf %lf %lf", &t, &node, &a, &b, &c) == 5)
+		{
+			r.time = t;
+			r.node = node;
+			r.kind = SETDEST;
+			r.x = a;
+			r.y = b;
+			r.speed = c;
+			return true;
+		}
+
+		if (sscanf (p, "$ns_ at %lf \"$node_(%u) set %c_ %lf", &t, &node, &axis, &a) == 4)
+			return SetAxis (r, t, node, axis, a);
+
+		if (sscanf (p, "$node_(%u) set %c_ %lf", &node, &axis, &a) == 3)
+			return SetAxis (r, 0, node, axis, a);
+
+		return false;
+	}
+
+	static bool SetAxis (Record &r, double time, unsigned node, char axis, double value)
+	{
+		r.time = time;
+		r.node = node;
+		r.kind = POSITION;
+
+		switch (axis)
+		{
+		case 'X':
+			r.x = value;
+			return true;
+		case 'Y':
+			r.y = value;
+			return true;
+		case 'Z':
+			r.z = value;
+			return true;
+		}
+		return false;
+	}
+
+	uint64_t m_skipped;
+	std::string m_error;
+};
+
+// Whether a position axis was given, unset axes are NaN
+inline bool IsSet (double axis)
+{
+	return axis == axis;
+}
+
+// Orders records by time, keeping the trace order of records with the same time
+struct RecordTimeLess
+{
+	bool operator() (const Record &a, const Record &b) const
+	{
+		return a.time < b.time;
+	}
+};
+
+// Sorts the records and folds position records of the same node and time,
+// as long as no setdest of that node comes between them
+inline void Normalize (std::vector<Record> &records)
+{
+	std::stable_sort (records.begin (), records.end (), RecordTimeLess ());
+
+	std::vector<Record> out;
+	out.reserve (records.size ());
+
+	// Last record of every node within the current time, -1 when there is none,
+	// and the nodes to reset when the time changes
+	std::vector<int64_t> last;
+	std::vector<uint32_t> touched;
+	double time = -std::numeric_limits<double>::infinity ();
+
+	for (uint64_t i = 0; i < records.size (); i++)
+	{
+		const Record &r = records[i];
+		if (r.time != time)
+		{
+			time = r.time;
+			for (uint32_t j = 0; j < touched.size (); j++)
+				last[touched[j]] = -1;
+			touched.clear ();
+		}
+		if (r.node >= last.size ())
+			last.resize (r.node + 1, -1);
+
+		int64_t prev = last[r.node];
+		if (r.kind == POSITION && prev >= 0 && out[prev].kind == POSITION)
+		{
+			Record &p = out[prev];
+			if (IsSet (r.x)) p.x = r.x;
+			if (IsSet (r.y)) p.y = r.y;
+			if (IsSet (r.z)) p.z = r.z;
+			continue;
+		}
+
+		if (prev < 0)
+			touched.push_back (r.node);
+		last[r.node] = out.size ();
+		out.push_back (r);
+	}
+
+	records.swap (out);
+}
+
+// Writes normalized records with their node index
+inline bool WriteFile (const std::string &path, const std::vector<Record> &records, std::string &error)
+{
+	uint32_t nodes = 0;
+	for (uint64_t i = 0; i < records.size (); i++)
+		nodes = std::max (nodes, records[i].node + 1);
+
+	// Counting sort of the record numbers by node, time order is kept
+	std::vector<uint64_t> start (nodes + 1, 0);
+	for (uint64_t i = 0; i < records.size (); i++)
+		start[records[i].node + 1]++;
+	for (uint32_t n = 0; n < nodes; n++)
+		start[n + 1] += start[n];
+
+	std::vector<uint64_t> index (records.size ());
+	std::vector<uint64_t> fill (start.begin (), start.end () - 1);
+	for (uint64_t i = 0; i < records.size (); i++)
+		index[fill[records[i].node]++] = i;
+
+	FileHeader header;
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, MAGIC, sizeof (MAGIC));
+	header.version = VERSION;
+	header.nodes = nodes;
+	header.records = records.size ();
+	header.indexOffset = sizeof (FileHeader) + records.size () * sizeof (Record);
+	header.endTime = records.empty () ? 0 : records.back ().time;
+
+	FILE *f = fopen (path.c_str (), "wb");
+	if (!f)
+	{
+		error = "cannot create " + path;
+		return false;
+	}
+
+	bool ok = fwrite (&header, sizeof (header), 1, f) == 1;
+	if (ok && !records.empty ())
+		ok = fwrite (&records[0], sizeof (Record), records.size (), f) == records.size ();
+	if (ok)
+		ok = fwrite (&start[0], sizeof (uint64_t), start.size (), f) == start.size ();
+	if (ok && !index.empty ())
+		ok = fwrite (&index[0], sizeof (uint64_t), index.size (), f) == index.size ();
+
+	if (fclose (f) != 0 || !ok)
+	{
+		error = "cannot write " + path;
+		return false;
+	}
+
+	return true;
+}
+
+// A waypoint file mapped into memory
+class WaypointFile
+{
+public:
+	WaypointFile ()
+		: m_base (0), m_size (0), m_header (0), m_records (0), m_nodeStart (0), m_index (0)
+	{
+	}
+
+	~WaypointFile ()
+	{
+		Close ();
+	}
+
+	bool Open (const std::string &path)
+	{
+		Close ();
+
+		int fd = open (path.c_str (), O_RDONLY);
+		if (fd < 0)
+		{
+			m_error = "cannot open " + path;
+			return false;
+		}
+
+		struct stat st;
+		if (fstat (fd, &st) != 0 || st.st_size < static_cast<off_t> (sizeof (FileHeader)))
+		{
+			close (fd);
+			m_error = path + " is not a waypoint file";
+			return false;
+		}
+
+		void *base = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close (fd);
+		if (base == MAP_FAILED)
+		{
+			m_error = "cannot map " + path;
+			return false;
+		}
+
+		m_base = base;
+		m_size = st.st_size;
+		m_header = static_cast<const FileHeader *> (base);
+
+		if (memcmp (m_header->magic, MAGIC, sizeof (MAGIC)) != 0 || m_header->version != VERSION)
+		{
+			Close ();
+			m_error = path + " is not a waypoint file of this version";
+			return false;
+		}
+
+		uint64_t expected = m_header->indexOffset + (m_header->nodes + 1 + m_header->records) * sizeof (uint64_t);
+		if (m_header->indexOffset != sizeof (FileHeader) + m_header->records * sizeof (Record) || expected != m_size)
+		{
+			Close ();
+			m_error = path + " is truncated or damaged";
+			return false;
+		}
+
+		const char *p = static_cast<const char *> (base);
+		m_records = reinterpret_cast<const Record *> (p + sizeof (FileHeader));
+		m_nodeStart = reinterpret_cast<const uint64_t *> (p + m_header->indexOffset);
+		m_index = m_nodeStart + m_header->nodes + 1;
+
+		// Read front to back
+		madvise (base, m_size, MADV_SEQUENTIAL);
+		return true;
+	}
+
+	void Close ()
+	{
+		if (m_base)
+			munmap (m_base, m_size);
+		m_base = 0;
+		m_header = 0;
+		m_records = 0;
+		m_nodeStart = 0;
+		m_index = 0;
+	}
+
+	bool IsOpen () const
+	{
+		return m_base != 0;
+	}
+
+	uint32_t GetNNodes () const
+	{
+		return m_header->nodes;
+	}
+
+	uint64_t GetNRecords () const
+	{
+		return m_header->records;
+	}
+
+	double GetEndTime () const
+	{
+		return m_header->endTime;
+	}
+
+	const Record &GetRecord (uint64_t i) const
+	{
+		return m_records[i];
+	}
+
+	// First record at or after time
+	uint64_t LowerBound (double time) const
+	{
+		Record key;
+		key.time = time;
+		return std::lower_bound (m_records, m_records + m_header->records, key, RecordTimeLess ()) - m_records;
+	}
+
+	// Records of a node, in time order
+	uint64_t GetNNodeRecords (uint32_t node) const
+	{
+		return node < m_header->nodes ? m_nodeStart[node + 1] - m_nodeStart[node] : 0;
+	}
+
+	const Record &GetNodeRecord (uint32_t node, uint64_t i) const
+	{
+		return m_records[m_index[m_nodeStart[node] + i]];
+	}
+
+	const std::string &GetError () const
+	{
+		return m_error;
+	}
+
+private:
+	WaypointFile (const WaypointFile &);
+	WaypointFile &operator= (const WaypointFile &);
+
+	void *m_base;
+	uint64_t m_size;
+	const FileHeader *m_header;
+	const Record *m_records;
+	const uint64_t *m_nodeStart;
+	const uint64_t *m_index;
+	std::string m_error;
+};
+
+} // namespace iccwaypoint
+
+#endif // ICC_WAYPOINT_FORMAT_H
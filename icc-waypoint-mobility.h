@@ -0,0 +1,430 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-waypoint-mobility.h
+ *  Mobility of the ICC scenario nodes from binary waypoint files
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-waypoint-mobility is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-waypoint-mobility is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-waypoint-mobility.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_WAYPOINT_MOBILITY_H
+#define ICC_WAYPOINT_MOBILITY_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/mobility-module.h>
+#include <ns3-dev/ns3/network-module.h>
+
+#include "icc-waypoint-format.h"
+
+namespace ns3 {
+
+// Drives ConstantVelocityMobilityModels from a waypoint file the way
+// Ns2MobilityHelper does from an ns-2 trace, but the waypoints are read
+// from the mapped file a window at a time: only the events of the next
+// window are in the scheduler, and only the pages of the file around the
+// current time are in memory
+class WaypointStreamer
+{
+public:
+	WaypointStreamer ()
+		: m_next (0)
+	{
+	}
+
+	bool Open (const std::string &path)
+	{
+		return m_file.Open (path);
+	}
+
+	const std::string &GetError () const
+	{
+		return m_file.GetError ();
+	}
+
+	// Trace node i moves nodes.Get (i). Returns how many nodes got a mobility
+	// model, nodes beyond the ones in the trace are left alone
+	uint32_t Install (const NodeContainer &nodes, Time window)
+	{
+		m_window = window;
+
+		uint32_t n = std::min (nodes.GetN (), m_file.GetNNodes ());
+		m_models.resize (n);
+		m_arrivals.resize (n);
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			if (m_file.GetNNodeRecords (i) == 0)
+				continue;
+
+			m_models[i] = CreateObject<ConstantVelocityMobilityModel> ();
+			nodes.Get (i)->AggregateObject (m_models[i]);
+		}
+
+		// Initial positions are there before anything runs
+		while (m_next < m_file.GetNRecords () && m_file.GetRecord (m_next).time <= 0
+				&& m_file.GetRecord (m_next).kind == iccwaypoint::POSITION)
+		{
+			Apply (m_next++);
+		}
+
+		LoadWindow ();
+		return n;
+	}
+
+	uint64_t GetNRecords () const
+	{
+		return m_file.GetNRecords ();
+	}
+
+private:
+	// Schedule the waypoints of the next window and the load after it
+	void LoadWindow ()
+	{
+		double end = Simulator::Now ().GetSeconds () + m_window.GetSeconds ();
+		uint64_t last = m_file.LowerBound (end);
+
+		for (; m_next < last; m_next++)
+		{
+			const iccwaypoint::Record &r = m_file.GetRecord (m_next);
+			if (r.node < m_models.size () && m_models[r.node] != 0)
+				Simulator::Schedule (Seconds (r.time) - Simulator::Now (), &WaypointStreamer::Apply, this, m_next);
+		}
+
+		if (m_next < m_file.GetNRecords ())
+		{
+			// Skip over stretches without waypoints
+			double next = std::max (end, m_file.GetRecord (m_next).time - m_window.GetSeconds ());
+			Simulator::Schedule (Seconds (next) - Simulator::Now (), &WaypointStreamer::LoadWindow, this);
+		}
+	}
+
+	void Apply (uint64_t i)
+	{
+		const iccwaypoint::Record &r = m_file.GetRecord (i);
+		// Trace nodes beyond the ones installed are left out
+		if (r.node >= m_models.size () || m_models[r.node] == 0)
+			return;
+
+		Ptr<ConstantVelocityMobilityModel> model = m_models[r.node];
+
+		Vector pos = model->GetPosition ();
+		m_arrivals[r.node].Cancel ();
+
+		// A jump stops the node where it lands
+		if (r.kind == iccwaypoint::POSITION)
+		{
+			if (iccwaypoint::IsSet (r.x)) pos.x = r.x;
+			if (iccwaypoint::IsSet (r.y)) pos.y = r.y;
+			if (iccwaypoint::IsSet (r.z)) pos.z = r.z;
+			model->SetVelocity (Vector (0, 0, 0));
+			model->SetPosition (pos);
+			return;
+		}
+
+		// setdest: head for the destination and stop there
+
+		double dx = r.x - pos.x;
+		double dy = r.y - pos.y;
+		double dist = std::sqrt (dx * dx + dy * dy);
+
+		if (dist == 0 || r.speed <= 0)
+		{
+			model->SetVelocity (Vector (0, 0, 0));
+			return;
+		}
+
+		model->SetVelocity (Vector (dx / dist * r.speed, dy / dist * r.speed, 0));
+		m_arrivals[r.node] = Simulator::Schedule (Seconds (dist / r.speed), &WaypointStreamer::Arrive, this,
+				r.node, Vector (r.x, r.y, pos.z));
+	}
+
+	void Arrive (uint32_t node, Vector dest)
+	{
+		m_models[node]->SetVelocity (Vector (0, 0, 0));
+		m_models[node]->SetPosition (dest);
+	}
+
+	iccwaypoint::WaypointFile m_file;
+	std::vector<Ptr<ConstantVelocityMobilityModel> > m_models;
+	std::vector<EventId> m_arrivals;              // Stop at the setdest destination
+	uint64_t m_next;                              // First record not scheduled yet
+	Time m_window;
+};
+
+// Moves a node along a precomputed piecewise linear trajectory. Positions
+// and velocities are interpolated between knots found by binary search,
+// starting from the segment of the last query, so there are no events per
+// waypoint and time ordered queries cost O(1). Before the first knot the
+// node sits at it, after the last one it stays at the last one. Course
+// change notifications only come from SetPosition; who needs to know when
+// the velocity changes asks GetTimeToNextChange
+class TrajectoryMobilityModel : public MobilityModel
+{
+public:
+	struct Knot
+	{
+		double time;
+		Vector position;
+	};
+
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccTrajectoryMobilityModel")
+			.SetParent<MobilityModel> ()
+			.AddConstructor<TrajectoryMobilityModel> ();
+		return tid;
+	}
+
+	TrajectoryMobilityModel ()
+		: m_segment (0)
+	{
+	}
+
+	// Takes over the knots, which must be in time order. Knots with the same
+	// time are jumps, the last of them holds from that time on
+	void SetKnots (std::vector<Knot> &knots)
+	{
+		m_knots.swap (knots);
+		m_segment = 0;
+	}
+
+	uint32_t GetNKnots () const
+	{
+		return m_knots.size ();
+	}
+
+	// Seconds until the velocity may change, infinity once it cannot
+	double GetTimeToNextChange () const
+	{
+		double t = Simulator::Now ().GetSeconds ();
+		if (m_knots.empty ())
+			return std::numeric_limits<double>::infinity ();
+		if (t < m_knots[0].time)
+			return m_knots[0].time - t;
+
+		uint32_t i = Find (t);
+		return i + 1 < m_knots.size () ? m_knots[i + 1].time - t : std::numeric_limits<double>::infinity ();
+	}
+
+private:
+	// Last knot at or before t, t must not be before the first knot
+	uint32_t Find (double t) const
+	{
+		uint32_t n = m_knots.size ();
+		uint32_t i = m_segment;
+
+		// Queries mostly come in time order: same segment or the next one
+		if (i < n && m_knots[i].time <= t)
+		{
+			if (i + 1 == n || t < m_knots[i + 1].time)
+				return i;
+			if (i + 2 == n || t < m_knots[i + 2].time)
+				return m_segment = i + 1;
+		}
+
+		Knot key;
+		key.time = t;
+		m_segment = std::upper_bound (m_knots.begin (), m_knots.end (), key, KnotTimeLess ()) - m_knots.begin () - 1;
+		return m_segment;
+	}
+
+	virtual Vector DoGetPosition (void) const
+	{
+		if (m_knots.empty ())
+			return Vector ();
+
+		double t = Simulator::Now ().GetSeconds ();
+		if (t < m_knots[0].time)
+			return m_knots[0].position;
+
+		uint32_t i = Find (t);
+		if (i + 1 == m_knots.size ())
+			return m_knots[i].position;
+
+		const Knot &a = m_knots[i];
+		const Knot &b = m_knots[i + 1];
+		double f = (t - a.time) / (b.time - a.time);
+		return Vector (a.position.x + f * (b.position.x - a.position.x),
+				a.position.y + f * (b.position.y - a.position.y),
+				a.position.z + f * (b.position.z - a.position.z));
+	}
+
+	// Stays at the given position from now on
+	virtual void DoSetPosition (const Vector &position)
+	{
+		m_knots.clear ();
+		Knot k;
+		k.time = Simulator::Now ().GetSeconds ();
+		k.position = position;
+		m_knots.push_back (k);
+		m_segment = 0;
+		NotifyCourseChange ();
+	}
+
+	virtual Vector DoGetVelocity (void) const
+	{
+		double t = Simulator::Now ().GetSeconds ();
+		if (m_knots.empty () || t < m_knots[0].time)
+			return Vector ();
+
+		uint32_t i = Find (t);
+		if (i + 1 == m_knots.size ())
+			return Vector ();
+
+		const Knot &a = m_knots[i];
+		const Knot &b = m_knots[i + 1];
+		double dt = b.time - a.time;
+		return Vector ((b.position.x - a.position.x) / dt, (b.position.y - a.position.y) / dt,
+				(b.position.z - a.position.z) / dt);
+	}
+
+	struct KnotTimeLess
+	{
+		bool operator() (const Knot &a, const Knot &b) const
+		{
+			return a.time < b.time;
+		}
+	};
+
+	std::vector<Knot> m_knots;
+	mutable uint32_t m_segment;                   // Segment of the last query
+};
+
+// Turns waypoint records into trajectories with the setdest semantics of
+// Ns2MobilityHelper: a node heads for its destination in a straight line
+// and stops there, a new waypoint cuts the current leg short
+class TrajectoryBuilder
+{
+public:
+	// Records must be in time order, trace node i moves nodes.Get (i).
+	// Returns how many nodes got a trajectory, the others are left alone
+	static uint32_t Install (const iccwaypoint::Record *records, uint64_t n, const NodeContainer &nodes)
+	{
+		std::vector<Leg> legs (nodes.GetN ());
+		std::vector<std::vector<TrajectoryMobilityModel::Knot> > knots (nodes.GetN ());
+
+		for (uint64_t i = 0; i < n; i++)
+		{
+			if (records[i].node < nodes.GetN ())
+				Add (legs[records[i].node], knots[records[i].node], records[i]);
+		}
+
+		uint32_t installed = 0;
+		for (uint32_t i = 0; i < nodes.GetN (); i++)
+		{
+			if (knots[i].empty ())
+				continue;
+
+			if (legs[i].moving)
+				Push (knots[i], legs[i].end, legs[i].dest);
+
+			Ptr<TrajectoryMobilityModel> model = CreateObject<TrajectoryMobilityModel> ();
+			model->SetKnots (knots[i]);
+			nodes.Get (i)->AggregateObject (model);
+			installed++;
+		}
+
+		return installed;
+	}
+
+private:
+	// The leg a node is on while the records are read
+	struct Leg
+	{
+		Leg ()
+			: start (0), end (0), moving (false)
+		{
+		}
+
+		double start;
+		double end;                               // Arrival time when moving
+		Vector from;
+		Vector dest;
+		bool moving;
+
+		Vector At (double t) const
+		{
+			if (!moving)
+				return from;
+			if (t >= end)
+				return dest;
+
+			double f = (t - start) / (end - start);
+			return Vector (from.x + f * (dest.x - from.x), from.y + f * (dest.y - from.y), from.z + f * (dest.z - from.z));
+		}
+	};
+
+	static void Push (std::vector<TrajectoryMobilityModel::Knot> &knots, double time, const Vector &pos)
+	{
+		if (!knots.empty ())
+		{
+			const TrajectoryMobilityModel::Knot &last = knots.back ();
+			if (last.time == time && last.position.x == pos.x && last.position.y == pos.y && last.position.z == pos.z)
+				return;
+		}
+
+		TrajectoryMobilityModel::Knot k;
+		k.time = time;
+		k.position = pos;
+		knots.push_back (k);
+	}
+
+	static void Add (Leg &leg, std::vector<TrajectoryMobilityModel::Knot> &knots, const iccwaypoint::Record &r)
+	{
+		// Finish the leg if it ended before this waypoint
+		if (leg.moving && leg.end <= r.time)
+		{
+			Push (knots, leg.end, leg.dest);
+			leg.moving = false;
+			leg.from = leg.dest;
+		}
+
+		Vector pos = leg.At (r.time);
+		Push (knots, r.time, pos);
+
+		leg.moving = false;
+		leg.from = pos;
+		leg.start = r.time;
+
+		if (r.kind == iccwaypoint::POSITION)
+		{
+			if (iccwaypoint::IsSet (r.x)) pos.x = r.x;
+			if (iccwaypoint::IsSet (r.y)) pos.y = r.y;
+			if (iccwaypoint::IsSet (r.z)) pos.z = r.z;
+			Push (knots, r.time, pos);
+			leg.from = pos;
+			return;
+		}
+
+		double dx = r.x - pos.x;
+		double dy = r.y - pos.y;
+		double dist = std::sqrt (dx * dx + dy * dy);
+		if (dist == 0 || r.speed <= 0)
+			return;
+
+		leg.moving = true;
+		leg.dest = Vector (r.x, r.y, pos.z);
+		leg.end = r.time + dist / r.speed;
+	}
+};
+
+} // namespace ns3
+
+#endif // ICC_WAYPOINT_MOBILITY_H
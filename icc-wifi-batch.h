@@ -0,0 +1,747 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-wifi-batch.h
+ *  Batched ThreeLogDistance and Nakagami loss for the ICC scenario Wifi channel
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-wifi-batch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-wifi-batch is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-wifi-batch.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_WIFI_BATCH_H
+#define ICC_WIFI_BATCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ICC_LOSS_AVX2 1
+#include <immintrin.h>
+#endif
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/mobility-module.h>
+#include <ns3-dev/ns3/propagation-module.h>
+
+#include "icc-wifi-culling.h"
+
+namespace ns3 {
+
+namespace iccloss {
+
+// Uniform draws taken from the stream a block at a time
+static const uint32_t BLOCK = 512;
+
+// The ThreeLogDistance and Nakagami parameters of the chain, with the ns-3
+// defaults
+struct LossParams
+{
+	LossParams ()
+		: distance0 (1), distance1 (200), distance2 (500), exponent0 (1.9), exponent1 (3.8), exponent2 (3.8),
+		  referenceLoss (46.6777), mDistance1 (80), mDistance2 (200), m0 (1.5), m1 (0.75), m2 (0.75)
+	{
+	}
+
+	double distance0;                             // ThreeLogDistance field borders (meters)
+	double distance1;
+	double distance2;
+	double exponent0;                             // Path loss exponent of each field
+	double exponent1;
+	double exponent2;
+	double referenceLoss;                         // Loss at distance0 (dB)
+	double mDistance1;                            // Nakagami borders (meters)
+	double mDistance2;
+	double m0;                                    // Nakagami shape of each field
+	double m1;
+	double m2;
+};
+
+// Uniform (0,1) draws of a random stream, read in blocks so the kernels
+// take them as arrays. Draws left in a block when a larger array is asked
+// for are skipped, which only costs stream
+class UniformBlock
+{
+public:
+	UniformBlock ()
+		: m_next (BLOCK), m_buffer (BLOCK)
+	{
+	}
+
+	void SetStream (Ptr<UniformRandomVariable> stream)
+	{
+		m_stream = stream;
+		m_next = BLOCK;
+	}
+
+	// The next n draws, at most BLOCK, valid until the next call
+	const double *Take (uint32_t n)
+	{
+		if (m_next + n > BLOCK)
+		{
+			for (uint32_t i = 0; i < BLOCK; i++)
+				m_buffer[i] = m_stream->GetValue ();
+			m_next = 0;
+		}
+		const double *u = &m_buffer[m_next];
+		m_next += n;
+		return u;
+	}
+
+private:
+	Ptr<UniformRandomVariable> m_stream;
+	uint32_t m_next;
+	std::vector<double> m_buffer;
+};
+
+// Gamma draw by Marsaglia and Tsang, shapes below 1 are boosted by one and
+// scaled back with a uniform
+inline double Gamma (double shape, UniformBlock &uniforms)
+{
+	double a = shape < 1 ? shape + 1 : shape;
+	double d = a - 1.0 / 3;
+	double c = 1 / std::sqrt (9 * d);
+	double v;
+
+	for (;;)
+	{
+		const double *u = uniforms.Take (3);
+		double x = std::sqrt (-2 * std::log (u[0])) * std::cos (2 * M_PI * u[1]);
+		v = 1 + c * x;
+		if (v <= 0)
+			continue;
+		v = v * v * v;
+		double x2 = x * x;
+		if (u[2] < 1 - 0.0331 * x2 * x2 || std::log (u[2]) < 0.5 * x2 + d * (1 - v + std::log (v)))
+			break;
+	}
+
+	double g = d * v;
+	if (shape < 1)
+		g *= std::pow (*uniforms.Take (1), 1 / shape);
+	return g;
+}
+
+// Mean received power (W) of receivers at dx, dy, dz from the sender, given
+// as the Nakagami shape and scale of their fading
+inline void MeanPowerScalar (const LossParams &p, double txPowerDbm, const double *dx, const double *dy, const double *dz,
+		uint32_t n, double *shape, double *scale)
+{
+	for (uint32_t i = 0; i < n; i++)
+	{
+		double d = std::sqrt (dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+
+		double loss;
+		if (d < p.distance0)
+			loss = 0;
+		else if (d < p.distance1)
+			loss = p.referenceLoss + 10 * p.exponent0 * std::log10 (d / p.distance0);
+		else if (d < p.distance2)
+			loss = p.referenceLoss + 10 * p.exponent0 * std::log10 (p.distance1 / p.distance0) +
+					10 * p.exponent1 * std::log10 (d / p.distance1);
+		else
+			loss = p.referenceLoss + 10 * p.exponent0 * std::log10 (p.distance1 / p.distance0) +
+					10 * p.exponent1 * std::log10 (p.distance2 / p.distance1) + 10 * p.exponent2 * std::log10 (d / p.distance2);
+
+		double m = d < p.mDistance1 ? p.m0 : d < p.mDistance2 ? p.m1 : p.m2;
+		shape[i] = m;
+		scale[i] = std::pow (10, (txPowerDbm - loss - 30) / 10) / m;
+	}
+}
+
+// Faded received power (dBm) of receivers with the given Nakagami shape and
+// scale
+inline void NakagamiScalar (const double *shape, const double *scale, uint32_t n, UniformBlock &uniforms, double *rxDbm)
+{
+	for (uint32_t i = 0; i < n; i++)
+		rxDbm[i] = 10 * std::log10 (Gamma (shape[i], uniforms) * scale[i]) + 30;
+}
+
+#ifdef ICC_LOSS_AVX2
+
+// The AVX2 kernels are compiled for AVX2 whatever the build flags, and only
+// called when the CPU has it
+#define ICC_AVX2 __attribute__ ((target ("avx2")))
+
+inline bool HasAvx2 ()
+{
+	static const bool has = __builtin_cpu_supports ("avx2");
+	return has;
+}
+
+// Natural logarithm of positive normal numbers, to a few ulp: x = 2^e m with
+// m in [sqrt(1/2), sqrt(2)), and log m from the atanh series of (m-1)/(m+1)
+ICC_AVX2 inline __m256d Log (__m256d x)
+{
+	const __m256d one = _mm256_set1_pd (1);
+	const __m256i bits = _mm256_castpd_si256 (x);
+
+	// The exponent turned into a double through the mantissa of 2^52
+	__m256i e = _mm256_srli_epi64 (bits, 52);
+	__m256d ed = _mm256_sub_pd (_mm256_castsi256_pd (_mm256_or_si256 (e, _mm256_set1_epi64x (0x4330000000000000LL))),
+			_mm256_set1_pd (4503599627370496.0 + 1023));
+
+	__m256d m = _mm256_castsi256_pd (_mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi64x (0x000fffffffffffffLL)),
+			_mm256_set1_epi64x (0x3ff0000000000000LL)));
+	__m256d big = _mm256_cmp_pd (m, _mm256_set1_pd (M_SQRT2), _CMP_GT_OQ);
+	m = _mm256_blendv_pd (m, _mm256_mul_pd (m, _mm256_set1_pd (0.5)), big);
+	ed = _mm256_add_pd (ed, _mm256_and_pd (big, one));
+
+	__m256d s = _mm256_div_pd (_mm256_sub_pd (m, one), _mm256_add_pd (m, one));
+	__m256d s2 = _mm256_mul_pd (s, s);
+	__m256d poly = _mm256_set1_pd (1.0 / 21);
+	for (int k = 9; k >= 0; k--)
+		poly = _mm256_add_pd (_mm256_mul_pd (poly, s2), _mm256_set1_pd (1.0 / (2 * k + 1)));
+
+	return _mm256_add_pd (_mm256_mul_pd (ed, _mm256_set1_pd (M_LN2)),
+			_mm256_mul_pd (_mm256_mul_pd (_mm256_set1_pd (2), s), poly));
+}
+
+// e^x for x within +-700: 2^k e^r with r within +-ln2/2 from its Taylor series
+ICC_AVX2 inline __m256d Exp (__m256d x)
+{
+	x = _mm256_max_pd (_mm256_min_pd (x, _mm256_set1_pd (700)), _mm256_set1_pd (-700));
+
+	__m256d k = _mm256_round_pd (_mm256_mul_pd (x, _mm256_set1_pd (M_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	// ln2 in two parts, so k ln2 is exact enough
+	__m256d r = _mm256_sub_pd (x, _mm256_mul_pd (k, _mm256_set1_pd (6.93147180369123816490e-01)));
+	r = _mm256_sub_pd (r, _mm256_mul_pd (k, _mm256_set1_pd (1.90821492927058770002e-10)));
+
+	static const double factorial[14] = { 1, 1, 2, 6, 24, 120, 720, 5040, 40320, 362880, 3628800, 39916800,
+			479001600, 6227020800.0 };
+	__m256d poly = _mm256_set1_pd (1 / factorial[13]);
+	for (int i = 12; i >= 0; i--)
+		poly = _mm256_add_pd (_mm256_mul_pd (poly, r), _mm256_set1_pd (1 / factorial[i]));
+
+	// 2^k written straight into the exponent bits
+	__m256d biased = _mm256_add_pd (k, _mm256_set1_pd (4503599627370496.0 + 1023));
+	__m256d scale = _mm256_castsi256_pd (_mm256_slli_epi64 (_mm256_castpd_si256 (biased), 52));
+	return _mm256_mul_pd (poly, scale);
+}
+
+// cos (2 pi u), folded onto [0, pi/2] and taken from its Taylor series
+ICC_AVX2 inline __m256d Cos2Pi (__m256d u)
+{
+	__m256d t = _mm256_sub_pd (u, _mm256_round_pd (u, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	t = _mm256_andnot_pd (_mm256_set1_pd (-0.0), t);
+	__m256d flip = _mm256_cmp_pd (t, _mm256_set1_pd (0.25), _CMP_GT_OQ);
+	t = _mm256_blendv_pd (t, _mm256_sub_pd (_mm256_set1_pd (0.5), t), flip);
+
+	__m256d x = _mm256_mul_pd (t, _mm256_set1_pd (2 * M_PI));
+	__m256d x2 = _mm256_mul_pd (x, x);
+	// 1 - x^2/2! + x^4/4! - ... - x^18/18!
+	__m256d poly = _mm256_set1_pd (-1.0 / 6402373705728000.0);
+	static const double coefficients[9] = { 1, -1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800,
+			1.0 / 479001600, -1.0 / 87178291200.0, 1.0 / 20922789888000.0 };
+	for (int i = 8; i >= 0; i--)
+		poly = _mm256_add_pd (_mm256_mul_pd (poly, x2), _mm256_set1_pd (coefficients[i]));
+
+	return _mm256_xor_pd (poly, _mm256_and_pd (flip, _mm256_set1_pd (-0.0)));
+}
+
+// MeanPowerScalar on four receivers at a time
+ICC_AVX2 inline void MeanPowerAvx2 (const LossParams &p, double txPowerDbm, const double *dx, const double *dy,
+		const double *dz, uint32_t n, double *shape, double *scale)
+{
+	const double l0 = std::log10 (p.distance0);
+	const double l1 = std::log10 (p.distance1);
+	const double l2 = std::log10 (p.distance2);
+	// Loss at the start of the second and third field
+	const double at1 = p.referenceLoss + 10 * p.exponent0 * (l1 - l0);
+	const double at2 = at1 + 10 * p.exponent1 * (l2 - l1);
+
+	const __m256d ten = _mm256_set1_pd (10);
+	uint32_t vn = n & ~3u;
+	for (uint32_t i = 0; i < vn; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd (dx + i);
+		__m256d y = _mm256_loadu_pd (dy + i);
+		__m256d z = _mm256_loadu_pd (dz + i);
+		__m256d d = _mm256_sqrt_pd (_mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (x, x), _mm256_mul_pd (y, y)),
+				_mm256_mul_pd (z, z)));
+		// Receivers on the sender are masked out below, keep their log finite
+		__m256d l = _mm256_mul_pd (Log (_mm256_max_pd (d, _mm256_set1_pd (1e-300))), _mm256_set1_pd (1 / M_LN10));
+
+		__m256d loss0 = _mm256_add_pd (_mm256_set1_pd (p.referenceLoss),
+				_mm256_mul_pd (_mm256_mul_pd (ten, _mm256_set1_pd (p.exponent0)), _mm256_sub_pd (l, _mm256_set1_pd (l0))));
+		__m256d loss1 = _mm256_add_pd (_mm256_set1_pd (at1),
+				_mm256_mul_pd (_mm256_mul_pd (ten, _mm256_set1_pd (p.exponent1)), _mm256_sub_pd (l, _mm256_set1_pd (l1))));
+		__m256d loss2 = _mm256_add_pd (_mm256_set1_pd (at2),
+				_mm256_mul_pd (_mm256_mul_pd (ten, _mm256_set1_pd (p.exponent2)), _mm256_sub_pd (l, _mm256_set1_pd (l2))));
+
+		__m256d loss = _mm256_blendv_pd (loss2, loss1, _mm256_cmp_pd (d, _mm256_set1_pd (p.distance2), _CMP_LT_OQ));
+		loss = _mm256_blendv_pd (loss, loss0, _mm256_cmp_pd (d, _mm256_set1_pd (p.distance1), _CMP_LT_OQ));
+		loss = _mm256_blendv_pd (loss, _mm256_setzero_pd (), _mm256_cmp_pd (d, _mm256_set1_pd (p.distance0), _CMP_LT_OQ));
+
+		__m256d m = _mm256_blendv_pd (_mm256_set1_pd (p.m2), _mm256_set1_pd (p.m1),
+				_mm256_cmp_pd (d, _mm256_set1_pd (p.mDistance2), _CMP_LT_OQ));
+		m = _mm256_blendv_pd (m, _mm256_set1_pd (p.m0), _mm256_cmp_pd (d, _mm256_set1_pd (p.mDistance1), _CMP_LT_OQ));
+
+		// 10^((rx - 30) / 10)
+		__m256d dbm = _mm256_sub_pd (_mm256_set1_pd (txPowerDbm - 30), loss);
+		__m256d watt = Exp (_mm256_mul_pd (dbm, _mm256_set1_pd (M_LN10 / 10)));
+
+		_mm256_storeu_pd (shape + i, m);
+		_mm256_storeu_pd (scale + i, _mm256_div_pd (watt, m));
+	}
+
+	MeanPowerScalar (p, txPowerDbm, dx + vn, dy + vn, dz + vn, n - vn, shape + vn, scale + vn);
+}
+
+// NakagamiScalar on four receivers at a time. A lane whose draw is rejected
+// draws again with the others until all four have accepted
+ICC_AVX2 inline void NakagamiAvx2 (const double *shape, const double *scale, uint32_t n, UniformBlock &uniforms,
+		double *rxDbm)
+{
+	const __m256d one = _mm256_set1_pd (1);
+	const __m256d half = _mm256_set1_pd (0.5);
+
+	uint32_t vn = n & ~3u;
+	for (uint32_t i = 0; i < vn; i += 4)
+	{
+		__m256d a = _mm256_loadu_pd (shape + i);
+		__m256d boost = _mm256_cmp_pd (a, one, _CMP_LT_OQ);
+		__m256d d = _mm256_sub_pd (_mm256_add_pd (a, _mm256_and_pd (boost, one)), _mm256_set1_pd (1.0 / 3));
+		__m256d c = _mm256_div_pd (one, _mm256_sqrt_pd (_mm256_mul_pd (_mm256_set1_pd (9), d)));
+
+		__m256d g = _mm256_setzero_pd ();
+		__m256d pending = _mm256_castsi256_pd (_mm256_set1_epi64x (-1));
+		do
+		{
+			const double *u = uniforms.Take (12);
+			__m256d u0 = _mm256_loadu_pd (u);
+			__m256d u1 = _mm256_loadu_pd (u + 4);
+			__m256d u2 = _mm256_loadu_pd (u + 8);
+
+			__m256d x = _mm256_mul_pd (_mm256_sqrt_pd (_mm256_mul_pd (_mm256_set1_pd (-2), Log (u0))), Cos2Pi (u1));
+			__m256d v = _mm256_add_pd (one, _mm256_mul_pd (c, x));
+			__m256d positive = _mm256_cmp_pd (v, _mm256_setzero_pd (), _CMP_GT_OQ);
+			v = _mm256_blendv_pd (one, _mm256_mul_pd (_mm256_mul_pd (v, v), v), positive);
+
+			__m256d x2 = _mm256_mul_pd (x, x);
+			__m256d squeeze = _mm256_cmp_pd (u2, _mm256_sub_pd (one, _mm256_mul_pd (_mm256_set1_pd (0.0331),
+					_mm256_mul_pd (x2, x2))), _CMP_LT_OQ);
+			__m256d bound = _mm256_add_pd (_mm256_mul_pd (half, x2),
+					_mm256_mul_pd (d, _mm256_add_pd (_mm256_sub_pd (one, v), Log (v))));
+			__m256d full = _mm256_cmp_pd (Log (u2), bound, _CMP_LT_OQ);
+
+			__m256d accept = _mm256_and_pd (_mm256_and_pd (positive, pending), _mm256_or_pd (squeeze, full));
+			g = _mm256_blendv_pd (g, _mm256_mul_pd (d, v), accept);
+			pending = _mm256_andnot_pd (accept, pending);
+		}
+		while (_mm256_movemask_pd (pending));
+
+		if (_mm256_movemask_pd (boost))
+		{
+			__m256d u = _mm256_loadu_pd (uniforms.Take (4));
+			__m256d scaled = _mm256_mul_pd (g, Exp (_mm256_div_pd (Log (u), a)));
+			g = _mm256_blendv_pd (g, scaled, boost);
+		}
+
+		__m256d watt = _mm256_mul_pd (g, _mm256_loadu_pd (scale + i));
+		__m256d dbm = _mm256_add_pd (_mm256_mul_pd (Log (watt), _mm256_set1_pd (10 / M_LN10)), _mm256_set1_pd (30));
+		_mm256_storeu_pd (rxDbm + i, dbm);
+	}
+
+	NakagamiScalar (shape + vn, scale + vn, n - vn, uniforms, rxDbm + vn);
+}
+
+#undef ICC_AVX2
+
+#else
+
+inline bool HasAvx2 ()
+{
+	return false;
+}
+
+#endif // ICC_LOSS_AVX2
+
+} // namespace iccloss
+
+// What the batched loss model has done since it was created
+struct BatchCounters
+{
+	BatchCounters ()
+		: evaluated (0), batches (0), drawn (0), culled (0), unlisted (0)
+	{
+	}
+
+	uint64_t evaluated;                           // Sender and receiver pairs asked for
+	uint64_t batches;                             // Transmissions evaluated for all receivers at once
+	uint64_t drawn;                               // Receivers those evaluated
+	uint64_t culled;                              // Receivers beyond the maximum range in them
+	uint64_t unlisted;                            // Pairs towards receivers not added, evaluated alone
+};
+
+// ThreeLogDistance followed by Nakagami, as the Wifi channel of the scenario
+// chains them, for all receivers of a transmission at once. The channel asks
+// for one receiver at a time, but all of them at the same time step, so the
+// first pair of a transmission gathers the positions of every receiver added
+// into arrays and computes their distances, mean powers and fading draws in
+// kernels over the arrays, AVX2 ones where the CPU has them. The other pairs
+// only read their result. Receivers beyond MaxRange get ICC_CULLED_RX_DBM
+// and draw nothing, like RangeCullingLossModel.
+//
+// The fading comes from one stream of this model instead of the two of
+// NakagamiPropagationLossModel, and receivers the channel skips (other
+// channel numbers) still draw, so a run is statistically the same as with
+// the ns-3 chain, not the same run. CheckBatchedLoss compares the two
+class BatchedLossModel : public PropagationLossModel
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccBatchedLossModel")
+			.SetParent<PropagationLossModel> ()
+			.AddConstructor<BatchedLossModel> ()
+			.AddAttribute ("MaxRange", "Receivers further than this from the sender are culled (meters, 0 is off)",
+					DoubleValue (0),
+					MakeDoubleAccessor (&BatchedLossModel::SetMaxRange, &BatchedLossModel::GetMaxRange),
+					MakeDoubleChecker<double> (0))
+			.AddAttribute ("Avx2", "Use the AVX2 kernels when the CPU has them",
+					BooleanValue (true),
+					MakeBooleanAccessor (&BatchedLossModel::m_avx2),
+					MakeBooleanChecker ());
+		return tid;
+	}
+
+	BatchedLossModel ()
+		: m_maxRange (0), m_maxRange2 (0), m_avx2 (true), m_indexed (true), m_senderTime (-1), m_senderPower (0)
+	{
+		m_uniform = CreateObject<UniformRandomVariable> ();
+		m_uniforms.SetStream (m_uniform);
+	}
+
+	// Takes the parameters of the chain this model stands in for
+	void CopyParameters (Ptr<ThreeLogDistancePropagationLossModel> logDistance, Ptr<NakagamiPropagationLossModel> nakagami)
+	{
+		m_params.distance0 = GetDouble (logDistance, "Distance0");
+		m_params.distance1 = GetDouble (logDistance, "Distance1");
+		m_params.distance2 = GetDouble (logDistance, "Distance2");
+		m_params.exponent0 = GetDouble (logDistance, "Exponent0");
+		m_params.exponent1 = GetDouble (logDistance, "Exponent1");
+		m_params.exponent2 = GetDouble (logDistance, "Exponent2");
+		m_params.referenceLoss = GetDouble (logDistance, "ReferenceLoss");
+		m_params.mDistance1 = GetDouble (nakagami, "Distance1");
+		m_params.mDistance2 = GetDouble (nakagami, "Distance2");
+		m_params.m0 = GetDouble (nakagami, "m0");
+		m_params.m1 = GetDouble (nakagami, "m1");
+		m_params.m2 = GetDouble (nakagami, "m2");
+	}
+
+	// A receiver on the channel, evaluated with every transmission
+	void AddReceiver (Ptr<MobilityModel> receiver)
+	{
+		m_index.push_back (std::make_pair (PeekPointer (receiver), (uint32_t) m_receivers.size ()));
+		m_receivers.push_back (receiver);
+		m_rxDbm.push_back (ICC_CULLED_RX_DBM);
+		m_served.push_back (0);
+		m_indexed = false;
+	}
+
+	void SetMaxRange (double range)
+	{
+		m_maxRange = range;
+		m_maxRange2 = range * range;
+	}
+
+	double GetMaxRange () const
+	{
+		return m_maxRange;
+	}
+
+	// Whether the AVX2 kernels run
+	bool UsesAvx2 () const
+	{
+		return m_avx2 && iccloss::HasAvx2 ();
+	}
+
+	const BatchCounters &GetCounters () const
+	{
+		return m_counters;
+	}
+
+	// n received powers at distance from a sender, through the kernels a
+	// transmission goes through
+	void Sample (double txPowerDbm, double distance, uint32_t n, double *rxDbm)
+	{
+		m_dx.assign (n, distance);
+		m_dy.assign (n, 0);
+		m_dz.assign (n, 0);
+		Evaluate (txPowerDbm, n);
+		std::copy (m_out.begin (), m_out.begin () + n, rxDbm);
+	}
+
+protected:
+	virtual void DoDispose (void)
+	{
+		m_receivers.clear ();
+		m_index.clear ();
+		m_sender = 0;
+		m_uniform = 0;
+		m_uniforms.SetStream (0);
+		PropagationLossModel::DoDispose ();
+	}
+
+private:
+	static double GetDouble (Ptr<Object> object, const std::string &name)
+	{
+		DoubleValue value;
+		object->GetAttribute (name, value);
+		return value.Get ();
+	}
+
+	// Loss and fading of the receivers in m_dx, m_dy and m_dz into m_out
+	void Evaluate (double txPowerDbm, uint32_t n) const
+	{
+		m_shape.resize (n);
+		m_scale.resize (n);
+		m_out.resize (n);
+		if (n == 0)
+			return;
+
+#ifdef ICC_LOSS_AVX2
+		if (UsesAvx2 ())
+		{
+			iccloss::MeanPowerAvx2 (m_params, txPowerDbm, &m_dx[0], &m_dy[0], &m_dz[0], n, &m_shape[0], &m_scale[0]);
+			iccloss::NakagamiAvx2 (&m_shape[0], &m_scale[0], n, m_uniforms, &m_out[0]);
+			return;
+		}
+#endif
+		iccloss::MeanPowerScalar (m_params, txPowerDbm, &m_dx[0], &m_dy[0], &m_dz[0], n, &m_shape[0], &m_scale[0]);
+		iccloss::NakagamiScalar (&m_shape[0], &m_scale[0], n, m_uniforms, &m_out[0]);
+	}
+
+	// Evaluates every receiver for a transmission of a
+	void Batch (double txPowerDbm, Ptr<MobilityModel> a) const
+	{
+		m_sender = a;
+		m_senderTime = Simulator::Now ().GetTimeStep ();
+		m_senderPower = txPowerDbm;
+		m_counters.batches++;
+
+		Vector s = a->GetPosition ();
+		m_dx.clear ();
+		m_dy.clear ();
+		m_dz.clear ();
+		m_slots.clear ();
+		for (uint32_t i = 0; i < m_receivers.size (); i++)
+		{
+			m_served[i] = 0;
+
+			Vector r = m_receivers[i]->GetPosition ();
+			double dx = r.x - s.x;
+			double dy = r.y - s.y;
+			double dz = r.z - s.z;
+			if (m_maxRange2 > 0 && dx * dx + dy * dy + dz * dz > m_maxRange2)
+			{
+				m_rxDbm[i] = ICC_CULLED_RX_DBM;
+				m_counters.culled++;
+				continue;
+			}
+			m_dx.push_back (dx);
+			m_dy.push_back (dy);
+			m_dz.push_back (dz);
+			m_slots.push_back (i);
+		}
+
+		uint32_t n = m_slots.size ();
+		Evaluate (txPowerDbm, n);
+		for (uint32_t k = 0; k < n; k++)
+			m_rxDbm[m_slots[k]] = m_out[k];
+		m_counters.drawn += n;
+	}
+
+	virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+	{
+		m_counters.evaluated++;
+
+		if (!m_indexed)
+		{
+			std::sort (m_index.begin (), m_index.end ());
+			m_indexed = true;
+		}
+		std::vector<std::pair<MobilityModel *, uint32_t> >::const_iterator it =
+				std::lower_bound (m_index.begin (), m_index.end (), std::make_pair (PeekPointer (b), (uint32_t) 0));
+
+		if (it == m_index.end () || it->first != PeekPointer (b))
+		{
+			m_counters.unlisted++;
+			Vector s = a->GetPosition ();
+			Vector r = b->GetPosition ();
+			m_dx.assign (1, r.x - s.x);
+			m_dy.assign (1, r.y - s.y);
+			m_dz.assign (1, r.z - s.z);
+			Evaluate (txPowerDbm, 1);
+			// The arrays of the current transmission are gone
+			m_sender = 0;
+			return m_out[0];
+		}
+
+		// A receiver asked for twice belongs to another transmission
+		uint32_t i = it->second;
+		if (a != m_sender || Simulator::Now ().GetTimeStep () != m_senderTime || txPowerDbm != m_senderPower || m_served[i])
+			Batch (txPowerDbm, a);
+
+		m_served[i] = 1;
+		return m_rxDbm[i];
+	}
+
+	virtual int64_t DoAssignStreams (int64_t stream)
+	{
+		m_uniform->SetStream (stream);
+		m_uniforms.SetStream (m_uniform);
+		return 1;
+	}
+
+	iccloss::LossParams m_params;
+	double m_maxRange;
+	double m_maxRange2;                           // Squared, compared against squared distances
+	bool m_avx2;
+	std::vector<Ptr<MobilityModel> > m_receivers;
+	Ptr<UniformRandomVariable> m_uniform;
+
+	mutable std::vector<std::pair<MobilityModel *, uint32_t> > m_index; // Receiver -> slot, sorted when asked first
+	mutable bool m_indexed;
+	mutable iccloss::UniformBlock m_uniforms;
+	mutable Ptr<MobilityModel> m_sender;          // Transmission of the current batch
+	mutable int64_t m_senderTime;
+	mutable double m_senderPower;
+	mutable std::vector<double> m_rxDbm;          // By slot, for the current batch
+	mutable std::vector<uint8_t> m_served;        // Slots already read by the channel
+	mutable std::vector<double> m_dx;             // Receivers evaluated, relative to the sender
+	mutable std::vector<double> m_dy;
+	mutable std::vector<double> m_dz;
+	mutable std::vector<uint32_t> m_slots;        // Their slots
+	mutable std::vector<double> m_shape;
+	mutable std::vector<double> m_scale;
+	mutable std::vector<double> m_out;
+	mutable BatchCounters m_counters;
+};
+
+// One distance of a loss check
+struct LossCheckRow
+{
+	std::string kernel;                           // avx2 | scalar
+	double distance;                              // meters
+	uint32_t samples;
+	double referenceMean;                         // Mean received power of the ns-3 chain (dBm)
+	double batchedMean;                           // And of the batched model
+	double ks;                                    // Two sample Kolmogorov-Smirnov statistic
+	double p;                                     // Its asymptotic p-value
+};
+
+// Probability of a Kolmogorov-Smirnov statistic at least D from two samples
+// of sizes n1 and n2 of one distribution
+inline double KsPValue (double d, uint32_t n1, uint32_t n2)
+{
+	double ne = (double) n1 * n2 / (n1 + n2);
+	double lambda = (std::sqrt (ne) + 0.12 + 0.11 / std::sqrt (ne)) * d;
+	if (lambda < 0.2)
+		return 1;
+
+	double sum = 0, sign = 1;
+	for (int k = 1; k <= 100; k++)
+	{
+		double term = std::exp (-2 * k * k * lambda * lambda);
+		sum += sign * term;
+		if (term < 1e-12)
+			break;
+		sign = -sign;
+	}
+	return std::max (0.0, std::min (1.0, 2 * sum));
+}
+
+// Draws samples received powers at every distance from the ns-3 chain
+// (ThreeLogDistance then Nakagami, with their defaults) and from the batched
+// model, with each kernel the CPU runs, and compares their distributions.
+// Written as a tsv to path, returns the rows
+inline std::vector<LossCheckRow> CheckBatchedLoss (const std::string &path, uint32_t samples, double txPowerDbm)
+{
+	static const double distances[] = { 0.5, 10, 50, 79, 120, 199, 250, 400, 600, 1000, 2000 };
+	static const uint32_t nDistances = sizeof (distances) / sizeof (distances[0]);
+
+	Ptr<ThreeLogDistancePropagationLossModel> logDistance = CreateObject<ThreeLogDistancePropagationLossModel> ();
+	Ptr<NakagamiPropagationLossModel> nakagami = CreateObject<NakagamiPropagationLossModel> ();
+	logDistance->SetNext (nakagami);
+
+	std::vector<std::string> kernels;
+	if (iccloss::HasAvx2 ())
+		kernels.push_back ("avx2");
+	kernels.push_back ("scalar");
+
+	Ptr<MobilityModel> sender = CreateObject<ConstantPositionMobilityModel> ();
+	Ptr<MobilityModel> receiver = CreateObject<ConstantPositionMobilityModel> ();
+	sender->SetPosition (Vector (0, 0, 0));
+
+	std::vector<LossCheckRow> rows;
+	std::vector<double> reference (samples), batched (samples);
+	for (uint32_t k = 0; k < kernels.size (); k++)
+	{
+		Ptr<BatchedLossModel> model = CreateObject<BatchedLossModel> ();
+		model->CopyParameters (logDistance, nakagami);
+		model->SetAttribute ("Avx2", BooleanValue (kernels[k] == "avx2"));
+
+		for (uint32_t j = 0; j < nDistances; j++)
+		{
+			receiver->SetPosition (Vector (distances[j], 0, 0));
+			for (uint32_t i = 0; i < samples; i++)
+				reference[i] = logDistance->CalcRxPower (txPowerDbm, sender, receiver);
+			model->Sample (txPowerDbm, distances[j], samples, batched.empty () ? 0 : &batched[0]);
+
+			std::sort (reference.begin (), reference.end ());
+			std::sort (batched.begin (), batched.end ());
+
+			// Largest gap between the empirical distributions
+			double ks = 0;
+			uint32_t r = 0, b = 0;
+			while (r < samples && b < samples)
+			{
+				double x = std::min (reference[r], batched[b]);
+				while (r < samples && reference[r] <= x)
+					r++;
+				while (b < samples && batched[b] <= x)
+					b++;
+				ks = std::max (ks, std::fabs ((double) r - b) / samples);
+			}
+
+			LossCheckRow row;
+			row.kernel = kernels[k];
+			row.distance = distances[j];
+			row.samples = samples;
+			row.referenceMean = samples ? std::accumulate (reference.begin (), reference.end (), 0.0) / samples : 0;
+			row.batchedMean = samples ? std::accumulate (batched.begin (), batched.end (), 0.0) / samples : 0;
+			row.ks = ks;
+			row.p = samples ? KsPValue (ks, samples, samples) : 1;
+			rows.push_back (row);
+		}
+	}
+
+	std::ofstream os (path.c_str ());
+	os << "# tx_dbm " << txPowerDbm << " samples " << samples << "\n";
+	os << "kernel\tdistance\tsamples\tref_mean_dbm\tbatch_mean_dbm\tks_d\tp_value\n";
+	for (uint32_t i = 0; i < rows.size (); i++)
+		os << rows[i].kernel << "\t" << rows[i].distance << "\t" << rows[i].samples << "\t" << rows[i].referenceMean <<
+				"\t" << rows[i].batchedMean << "\t" << rows[i].ks << "\t" << rows[i].p << "\n";
+
+	return rows;
+}
+
+} // namespace ns3
+
+#endif // ICC_WIFI_BATCH_H
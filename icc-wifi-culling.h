@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; -*- */
+/*
+ * icc-wifi-culling.h
+ *  Range limited propagation loss for the ICC scenario Wifi channel
+ *
+ * Copyright (c) 2014 Waseda University, Sato Laboratory
+ *
+ *  icc-wifi-culling is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  icc-wifi-culling is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero Public License
+ *  along with icc-wifi-culling.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICC_WIFI_CULLING_H
+#define ICC_WIFI_CULLING_H
+
+#include <algorithm>
+#include <limits>
+
+#include <ns3-dev/ns3/core-module.h>
+#include <ns3-dev/ns3/mobility-module.h>
+#include <ns3-dev/ns3/propagation-module.h>
+
+namespace ns3 {
+
+// Received power given to culled receivers, far below any PHY threshold
+static const double ICC_CULLED_RX_DBM = -1000;
+
+// What the culling loss model has done since it was created
+struct CullingCounters
+{
+	CullingCounters ()
+		: evaluated (0), culled (0), missed (0), strongestMissed (-std::numeric_limits<double>::infinity ())
+	{
+	}
+
+	uint64_t evaluated;                           // Sender and receiver pairs asked for
+	uint64_t culled;                              // Pairs beyond the maximum range
+	uint64_t missed;                              // Culled pairs that reached the threshold (validation only)
+	double strongestMissed;                       // Strongest of those (dBm)
+};
+
+// Wraps the loss chain of the Wifi channel and only evaluates it for
+// receivers within MaxRange of the sender, the others get ICC_CULLED_RX_DBM
+// and are dropped by their PHY. The chain has to be held here rather than
+// linked behind with SetNext, as a model cannot stop the models after it.
+// The sender position is read once per transmission, not once per receiver.
+//
+// With Validate the full chain runs for every pair and its result is used,
+// so the run is the one without culling, and culled pairs whose power would
+// have reached Threshold are counted: a non zero count means MaxRange is
+// too short for the powers and loss models in use
+class RangeCullingLossModel : public PropagationLossModel
+{
+public:
+	static TypeId GetTypeId (void)
+	{
+		static TypeId tid = TypeId ("ns3::IccRangeCullingLossModel")
+			.SetParent<PropagationLossModel> ()
+			.AddConstructor<RangeCullingLossModel> ()
+			.AddAttribute ("MaxRange", "Receivers further than this from the sender are culled (meters)",
+					DoubleValue (1000),
+					MakeDoubleAccessor (&RangeCullingLossModel::SetMaxRange, &RangeCullingLossModel::GetMaxRange),
+					MakeDoubleChecker<double> (0))
+			.AddAttribute ("Validate", "Evaluate every pair and count the culled ones that reach Threshold",
+					BooleanValue (false),
+					MakeBooleanAccessor (&RangeCullingLossModel::m_validate),
+					MakeBooleanChecker ())
+			.AddAttribute ("Threshold", "Weakest power that still matters at a receiver, as a frame or as interference (dBm)",
+					DoubleValue (-110),
+					MakeDoubleAccessor (&RangeCullingLossModel::m_threshold),
+					MakeDoubleChecker<double> ());
+		return tid;
+	}
+
+	RangeCullingLossModel ()
+		: m_maxRange (0), m_maxRange2 (0), m_validate (false), m_threshold (-110), m_senderTime (-1)
+	{
+	}
+
+	// The loss chain evaluated for the receivers in range
+	void SetInner (Ptr<PropagationLossModel> inner)
+	{
+		m_inner = inner;
+	}
+
+	void SetMaxRange (double range)
+	{
+		m_maxRange = range;
+		m_maxRange2 = range * range;
+	}
+
+	double GetMaxRange () const
+	{
+		return m_maxRange;
+	}
+
+	const CullingCounters &GetCounters () const
+	{
+		return m_counters;
+	}
+
+protected:
+	virtual void DoDispose (void)
+	{
+		m_inner = 0;
+		m_sender = 0;
+		PropagationLossModel::DoDispose ();
+	}
+
+private:
+	virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+	{
+		m_counters.evaluated++;
+
+		// A transmission asks for every receiver at the same time
+		int64_t now = Simulator::Now ().GetTimeStep ();
+		if (a != m_sender || now != m_senderTime)
+		{
+			m_sender = a;
+			m_senderTime = now;
+			m_senderPosition = a->GetPosition ();
+		}
+
+		Vector r = b->GetPosition ();
+		double dx = r.x - m_senderPosition.x;
+		double dy = r.y - m_senderPosition.y;
+		double dz = r.z - m_senderPosition.z;
+		if (dx * dx + dy * dy + dz * dz <= m_maxRange2)
+			return m_inner->CalcRxPower (txPowerDbm, a, b);
+
+		m_counters.culled++;
+		if (!m_validate)
+			return ICC_CULLED_RX_DBM;
+
+		double full = m_inner->CalcRxPower (txPowerDbm, a, b);
+		if (full >= m_threshold)
+		{
+			m_counters.missed++;
+			m_counters.strongestMissed = std::max (m_counters.strongestMissed, full);
+		}
+		return full;
+	}
+
+	virtual int64_t DoAssignStreams (int64_t stream)
+	{
+		return m_inner != 0 ? m_inner->AssignStreams (stream) : 0;
+	}
+
+	Ptr<PropagationLossModel> m_inner;
+	double m_maxRange;
+	double m_maxRange2;                           // Squared, compared against squared distances
+	bool m_validate;
+	double m_threshold;
+
+	mutable Ptr<MobilityModel> m_sender;          // Sender of the last pair and when it was asked for
+	mutable int64_t m_senderTime;
+	mutable Vector m_senderPosition;
+	mutable CullingCounters m_counters;
+};
+
+} // namespace ns3
+
+#endif // ICC_WIFI_CULLING_H
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# merge-rank-traces.py
+#  Joins the traces of a distributed ICC scenario run
+#
+# Copyright (c) 2014 Waseda University, Sato Laboratory
+#
+#  merge-rank-traces is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  merge-rank-traces is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero Public License for more details.
+#
+#  You should have received a copy of the GNU Affero Public License
+#  along with merge-rank-traces.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Merge the per rank traces of a -distributed run into one set.
+
+With -distributed every MPI rank writes its traces under rank<r>/ of the
+result directory, for the nodes it ran. The text traces of all ranks are
+merged by their Time column into the result directory, so they read like
+the traces of a single process run. Binary traces are left per rank, run
+icc-trace-reader on each.
+
+    mpirun -np 4 build/scratch/icc-scenario -distributed=1 -sectors=32 -trace=1
+    ./merge-rank-traces.py results/fakeInterest/normal/5
+"""
+
+import argparse
+import glob
+import heapq
+import os
+import sys
+
+# Text traces the scenario writes, see the tracer section of icc-scenario.cc
+TRACES = ['aggregate-trace', 'rate-trace', 'app-delays',
+          'MN-aggregate-trace', 'MN-rate-trace', 'MN-app-delays']
+
+
+def rows(path):
+    """Header and (time, line) rows of a trace, rows are in time order."""
+    f = open(path)
+    header = f.readline()
+
+    def generate():
+        with f:
+            for line in f:
+                yield float(line.split('\t', 1)[0]), line
+    return header, generate()
+
+
+def merge(paths, out):
+    headers, streams = [], []
+    for path in paths:
+        header, stream = rows(path)
+        headers.append(header)
+        streams.append(stream)
+
+    if len(set(headers)) > 1:
+        raise ValueError('%s: the ranks wrote different headers' % out)
+
+    n = 0
+    with open(out, 'w') as f:
+        f.write(headers[0])
+        for _, line in heapq.merge(*streams, key=lambda row: row[0]):
+            f.write(line)
+            n += 1
+    return n
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('dirs', nargs='+', help='result directories holding rank<r>/ subdirectories')
+    args = parser.parse_args()
+
+    status = 0
+    for d in args.dirs:
+        ranks = sorted(glob.glob(os.path.join(d, 'rank*')), key=lambda p: int(p.rsplit('rank', 1)[1]))
+        if not ranks:
+            print('%s: no rank directories' % d)
+            status = 1
+            continue
+
+        for trace in TRACES:
+            paths = [os.path.join(r, trace) for r in ranks if os.path.isfile(os.path.join(r, trace))]
+            if not paths:
+                continue
+            if len(paths) != len(ranks):
+                print('%s: %s missing on some ranks, merging %d of %d' % (d, trace, len(paths), len(ranks)))
+            try:
+                n = merge(paths, os.path.join(d, trace))
+            except ValueError as e:
+                print(e)
+                status = 1
+                continue
+            print('%s: %d rows from %d ranks' % (os.path.join(d, trace), n, len(paths)))
+
+    return status
+
+
+if __name__ == '__main__':
+    sys.exit(main())
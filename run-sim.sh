@@ -1,17 +1,13 @@
 #!/bin/bash
 
-WAFDIR=./
-WAF=${WAFDIR}waf
+# Runs the speed sweep for normal and fake interest, with trace files, in
+# parallel on all cores. Runs already finished under sweep/ are skipped.
+# Run from the ns-3 directory, or point NS3DIR at it.
 
+NS3DIR=${NS3DIR:-./}
+SWEEP=$(dirname "$0")/run-sweep.py
 
-for  speed in 5 10 20 30 40 50 60 70 80
-do
-
-echo "run $WAF --run "fake -speed=$speed -trace""
-$WAF --run "icc-scenario -speed=$speed -trace"
-
-echo "run $WAF --run "fake -speed=$speed -trace -fake""
-$WAF --run "icc-scenario -speed=$speed -trace -fake"
-
-done
-
+$SWEEP --ns3-dir "$NS3DIR" --out "${OUT:-sweep}" \
+	--speed 5 10 20 30 40 50 60 70 80 \
+	--fake 0 1 \
+	"$@" -- -trace=1
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+#
+# run-sweep.py
+#  Parallel parameter sweep for the ICC scenario
+#
+# Copyright (c) 2014 Waseda University, Sato Laboratory
+#
+#  run-sweep is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  run-sweep is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero Public License for more details.
+#
+#  You should have received a copy of the GNU Affero Public License
+#  along with run-sweep.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Run the icc-scenario binary over a grid of command line parameters.
+
+The built binary is run directly (no waf in the loop) by a fixed pool of
+workers, each pinned to its own core. Every run gets its own result
+directory under --out holding its results, its log and a 'done' marker,
+so an interrupted sweep picks up where it stopped when run again.
+
+Example, the grid run-sim.sh used to walk serially:
+
+    ./run-sweep.py --ns3-dir ~/ndnSIM/ns-3 --speed 5 10 20 30 40 50 60 70 80 --fake 0 1
+"""
+
+import argparse
+import glob
+import itertools
+import json
+import os
+import queue
+import subprocess
+import sys
+import threading
+import time
+
+# Forwarding strategy name -> scenario flags
+STRATEGIES = {
+    'flood': [],
+    'smart': ['-smart=1'],
+    'bestr': ['-bestr=1'],
+}
+
+# Grid parameters passed straight through as -name=value
+PASSTHROUGH = ['csSize', 'csStore', 'mbps', 'pool', 'sharedPayload', 'retxWheel', 'handoverPause', 'mobile', 'sectors', 'aps', 'layout']
+
+
+def find_binary(ns3_dir):
+    """Locate the built scenario under the ns-3 build tree."""
+    for pattern in ('build/scratch/icc-scenario', 'build/scratch/*icc-scenario*'):
+        for path in sorted(glob.glob(os.path.join(ns3_dir, pattern))):
+            if os.path.isfile(path) and os.access(path, os.X_OK):
+                return os.path.abspath(path)
+    return None
+
+
+def build_grid(args):
+    """Expand the parameter lists into one dictionary per run."""
+    names = ['speed', 'fake', 'strategy'] + PASSTHROUGH + ['seed']
+    values = [args.speed, args.fake, args.strategy] + \
+        [getattr(args, name) or [None] for name in PASSTHROUGH] + [args.seed]
+
+    grid = []
+    for combo in itertools.product(*values):
+        grid.append(dict((k, v) for k, v in zip(names, combo) if v is not None))
+    return grid
+
+
+def run_key(params):
+    """Directory name identifying a run."""
+    return '_'.join('%s-%s' % (k, params[k]) for k in sorted(params))
+
+
+def write_params(rundir, params):
+    """Record the grid point of a run as params.json in its directory."""
+    with open(os.path.join(rundir, 'params.json'), 'w') as f:
+        json.dump(params, f, sort_keys=True)
+
+
+def scenario_args(params, rundir, extra):
+    cmd = ['-speed=%s' % params['speed'],
+           '-fake=%s' % params['fake'],
+           '--RngRun=%s' % params['seed'],
+           '-results=%s' % rundir]
+    cmd += STRATEGIES[params['strategy']]
+    for name in PASSTHROUGH:
+        if name in params:
+            cmd.append('-%s=%s' % (name, params[name]))
+    return cmd + extra
+
+
+class Sweep(object):
+
+    def __init__(self, args, binary):
+        self.args = args
+        self.binary = binary
+        self.lock = threading.Lock()
+        self.done = 0
+        self.failed = 0
+        self.total = 0
+
+        self.env = dict(os.environ)
+        libdir = os.path.abspath(os.path.join(args.ns3_dir, 'build'))
+        self.env['LD_LIBRARY_PATH'] = libdir + os.pathsep + self.env.get('LD_LIBRARY_PATH', '')
+
+    def report(self, key, status, seconds):
+        with self.lock:
+            self.done += 1
+            if status != 0:
+                self.failed += 1
+            print('[%d/%d] %s %s (%.1fs)' % (self.done, self.total, key,
+                                             'ok' if status == 0 else 'FAILED %d' % status, seconds))
+            sys.stdout.flush()
+            with open(os.path.join(self.args.out, 'progress.tsv'), 'a') as progress:
+                progress.write('%s\t%d\t%.3f\n' % (key, status, seconds))
+
+    def run_one(self, params):
+        key = run_key(params)
+        rundir = os.path.abspath(os.path.join(self.args.out, key))
+        os.makedirs(rundir, exist_ok=True)
+        write_params(rundir, params)
+        for marker in ('done', 'failed'):
+            if os.path.exists(os.path.join(rundir, marker)):
+                os.remove(os.path.join(rundir, marker))
+
+        cmd = [self.binary] + scenario_args(params, rundir, self.args.extra)
+
+        start = time.time()
+        with open(os.path.join(rundir, 'log.txt'), 'w') as log:
+            log.write(' '.join(cmd) + '\n')
+            log.flush()
+            status = subprocess.call(cmd, cwd=self.args.ns3_dir, env=self.env,
+                                     stdout=log, stderr=subprocess.STDOUT)
+        seconds = time.time() - start
+
+        # Only successful runs are skipped when the sweep is resumed
+        marker = 'done' if status == 0 else 'failed'
+        with open(os.path.join(rundir, marker), 'w') as f:
+            f.write('%d %.3f\n' % (status, seconds))
+
+        self.report(key, status, seconds)
+
+    def worker(self, core, todo):
+        # Every run started by this worker inherits its core
+        if core is not None:
+            os.sched_setaffinity(0, [core])
+
+        while True:
+            params = todo.get()
+            if params is None:
+                return
+            self.run_one(params)
+
+    def run(self, grid):
+        pending = [p for p in grid
+                   if self.args.force or not os.path.exists(os.path.join(self.args.out, run_key(p), 'done'))]
+        self.total = len(pending)
+
+        # Runs done before params.json was written get it too
+        if not self.args.dry_run:
+            for params in grid:
+                rundir = os.path.join(self.args.out, run_key(params))
+                if os.path.isdir(rundir) and not os.path.exists(os.path.join(rundir, 'params.json')):
+                    write_params(rundir, params)
+
+        print('%d runs, %d already done, %d workers' % (len(grid), len(grid) - len(pending), self.args.jobs))
+
+        if self.args.dry_run:
+            for params in pending:
+                print(' '.join([self.binary] + scenario_args(params, os.path.join(self.args.out, run_key(params)),
+                                                            self.args.extra)))
+            return 0
+
+        todo = queue.Queue()
+        for params in pending:
+            todo.put(params)
+
+        cores = sorted(os.sched_getaffinity(0))
+        workers = []
+        for i in range(self.args.jobs):
+            todo.put(None)
+            core = None if self.args.no_pin else cores[i % len(cores)]
+            t = threading.Thread(target=self.worker, args=(core, todo))
+            t.start()
+            workers.append(t)
+
+        for t in workers:
+            t.join()
+
+        print('%d runs finished, %d failed' % (self.done, self.failed))
+        return 1 if self.failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--ns3-dir', default='.', help='ns-3 tree holding build/ and Waypoints/ (default: .)')
+    parser.add_argument('--binary', help='scenario binary (default: found under NS3_DIR/build/scratch)')
+    parser.add_argument('--out', default='sweep', help='directory for per-run results (default: sweep)')
+    parser.add_argument('--jobs', '-j', type=int, default=len(os.sched_getaffinity(0)),
+                        help='number of worker processes (default: available cores)')
+    parser.add_argument('--no-pin', action='store_true', help='do not pin workers to cores')
+    parser.add_argument('--force', action='store_true', help='rerun runs already marked done')
+    parser.add_argument('--dry-run', action='store_true', help='only print the commands')
+
+    grid = parser.add_argument_group('parameter grid')
+    grid.add_argument('--speed', nargs='+', default=['5', '10', '20', '30', '40', '50', '60', '70', '80'])
+    grid.add_argument('--fake', nargs='+', default=['0', '1'], choices=['0', '1'])
+    grid.add_argument('--strategy', nargs='+', default=['flood'], choices=sorted(STRATEGIES))
+    grid.add_argument('--csSize', nargs='+')
+    grid.add_argument('--csStore', nargs='+', choices=['lru', 'arena'])
+    grid.add_argument('--mbps', nargs='+')
+    grid.add_argument('--pool', nargs='+', choices=['0', '1'])
+    grid.add_argument('--sharedPayload', nargs='+', choices=['0', '1'])
+    grid.add_argument('--retxWheel', nargs='+', choices=['0', '1'])
+    grid.add_argument('--handoverPause', nargs='+', choices=['0', '1'])
+    grid.add_argument('--mobile', nargs='+')
+    grid.add_argument('--sectors', nargs='+')
+    grid.add_argument('--aps', nargs='+')
+    grid.add_argument('--layout', nargs='+', choices=['road', 'hex'])
+    grid.add_argument('--seed', nargs='+', default=['1'], help='ns-3 RngRun values')
+    parser.add_argument('extra', nargs='*', help='further scenario arguments, after --')
+
+    args = parser.parse_args()
+
+    binary = args.binary or find_binary(args.ns3_dir)
+    if not binary:
+        parser.error('no icc-scenario binary under %s/build/scratch, build it or pass --binary' % args.ns3_dir)
+
+    os.makedirs(args.out, exist_ok=True)
+    args.out = os.path.abspath(args.out)
+    args.ns3_dir = os.path.abspath(args.ns3_dir)
+
+    return Sweep(args, os.path.abspath(binary)).run(build_grid(args))
+
+
+if __name__ == '__main__':
+    sys.exit(main())